@@ -0,0 +1,647 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+#include "../src/3dmath.h"
+#include "../src/raycaster.h"
+#include "../src/json.h"
+#include "../src/constants.h"
+
+#define DEFAULT_SET_SIZE 4096
+#define DEFAULT_ITERATIONS 262144
+#define DEFAULT_SAMPLES 15
+#define DEFAULT_HIT_RATIO 0.5
+#define DEFAULT_SEED 430
+
+/**
+ * The synthetic data set that all kernels are run over
+ */
+typedef struct BenchData {
+	int length;
+	V3 *origins;
+	V3 *directions;
+	V3 *normals;
+	V3 *colors;
+	double *distances;
+	Primitive *spheres;
+	Primitive *planes;
+	Light *pointLights;
+	Light *spotLights;
+	int sphereHits;
+	int planeHits;
+} BenchData;
+
+/**
+ * The timing result of a single kernel
+ */
+typedef struct BenchResult {
+	const char *name;
+	double nsPerOp;
+	double nsCi95;
+	double cyclesPerOp;
+	double mopsPerSecond;
+	double hitRatio;
+	int samples;
+} BenchResult;
+
+/**
+ * A kernel runs `iterations` operations over the data set and returns a value to keep the work alive
+ */
+typedef double (*BenchKernel)(BenchData *dataRef, long iterations);
+
+typedef struct BenchCase {
+	const char *name;
+	BenchKernel kernel;
+	int hasHitRatio;
+} BenchCase;
+
+static volatile double benchSink;
+static uint64_t rngState;
+
+/**
+ * xorshift64* - a small, reproducible random number generator
+ * @return A random number in the range [0, 1)
+ */
+static double random_unit() {
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (double) ((rngState * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Produce a random vector with each component in the range [min, max)
+ */
+static void random_v3(double min, double max, V3 *result) {
+	for (int i = 0; i < 3; i++)
+		result->array[i] = min + (max - min) * random_unit();
+}
+
+/**
+ * Produce a random unit vector which is perpendicular to the input unit vector
+ */
+static void random_perpendicular(V3 *a, V3 *result) {
+	V3 r;
+	V3 axis;
+	do {
+		random_v3(-1, 1, &r);
+		v3_cross(a, &r, &axis);
+		v3_magnitude(&axis, &r.data.X);
+	} while (r.data.X < 1e-3);
+	v3_normalize(&axis, result);
+}
+
+/**
+ * Build the synthetic ray and primitive sets. Ray i is paired with sphere i and plane i, each of which
+ * is constructed to be hit with the probability hitRatio.
+ * @param dataRef - The data set to populate
+ * @param length - The number of rays and primitives to create
+ * @param hitRatio - The fraction of ray/primitive pairs which should intersect
+ */
+static void create_bench_data(BenchData *dataRef, int length, double hitRatio) {
+	dataRef->length = length;
+	dataRef->origins = malloc(sizeof(V3) * length);
+	dataRef->directions = malloc(sizeof(V3) * length);
+	dataRef->normals = malloc(sizeof(V3) * length);
+	dataRef->colors = malloc(sizeof(V3) * length);
+	dataRef->distances = malloc(sizeof(double) * length);
+	dataRef->spheres = malloc(sizeof(Primitive) * length);
+	dataRef->planes = malloc(sizeof(Primitive) * length);
+	dataRef->pointLights = malloc(sizeof(Light) * length);
+	dataRef->spotLights = malloc(sizeof(Light) * length);
+	dataRef->sphereHits = 0;
+	dataRef->planeHits = 0;
+
+	for (int i = 0; i < length; i++) {
+		V3 *originRef = &dataRef->origins[i];
+		V3 *directionRef = &dataRef->directions[i];
+		V3 offset;
+		V3 side;
+		Material material;
+		double distance = 1 + 20 * random_unit();
+		double radius = 0.25 + random_unit();
+
+		random_v3(-10, 10, originRef);
+		random_v3(-1, 1, directionRef);
+		v3_normalize(directionRef, directionRef);
+		random_v3(-1, 1, &dataRef->normals[i]);
+		v3_normalize(&dataRef->normals[i], &dataRef->normals[i]);
+		random_v3(0, 1, &dataRef->colors[i]);
+		dataRef->distances[i] = distance;
+
+		// A sphere along the ray, pushed sideways past its radius when it should be missed
+		Sphere *sphereRef = &dataRef->spheres[i].data.sphere;
+		dataRef->spheres[i].type = SPHERE_T;
+		random_perpendicular(directionRef, &side);
+		v3_scale(directionRef, distance, &offset);
+		v3_add(originRef, &offset, &sphereRef->position);
+		if (random_unit() < hitRatio) {
+			v3_scale(&side, radius * 0.9 * random_unit(), &offset);
+		}
+		else {
+			v3_scale(&side, radius * (1.1 + random_unit()), &offset);
+		}
+		v3_add(&sphereRef->position, &offset, &sphereRef->position);
+		sphereRef->radius = radius;
+		dataRef->spheres[i].material = 0;
+		// Materials are not benchmarked, their colors are still drawn so the geometry matches earlier runs
+		random_v3(0, 1, &material.diffuseColor);
+		random_v3(0, 1, &material.specularColor);
+
+		// A plane facing the ray, placed behind the origin when it should be missed
+		Plane *planeRef = &dataRef->planes[i].data.plane;
+		dataRef->planes[i].type = PLANE_T;
+		v3_scale(directionRef, -1, &planeRef->normal);
+		v3_scale(directionRef, random_unit() < hitRatio ? distance : -distance, &offset);
+		v3_add(originRef, &offset, &planeRef->position);
+		dataRef->planes[i].material = 0;
+		random_v3(0, 1, &material.diffuseColor);
+		random_v3(0, 1, &material.specularColor);
+
+		if (intersect_sphere(sphereRef, originRef, directionRef) != INFINITY)
+			dataRef->sphereHits++;
+		if (intersect_plane(planeRef, originRef, directionRef) != INFINITY)
+			dataRef->planeHits++;
+
+		// Lights sit at the far end of the ray, spotlights point back along it
+		PointLight *pointLightRef = &dataRef->pointLights[i].data.pointLight;
+		dataRef->pointLights[i].type = POINTLIGHT_T;
+		v3_scale(directionRef, distance, &offset);
+		v3_add(originRef, &offset, &pointLightRef->position);
+		random_v3(0, 4, &pointLightRef->color);
+		pointLightRef->radialA2 = (float) random_unit();
+		pointLightRef->radialA1 = (float) random_unit();
+		pointLightRef->radialA0 = 1;
+
+		SpotLight *spotLightRef = &dataRef->spotLights[i].data.spotLight;
+		dataRef->spotLights[i].type = SPOTLIGHT_T;
+		spotLightRef->position = pointLightRef->position;
+		spotLightRef->color = pointLightRef->color;
+		spotLightRef->radialA2 = pointLightRef->radialA2;
+		spotLightRef->radialA1 = pointLightRef->radialA1;
+		spotLightRef->radialA0 = pointLightRef->radialA0;
+		spotLightRef->angularA0 = 10;
+		spotLightRef->theta = (float) (M_PI / 8);
+		random_v3(-0.3, 0.3, &offset);
+		v3_subtract(&offset, directionRef, &spotLightRef->direction);
+		v3_normalize(&spotLightRef->direction, &spotLightRef->direction);
+	}
+}
+
+static double bench_v3_add(BenchData *d, long n) {
+	V3 acc = {{0, 0, 0}};
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1)
+		v3_add(&acc, &d->directions[i], &acc);
+	return acc.data.X + acc.data.Y + acc.data.Z;
+}
+
+static double bench_v3_subtract(BenchData *d, long n) {
+	V3 acc = {{0, 0, 0}};
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1)
+		v3_subtract(&acc, &d->directions[i], &acc);
+	return acc.data.X + acc.data.Y + acc.data.Z;
+}
+
+static double bench_v3_scale(BenchData *d, long n) {
+	V3 r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		v3_scale(&d->directions[i], d->distances[i], &r);
+		acc += r.data.X;
+	}
+	return acc;
+}
+
+static double bench_v3_dot(BenchData *d, long n) {
+	double r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		v3_dot(&d->directions[i], &d->normals[i], &r);
+		acc += r;
+	}
+	return acc;
+}
+
+static double bench_v3_cross(BenchData *d, long n) {
+	V3 r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		v3_cross(&d->directions[i], &d->normals[i], &r);
+		acc += r.data.Y;
+	}
+	return acc;
+}
+
+static double bench_v3_normalize(BenchData *d, long n) {
+	V3 r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		v3_normalize(&d->origins[i], &r);
+		acc += r.data.Z;
+	}
+	return acc;
+}
+
+static double bench_v3_reflect(BenchData *d, long n) {
+	V3 r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		v3_reflect(&d->directions[i], &d->normals[i], &r);
+		acc += r.data.X;
+	}
+	return acc;
+}
+
+static double bench_v3_distance(BenchData *d, long n) {
+	double r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		v3_distance(&d->origins[i], &d->spheres[i].data.sphere.position, &r);
+		acc += r;
+	}
+	return acc;
+}
+
+static double bench_intersect_sphere(BenchData *d, long n) {
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		double t = intersect_sphere(&d->spheres[i].data.sphere, &d->origins[i], &d->directions[i]);
+		if (t != INFINITY)
+			acc += t;
+	}
+	return acc;
+}
+
+static double bench_intersect_sphere_furthest(BenchData *d, long n) {
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		double t = intersect_sphere_furthest(&d->spheres[i].data.sphere, &d->origins[i], &d->directions[i]);
+		if (t != INFINITY)
+			acc += t;
+	}
+	return acc;
+}
+
+static double bench_intersect_plane(BenchData *d, long n) {
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		double t = intersect_plane(&d->planes[i].data.plane, &d->origins[i], &d->directions[i]);
+		if (t != INFINITY)
+			acc += t;
+	}
+	return acc;
+}
+
+static double bench_calculate_diffuse(BenchData *d, long n) {
+	V3 r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		calculate_diffuse(&d->normals[i], &d->directions[i], &d->colors[i], &d->pointLights[i].data.pointLight.color, &r);
+		acc += r.data.X;
+	}
+	return acc;
+}
+
+static double bench_calculate_specular(BenchData *d, long n) {
+	V3 r;
+	V3 reflection;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		int j = (i + 1) % d->length;
+		v3_reflect(&d->directions[j], &d->normals[i], &reflection);
+		calculate_specular(&d->directions[i], &reflection, &d->colors[i], &d->pointLights[i].data.pointLight.color,
+						   &d->normals[i], &d->directions[j], &r);
+		acc += r.data.X;
+	}
+	return acc;
+}
+
+static double bench_calculate_frad(BenchData *d, long n) {
+	double r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		calculate_frad(&d->pointLights[i], d->distances[i], &r);
+		acc += r;
+	}
+	return acc;
+}
+
+static double bench_calculate_fang(BenchData *d, long n) {
+	double r;
+	double acc = 0;
+	for (long k = 0, i = 0; k < n; k++, i = i + 1 == d->length ? 0 : i + 1) {
+		calculate_fang(&d->spotLights[i], &d->directions[i], &r);
+		acc += r;
+	}
+	return acc;
+}
+
+static BenchCase benchCases[] = {
+	{"v3_add", bench_v3_add, FALSE},
+	{"v3_subtract", bench_v3_subtract, FALSE},
+	{"v3_scale", bench_v3_scale, FALSE},
+	{"v3_dot", bench_v3_dot, FALSE},
+	{"v3_cross", bench_v3_cross, FALSE},
+	{"v3_normalize", bench_v3_normalize, FALSE},
+	{"v3_reflect", bench_v3_reflect, FALSE},
+	{"v3_distance", bench_v3_distance, FALSE},
+	{"intersect_sphere", bench_intersect_sphere, TRUE},
+	{"intersect_sphere_furthest", bench_intersect_sphere_furthest, TRUE},
+	{"intersect_plane", bench_intersect_plane, TRUE},
+	{"calculate_diffuse", bench_calculate_diffuse, FALSE},
+	{"calculate_specular", bench_calculate_specular, FALSE},
+	{"calculate_frad", bench_calculate_frad, FALSE},
+	{"calculate_fang", bench_calculate_fang, FALSE},
+};
+
+/**
+ * Two sided 95% Student's t critical values, indexed by degrees of freedom
+ */
+static const double tCritical95[] = {
+	0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+static double t_critical_95(int degreesOfFreedom) {
+	if (degreesOfFreedom < 1)
+		return 0;
+	if (degreesOfFreedom <= 30)
+		return tCritical95[degreesOfFreedom];
+	return 1.960;
+}
+
+static double now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t now_cycles() {
+#if BENCH_HAVE_TSC
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Time a single kernel over the data set
+ * @param caseRef - The kernel to run
+ * @param dataRef - The synthetic data set
+ * @param iterations - The number of operations per sample
+ * @param samples - The number of timed samples to take
+ * @param resultRef - The result to populate
+ */
+static void run_case(BenchCase *caseRef, BenchData *dataRef, long iterations, int samples, BenchResult *resultRef) {
+	double *nsSamples = malloc(sizeof(double) * samples);
+	double cycles = 0;
+
+	// Warm up the caches and the branch predictors
+	benchSink += caseRef->kernel(dataRef, iterations / 4 + 1);
+
+	for (int s = 0; s < samples; s++) {
+		uint64_t startCycles = now_cycles();
+		double start = now_ns();
+		benchSink += caseRef->kernel(dataRef, iterations);
+		double end = now_ns();
+		uint64_t endCycles = now_cycles();
+
+		nsSamples[s] = (end - start) / iterations;
+		cycles += (double) (endCycles - startCycles) / iterations;
+	}
+
+	double mean = 0;
+	for (int s = 0; s < samples; s++)
+		mean += nsSamples[s];
+	mean /= samples;
+
+	double variance = 0;
+	for (int s = 0; s < samples; s++)
+		variance += pow(nsSamples[s] - mean, 2);
+	variance = samples > 1 ? variance / (samples - 1) : 0;
+
+	resultRef->name = caseRef->name;
+	resultRef->nsPerOp = mean;
+	resultRef->nsCi95 = t_critical_95(samples - 1) * sqrt(variance / samples);
+	resultRef->cyclesPerOp = BENCH_HAVE_TSC ? cycles / samples : -1;
+	resultRef->mopsPerSecond = mean > 0 ? 1e3 / mean : 0;
+	resultRef->samples = samples;
+	resultRef->hitRatio = -1;
+	if (caseRef->hasHitRatio) {
+		int hits = strcmp(caseRef->name, "intersect_plane") == 0 ? dataRef->planeHits : dataRef->sphereHits;
+		resultRef->hitRatio = (double) hits / dataRef->length;
+	}
+
+	free(nsSamples);
+}
+
+/**
+ * Write the results in a machine readable JSON format so that runs can be compared across commits
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int write_results_json(char *fname, char *label, BenchResult *results, int resultsLength,
+							  long iterations, int setSize, double hitRatio, uint64_t seed) {
+	FILE *fp = fopen(fname, "w");
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"label\": \"%s\",\n", label);
+	fprintf(fp, "  \"iterations\": %ld,\n", iterations);
+	fprintf(fp, "  \"set_size\": %d,\n", setSize);
+	fprintf(fp, "  \"hit_ratio\": %f,\n", hitRatio);
+	fprintf(fp, "  \"seed\": %llu,\n", (unsigned long long) seed);
+	fprintf(fp, "  \"results\": [\n");
+	for (int i = 0; i < resultsLength; i++) {
+		fprintf(fp, "    {\"name\": \"%s\", \"ns_per_op\": %f, \"ns_ci95\": %f, \"cycles_per_op\": %f, "
+					"\"mops_per_second\": %f, \"observed_hit_ratio\": %f, \"samples\": %d}%s\n",
+				results[i].name, results[i].nsPerOp, results[i].nsCi95, results[i].cyclesPerOp,
+				results[i].mopsPerSecond, results[i].hitRatio, results[i].samples,
+				i + 1 < resultsLength ? "," : "");
+	}
+	fprintf(fp, "  ]\n");
+	fprintf(fp, "}\n");
+	fclose(fp);
+	return 0;
+}
+
+/**
+ * Look up the ns/op and confidence interval of a kernel in a previously written results file
+ * @return 0 if found, otherwise the kernel is not in the baseline
+ */
+static int find_baseline(JSONValue *baselineRef, const char *name, double *nsPerOp, double *nsCi95) {
+	JSONValue *resultsRef;
+	JSONValue *valueRef;
+
+	if (baselineRef->type != OBJECT_T)
+		return 1;
+	if (JSONObject_get_value("results", baselineRef->data.dataObject, &resultsRef) != 0 || resultsRef->type != ARRAY_T)
+		return 1;
+
+	for (int i = 0; i < resultsRef->data.dataArray->length; i++) {
+		JSONValue *entryRef = resultsRef->data.dataArray->values[i];
+		if (entryRef->type != OBJECT_T)
+			continue;
+		if (JSONObject_get_value("name", entryRef->data.dataObject, &valueRef) != 0 || valueRef->type != STRING_T)
+			continue;
+		if (strcmp(valueRef->data.dataString, name) != 0)
+			continue;
+		if (JSONObject_get_value("ns_per_op", entryRef->data.dataObject, &valueRef) != 0 || valueRef->type != NUMBER_T)
+			return 1;
+		*nsPerOp = valueRef->data.dataNumber;
+		if (JSONObject_get_value("ns_ci95", entryRef->data.dataObject, &valueRef) != 0 || valueRef->type != NUMBER_T)
+			return 1;
+		*nsCi95 = valueRef->data.dataNumber;
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Show a simple help message about the usage of this program
+ */
+static void show_help() {
+	printf("Usage: raytrace-bench [options]\n");
+	printf("\t --filter <name>: Only run kernels whose name contains <name>\n");
+	printf("\t --hit-ratio <r>: Fraction of synthetic rays which hit their primitive (default %.2f)\n", DEFAULT_HIT_RATIO);
+	printf("\t --set-size <n>: Number of synthetic rays and primitives (default %d)\n", DEFAULT_SET_SIZE);
+	printf("\t --iterations <n>: Operations per timed sample (default %d)\n", DEFAULT_ITERATIONS);
+	printf("\t --samples <n>: Timed samples per kernel (default %d)\n", DEFAULT_SAMPLES);
+	printf("\t --seed <n>: Seed for the synthetic data (default %d)\n", DEFAULT_SEED);
+	printf("\t --label <text>: Label stored in the results, e.g. a commit hash\n");
+	printf("\t --json <file>: Write machine readable results to <file>\n");
+	printf("\t --compare <file>: Compare against results previously written with --json\n");
+	printf("\n");
+	printf("\t Example: raytrace-bench --hit-ratio 0.9 --label $(git rev-parse --short HEAD) --json bench.json\n");
+}
+
+int main(int argc, char *argv[]) {
+	char *filter = NULL;
+	char *jsonFname = NULL;
+	char *compareFname = NULL;
+	char *label = "unlabeled";
+	double hitRatio = DEFAULT_HIT_RATIO;
+	int setSize = DEFAULT_SET_SIZE;
+	long iterations = DEFAULT_ITERATIONS;
+	int samples = DEFAULT_SAMPLES;
+	uint64_t seed = DEFAULT_SEED;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--help") == 0) {
+			show_help();
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			fprintf(stderr, "Error: Unknown or incomplete argument '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+		if (strcmp(argv[i], "--filter") == 0)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--hit-ratio") == 0)
+			hitRatio = atof(argv[++i]);
+		else if (strcmp(argv[i], "--set-size") == 0)
+			setSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--iterations") == 0)
+			iterations = atol(argv[++i]);
+		else if (strcmp(argv[i], "--samples") == 0)
+			samples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0)
+			seed = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--label") == 0)
+			label = argv[++i];
+		else if (strcmp(argv[i], "--json") == 0)
+			jsonFname = argv[++i];
+		else if (strcmp(argv[i], "--compare") == 0)
+			compareFname = argv[++i];
+		else {
+			fprintf(stderr, "Error: Unknown argument '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+	}
+
+	if (hitRatio < 0 || hitRatio > 1) {
+		fprintf(stderr, "Error: Argument hit-ratio must be between 0 and 1\n");
+		return 1;
+	}
+	if (setSize <= 0 || iterations <= 0 || samples <= 1) {
+		fprintf(stderr, "Error: Arguments set-size and iterations must be positive, samples must be at least 2\n");
+		return 1;
+	}
+
+	JSONValue baseline;
+	if (compareFname != NULL && read_json(compareFname, &baseline) != 0)
+		return 1;
+
+	BenchData data;
+	rngState = seed ? seed : DEFAULT_SEED;
+	create_bench_data(&data, setSize, hitRatio);
+
+	int casesLength = sizeof(benchCases) / sizeof(benchCases[0]);
+	BenchResult *results = malloc(sizeof(BenchResult) * casesLength);
+	int resultsLength = 0;
+
+	printf("%-26s %12s %10s %12s %12s %8s", "kernel", "ns/op", "+/-95%", "cycles/op", "Mops/s", "hit");
+	if (compareFname != NULL)
+		printf(" %10s", "vs base");
+	printf("\n");
+
+	for (int i = 0; i < casesLength; i++) {
+		if (filter != NULL && strstr(benchCases[i].name, filter) == NULL)
+			continue;
+
+		BenchResult *resultRef = &results[resultsLength++];
+		run_case(&benchCases[i], &data, iterations, samples, resultRef);
+
+		printf("%-26s %12.3f %10.3f %12.2f %12.2f", resultRef->name, resultRef->nsPerOp, resultRef->nsCi95,
+			   resultRef->cyclesPerOp, resultRef->mopsPerSecond);
+		if (resultRef->hitRatio >= 0)
+			printf(" %8.3f", resultRef->hitRatio);
+		else
+			printf(" %8s", "-");
+
+		double baseNs, baseCi;
+		if (compareFname != NULL) {
+			if (find_baseline(&baseline, resultRef->name, &baseNs, &baseCi) == 0 && baseNs > 0) {
+				double change = (resultRef->nsPerOp - baseNs) / baseNs * 100;
+				// Only call out changes where the confidence intervals do not overlap
+				int significant = fabs(resultRef->nsPerOp - baseNs) > resultRef->nsCi95 + baseCi;
+				printf(" %+9.1f%%%s", change, significant ? " *" : "");
+			}
+			else {
+				printf(" %10s", "-");
+			}
+		}
+		printf("\n");
+	}
+
+	if (compareFname != NULL)
+		printf("\n* change is larger than the combined 95%% confidence intervals\n");
+	if (BENCH_HAVE_TSC == 0)
+		printf("\nNote: cycle counts are not available on this architecture\n");
+
+	if (jsonFname != NULL) {
+		if (write_results_json(jsonFname, label, results, resultsLength, iterations, setSize, hitRatio, seed) != 0)
+			return 1;
+		printf("\n[INFO] Wrote results to '%s'\n", jsonFname);
+	}
+
+	free(results);
+	return 0;
+}
@@ -0,0 +1,332 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "batch.h"
+#include "json.h"
+#include "raycaster_helpers.h"
+#include "constants.h"
+#include "ppm.h"
+#include "shadowmap.h"
+#include "mesh.h"
+#include "kernels.h"
+#include "material.h"
+
+// The longest line of a batch file
+#define BATCH_LINE_LENGTH 4096
+
+/**
+ * The time since an arbitrary point in the past in seconds
+ */
+static double batch_seconds() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/**
+ * Set up an empty, open queue
+ */
+static void batch_queue_init(BatchQueue *queueRef) {
+	queueRef->head = 0;
+	queueRef->length = 0;
+	queueRef->closed = FALSE;
+	pthread_mutex_init(&queueRef->lock, NULL);
+	pthread_cond_init(&queueRef->changed, NULL);
+}
+
+/**
+ * Release the lock and condition of a queue no stage uses anymore
+ */
+static void batch_queue_destroy(BatchQueue *queueRef) {
+	pthread_mutex_destroy(&queueRef->lock);
+	pthread_cond_destroy(&queueRef->changed);
+}
+
+/**
+ * Hand a job to the next stage, waiting while the queue is full
+ */
+static void batch_queue_push(BatchQueue *queueRef, BatchJob *jobRef) {
+	pthread_mutex_lock(&queueRef->lock);
+	while (queueRef->length == BATCH_QUEUE_LENGTH)
+		pthread_cond_wait(&queueRef->changed, &queueRef->lock);
+	queueRef->jobs[(queueRef->head + queueRef->length) % BATCH_QUEUE_LENGTH] = jobRef;
+	queueRef->length++;
+	pthread_cond_broadcast(&queueRef->changed);
+	pthread_mutex_unlock(&queueRef->lock);
+}
+
+/**
+ * Tell the next stage no more jobs are coming
+ */
+static void batch_queue_close(BatchQueue *queueRef) {
+	pthread_mutex_lock(&queueRef->lock);
+	queueRef->closed = TRUE;
+	pthread_cond_broadcast(&queueRef->changed);
+	pthread_mutex_unlock(&queueRef->lock);
+}
+
+/**
+ * Take the next job from the stage before, waiting while the queue is empty
+ * @return The job, or NULL once the queue is closed and empty
+ */
+static BatchJob *batch_queue_pop(BatchQueue *queueRef) {
+	BatchJob *jobRef = NULL;
+
+	pthread_mutex_lock(&queueRef->lock);
+	while (queueRef->length == 0 && !queueRef->closed)
+		pthread_cond_wait(&queueRef->changed, &queueRef->lock);
+	if (queueRef->length > 0) {
+		jobRef = queueRef->jobs[queueRef->head];
+		queueRef->head = (queueRef->head + 1) % BATCH_QUEUE_LENGTH;
+		queueRef->length--;
+		pthread_cond_broadcast(&queueRef->changed);
+	}
+	pthread_mutex_unlock(&queueRef->lock);
+	return jobRef;
+}
+
+/**
+ * Read the jobs of a batch file, one '<width> <height> <input_scene> <output_file>' per line. Blank
+ * lines and lines starting with '#' are skipped.
+ * @param batchRef - Set to the jobs read
+ * @param batchFname - The batch file
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int batch_read_jobs(Batch *batchRef, char *batchFname) {
+	FILE *fp = fopen(batchFname, "r");
+	char line[BATCH_LINE_LENGTH];
+	char inputFname[BATCH_LINE_LENGTH];
+	char outputFname[BATCH_LINE_LENGTH];
+	int capacity = 0;
+	int lineNumber = 0;
+
+	batchRef->jobs = NULL;
+	batchRef->jobsLength = 0;
+	if (fp == NULL) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", batchFname);
+		return 1;
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		BatchJob job = {0};
+		char *start = line + strspn(line, " \t\r\n");
+		lineNumber++;
+		if (*start == '\0' || *start == '#')
+			continue;
+		if (sscanf(start, "%d %d %4095s %4095s", &job.width, &job.height, inputFname, outputFname) != 4 ||
+			job.width <= 0 || job.height <= 0) {
+			fprintf(stderr, "Error: Line %d of batch file '%s' must be <width> <height> <input_scene> <output_file>\n",
+					lineNumber, batchFname);
+			fclose(fp);
+			return 1;
+		}
+		if (batchRef->jobsLength == capacity) {
+			capacity = capacity > 0 ? capacity * 2 : 16;
+			BatchJob *jobs = realloc(batchRef->jobs, sizeof(BatchJob) * capacity);
+			if (jobs == NULL) {
+				fprintf(stderr, "Error: Could not allocate the batch jobs\n");
+				fclose(fp);
+				return 1;
+			}
+			batchRef->jobs = jobs;
+		}
+		job.inputFname = strdup(inputFname);
+		job.outputFname = strdup(outputFname);
+		batchRef->jobs[batchRef->jobsLength++] = job;
+	}
+	fclose(fp);
+
+	if (batchRef->jobsLength == 0) {
+		fprintf(stderr, "Error: Batch file '%s' has no jobs\n", batchFname);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Parse the scene of a job and bake everything its render needs, like a single render does
+ * @param batchRef - The batch
+ * @param jobRef - The job whose scene is loaded
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int batch_load_scene(Batch *batchRef, BatchJob *jobRef) {
+	BatchSettings *settingsRef = batchRef->settingsRef;
+	JSONValue JSONRoot;
+
+	if (read_json(jobRef->inputFname, &JSONRoot) != 0)
+		return 1;
+	int result = create_scene_from_JSON(&JSONRoot, &jobRef->scene);
+	free_JSONValue(&JSONRoot);
+	if (result != 0)
+		return 1;
+	scene_bake_light_bounds(&jobRef->scene, settingsRef->lightCutoff);
+	if (scene_pack_primitives(&jobRef->scene) != 0)
+		return 1;
+	if (jobRef->scene.lightsLength >= LIGHT_TREE_MIN_LIGHTS || batchRef->optionsRef->lightSamples > 0) {
+		if (light_tree_build(&jobRef->lightTree, &jobRef->scene) != 0)
+			return 1;
+		jobRef->scene.lightTreeRef = &jobRef->lightTree;
+	}
+	// The loader runs beside a render, so it bakes on its own thread instead of taking the render's cores
+	if (settingsRef->shadowMapResolution > 0 &&
+		scene_bake_shadow_maps(&jobRef->scene, settingsRef->shadowMapResolution, settingsRef->shadowBias, 1) != 0)
+		return 1;
+	return 0;
+}
+
+/**
+ * Release the scene of a job once it is rendered, or once loading it failed
+ * @param jobRef - The job whose scene is freed
+ */
+static void batch_free_scene(BatchJob *jobRef) {
+	if (jobRef->scene.lightTreeRef != NULL)
+		light_tree_free(&jobRef->lightTree);
+	scene_free_shadow_maps(&jobRef->scene);
+	scene_free_meshes(&jobRef->scene);
+	scene_free_pack(&jobRef->scene);
+	scene_free_materials(&jobRef->scene);
+	scene_free_primitives(&jobRef->scene);
+}
+
+/**
+ * Load the scene of a job, a job whose scene could not be loaded is marked as failed
+ * @param batchRef - The batch
+ * @param jobRef - The job to load
+ * @return The job
+ */
+static BatchJob *batch_load_job(Batch *batchRef, BatchJob *jobRef) {
+	if (batch_load_scene(batchRef, jobRef) != 0) {
+		fprintf(stderr, "Error: Batch job %d could not load its scene '%s'\n", (int) (jobRef - batchRef->jobs) + 1,
+				jobRef->inputFname);
+		batch_free_scene(jobRef);
+		jobRef->failed = TRUE;
+	}
+	return jobRef;
+}
+
+/**
+ * Save the image of a rendered job and free it, a job whose image could not be saved is marked as failed
+ * @param batchRef - The batch
+ * @param jobRef - The job to save
+ */
+static void batch_save_job(Batch *batchRef, BatchJob *jobRef) {
+	if (jobRef->failed)
+		return;
+	if (save_ppm_p6_image(&jobRef->image, jobRef->outputFname) != 0) {
+		fprintf(stderr, "Error: Batch job %d could not save its image '%s'\n", (int) (jobRef - batchRef->jobs) + 1,
+				jobRef->outputFname);
+		jobRef->failed = TRUE;
+	}
+	free(jobRef->image.pixmapRef);
+	jobRef->image.pixmapRef = NULL;
+}
+
+/**
+ * The loader stage, parses and bakes the scene of every job in order
+ * @param argRef - The batch
+ * @return NULL
+ */
+static void *batch_loader(void *argRef) {
+	Batch *batchRef = argRef;
+
+	for (int i = 0; i < batchRef->jobsLength; i++)
+		batch_queue_push(&batchRef->loaded, batch_load_job(batchRef, &batchRef->jobs[i]));
+	batch_queue_close(&batchRef->loaded);
+	return NULL;
+}
+
+/**
+ * The writer stage, saves the image of every job in order
+ * @param argRef - The batch
+ * @return NULL
+ */
+static void *batch_writer(void *argRef) {
+	Batch *batchRef = argRef;
+	BatchJob *jobRef;
+
+	while ((jobRef = batch_queue_pop(&batchRef->rendered)) != NULL)
+		batch_save_job(batchRef, jobRef);
+	return NULL;
+}
+
+/**
+ * Render every job of a batch file as a pipeline: while the calling thread renders a job with every
+ * render thread, a loader thread parses and bakes the scenes of the next jobs and a writer thread saves
+ * the images of the previous ones. Bounded queues between the stages keep at most BATCH_QUEUE_LENGTH
+ * scenes and images waiting, so a fast stage blocks instead of filling memory.
+ * @param batchFname - The batch file, one '<width> <height> <input_scene> <output_file>' per line
+ * @param optionsRef - The options of every render
+ * @param settingsRef - How every scene is prepared
+ * @return 0 if every job succeeded, otherwise at least one failed and the others were still rendered
+ */
+int batch_run(char *batchFname, RenderOptions *optionsRef, BatchSettings *settingsRef) {
+	Batch batch;
+	pthread_t loaderId;
+	pthread_t writerId;
+	BatchJob *jobRef;
+	int failures = 0;
+
+	if (batch_read_jobs(&batch, batchFname) != 0) {
+		for (int i = 0; i < batch.jobsLength; i++) {
+			free(batch.jobs[i].inputFname);
+			free(batch.jobs[i].outputFname);
+		}
+		free(batch.jobs);
+		return 1;
+	}
+	batch.optionsRef = optionsRef;
+	batch.settingsRef = settingsRef;
+	batch_queue_init(&batch.loaded);
+	batch_queue_init(&batch.rendered);
+	printf("[INFO] Rendering %d batch job(s) from '%s'\n", batch.jobsLength, batchFname);
+
+	double batchStart = batch_seconds();
+	// Without a helper thread its stage runs on this thread between the renders
+	int loaderStarted = pthread_create(&loaderId, NULL, batch_loader, &batch) == 0;
+	int writerStarted = pthread_create(&writerId, NULL, batch_writer, &batch) == 0;
+	if (!loaderStarted || !writerStarted)
+		fprintf(stderr, "Warning: Could not start every batch thread, some stages run between renders\n");
+
+	for (int i = 0; i < batch.jobsLength; i++) {
+		jobRef = loaderStarted ? batch_queue_pop(&batch.loaded) : batch_load_job(&batch, &batch.jobs[i]);
+		if (!jobRef->failed) {
+			double renderStart = batch_seconds();
+			if (raycast(&jobRef->scene, &jobRef->image, jobRef->width, jobRef->height, optionsRef) != 0) {
+				fprintf(stderr, "Error: Batch job %d could not be rendered\n", i + 1);
+				jobRef->failed = TRUE;
+			}
+			else {
+				printf("[INFO] Batch job %d of %d: rendered '%s' at %dx%d in %.3f s\n", i + 1, batch.jobsLength,
+					   jobRef->inputFname, jobRef->width, jobRef->height, batch_seconds() - renderStart);
+			}
+			batch_free_scene(jobRef);
+		}
+
+		if (writerStarted)
+			batch_queue_push(&batch.rendered, jobRef);
+		else
+			batch_save_job(&batch, jobRef);
+	}
+
+	batch_queue_close(&batch.rendered);
+	if (loaderStarted)
+		pthread_join(loaderId, NULL);
+	if (writerStarted)
+		pthread_join(writerId, NULL);
+
+	for (int i = 0; i < batch.jobsLength; i++) {
+		failures += batch.jobs[i].failed;
+		free(batch.jobs[i].inputFname);
+		free(batch.jobs[i].outputFname);
+	}
+	printf("[INFO] Finished %d of %d batch job(s) in %.3f s\n", batch.jobsLength - failures, batch.jobsLength,
+		   batch_seconds() - batchStart);
+	free(batch.jobs);
+	batch_queue_destroy(&batch.loaded);
+	batch_queue_destroy(&batch.rendered);
+	return failures > 0 ? 1 : 0;
+}
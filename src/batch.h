@@ -0,0 +1,67 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_BATCH_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_BATCH_H
+
+#include <pthread.h>
+#include "raycaster.h"
+#include "lighttree.h"
+
+// The jobs waiting between two stages, a stage ahead of the next one blocks instead of piling up scenes or images
+#define BATCH_QUEUE_LENGTH 2
+
+/**
+ * Batch Settings - how every scene of a batch is prepared before it is rendered
+ */
+typedef struct BatchSettings {
+	double lightCutoff;
+	int shadowMapResolution;
+	double shadowBias;
+} BatchSettings;
+
+/**
+ * Batch Job - one line of a batch file, then the scene loaded for it and the image rendered from it.
+ * A job which failed in one stage still passes through the later ones, so jobs finish in order.
+ */
+typedef struct BatchJob {
+	int width;
+	int height;
+	char *inputFname;
+	char *outputFname;
+	Scene scene;
+	LightTree lightTree;
+	Image image;
+	int failed;
+} BatchJob;
+
+/**
+ * Batch Queue - a bounded ring of jobs handed from one stage to the next, closed once the stage
+ * before it has pushed its last job
+ */
+typedef struct BatchQueue {
+	BatchJob *jobs[BATCH_QUEUE_LENGTH];
+	int head;
+	int length;
+	int closed;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} BatchQueue;
+
+/**
+ * Batch - the jobs of a batch file and the queues between its stages: a loader thread parses and
+ * bakes the scenes, the calling thread renders them, and a writer thread saves the images
+ */
+typedef struct Batch {
+	BatchJob *jobs;
+	int jobsLength;
+	RenderOptions *optionsRef;
+	BatchSettings *settingsRef;
+	BatchQueue loaded;
+	BatchQueue rendered;
+} Batch;
+
+int batch_run(char *batchFname, RenderOptions *optionsRef, BatchSettings *settingsRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_BATCH_H
@@ -0,0 +1,385 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "constants.h"
+#include "trace.h"
+#include "mesh.h"
+
+// The offset basis and prime of 64 bit FNV-1a
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/**
+ * Set up a checkpoint, nothing is read or written until the render starts
+ * @param checkpointRef - The checkpoint to initialize
+ * @param fname - The sidecar file to write
+ * @param intervalSeconds - The time between checkpoints
+ * @param resume - TRUE to continue from the sidecar file if it exists
+ */
+void checkpoint_init(Checkpoint *checkpointRef, char *fname, double intervalSeconds, int resume) {
+	memset(checkpointRef, 0, sizeof(Checkpoint));
+	checkpointRef->fname = fname;
+	checkpointRef->intervalSeconds = intervalSeconds;
+	checkpointRef->resume = resume;
+	checkpointRef->sceneHash = FNV_OFFSET_BASIS;
+	checkpointRef->optionsHash = FNV_OFFSET_BASIS;
+}
+
+/**
+ * Fold bytes into a 64 bit FNV-1a hash
+ */
+static void hash_bytes(uint64_t *hashRef, const void *bytes, size_t length) {
+	const uint8_t *data = bytes;
+	uint64_t hash = *hashRef;
+
+	for (size_t i = 0; i < length; i++) {
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+	*hashRef = hash;
+}
+
+/**
+ * Fold the contents of a file into a hash
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int hash_file(uint64_t *hashRef, char *fname) {
+	FILE *fp = fopen(fname, "rb");
+	uint8_t buffer[4096];
+	size_t length;
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+	while ((length = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		hash_bytes(hashRef, buffer, length);
+	fclose(fp);
+	return 0;
+}
+
+/**
+ * Fold the scene file into the scene hash, a checkpoint is only resumed against an identical scene
+ * @param checkpointRef - The checkpoint to store the hash in
+ * @param sceneFname - The scene file
+ * @return 0 if success, otherwise a failure occurred
+ */
+int checkpoint_hash_file(Checkpoint *checkpointRef, char *sceneFname) {
+	return hash_file(&checkpointRef->sceneHash, sceneFname);
+}
+
+/**
+ * Fold the model file of every mesh of a scene into the scene hash, so a model changed since the
+ * checkpoint was written is caught even though the scene file is the same
+ * @param checkpointRef - The checkpoint to store the hash in
+ * @param sceneRef - The loaded scene
+ * @return 0 if success, otherwise a failure occurred
+ */
+int checkpoint_hash_meshes(Checkpoint *checkpointRef, Scene *sceneRef) {
+	for (int i = 0; i < sceneRef->primitivesLength; i++) {
+		if (sceneRef->primitives[i]->type != MESH_T)
+			continue;
+		MeshData *meshRef = sceneRef->primitives[i]->data.mesh.dataRef;
+		if (meshRef->fname == NULL) {
+			fprintf(stderr, "Error: Mesh primitive %d does not know its model file\n", i);
+			return 1;
+		}
+		if (hash_file(&checkpointRef->sceneHash, meshRef->fname) != 0)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Fold an option which changes the pixels of the render into the options hash
+ * @param checkpointRef - The checkpoint to store the hash in
+ * @param name - The name of the option
+ * @param value - The value of the option
+ */
+void checkpoint_hash_option(Checkpoint *checkpointRef, char *name, double value) {
+	hash_bytes(&checkpointRef->optionsHash, name, strlen(name) + 1);
+	hash_bytes(&checkpointRef->optionsHash, &value, sizeof(value));
+}
+
+/**
+ * Fold an option naming a file which changes the pixels of the render into the options hash, the
+ * contents of the file are hashed rather than its name
+ * @param checkpointRef - The checkpoint to store the hash in
+ * @param name - The name of the option
+ * @param fname - The file
+ * @return 0 if success, otherwise a failure occurred
+ */
+int checkpoint_hash_option_file(Checkpoint *checkpointRef, char *name, char *fname) {
+	hash_bytes(&checkpointRef->optionsHash, name, strlen(name) + 1);
+	return hash_file(&checkpointRef->optionsHash, fname);
+}
+
+/**
+ * Describe the render in a checkpoint header
+ */
+static void fill_header(Checkpoint *checkpointRef, RenderContext *contextRef, CheckpointHeader *headerRef) {
+	memset(headerRef, 0, sizeof(CheckpointHeader));
+	memcpy(headerRef->magic, CHECKPOINT_MAGIC, sizeof(headerRef->magic));
+	headerRef->sceneHash = checkpointRef->sceneHash;
+	headerRef->optionsHash = checkpointRef->optionsHash;
+	headerRef->frameWidth = contextRef->frameWidth;
+	headerRef->frameHeight = contextRef->frameHeight;
+	headerRef->regionX = contextRef->originX;
+	headerRef->regionY = contextRef->originY;
+	headerRef->regionWidth = contextRef->imageWidth;
+	headerRef->regionHeight = contextRef->imageHeight;
+	headerRef->tileSize = contextRef->tileSize;
+	headerRef->tilesLength = contextRef->tilesLength;
+}
+
+/**
+ * Count the finished tiles
+ */
+static int count_done(atomic_int *tilesDone, int tilesLength) {
+	int done = 0;
+	for (int i = 0; i < tilesLength; i++) {
+		if (atomic_load_explicit(&tilesDone[i], memory_order_acquire))
+			done++;
+	}
+	return done;
+}
+
+/**
+ * Write the finished tiles to a temporary file then rename it over the sidecar, so a crash during
+ * the write leaves the previous checkpoint intact. The tile flags are read before the pixels, so every
+ * tile marked as finished has all of its pixels in the file even while render threads keep writing.
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int checkpoint_write(Checkpoint *checkpointRef) {
+	RenderContext *contextRef = checkpointRef->contextRef;
+	int tilesLength = contextRef->tilesLength;
+	size_t pixels = (size_t) contextRef->imageWidth * contextRef->imageHeight;
+	char *tempFname = malloc(strlen(checkpointRef->fname) + 5);
+	uint8_t *done = malloc((size_t) tilesLength);
+	CheckpointHeader header;
+	int result = 0;
+
+	for (int i = 0; i < tilesLength; i++)
+		done[i] = atomic_load_explicit(&checkpointRef->tilesDone[i], memory_order_acquire) ? 1 : 0;
+	fill_header(checkpointRef, contextRef, &header);
+	sprintf(tempFname, "%s.tmp", checkpointRef->fname);
+
+	FILE *fp = fopen(tempFname, "wb");
+	if (!fp) {
+		fprintf(stderr, "Warning: Checkpoint '%s' could not be opened for writing\n", tempFname);
+		free(tempFname);
+		free(done);
+		return 1;
+	}
+	if (fwrite(&header, sizeof(CheckpointHeader), 1, fp) != 1 ||
+		fwrite(done, 1, (size_t) tilesLength, fp) != (size_t) tilesLength ||
+		fwrite(checkpointRef->pixmapRef, sizeof(RGBApixel), pixels, fp) != pixels ||
+		fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+		fprintf(stderr, "Warning: Checkpoint '%s' could not be written\n", tempFname);
+		result = 1;
+	}
+	fclose(fp);
+
+	if (result == 0 && rename(tempFname, checkpointRef->fname) != 0) {
+		fprintf(stderr, "Warning: Checkpoint '%s' could not be renamed to '%s'\n", tempFname, checkpointRef->fname);
+		result = 1;
+	}
+	if (result != 0)
+		remove(tempFname);
+	else
+		checkpointRef->written++;
+
+	free(tempFname);
+	free(done);
+	return result;
+}
+
+/**
+ * Restore the finished tiles of an earlier render. Nothing is restored if the sidecar file does not
+ * exist, but a checkpoint of a different scene or model, different pixel-affecting options, or a different
+ * resolution, region or tile size is refused.
+ * @param checkpointRef - The checkpoint to read
+ * @param contextRef - The prepared render to restore the pixels into
+ * @param tilesDone - Set for each tile restored
+ * @return 0 if success, otherwise a failure occurred
+ */
+int checkpoint_load(Checkpoint *checkpointRef, RenderContext *contextRef, atomic_int *tilesDone) {
+	FILE *fp = fopen(checkpointRef->fname, "rb");
+	size_t pixels = (size_t) contextRef->imageWidth * contextRef->imageHeight;
+	CheckpointHeader header;
+	CheckpointHeader expected;
+
+	if (!fp) {
+		printf("[INFO] No checkpoint found at '%s', starting from the beginning\n", checkpointRef->fname);
+		return 0;
+	}
+
+	fill_header(checkpointRef, contextRef, &expected);
+	if (fread(&header, sizeof(CheckpointHeader), 1, fp) != 1 ||
+		memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "Error: File '%s' is not a checkpoint\n", checkpointRef->fname);
+		fclose(fp);
+		return 1;
+	}
+	if (header.sceneHash != expected.sceneHash) {
+		fprintf(stderr, "Error: Checkpoint '%s' was written for a different scene or model\n", checkpointRef->fname);
+		fclose(fp);
+		return 1;
+	}
+	if (header.optionsHash != expected.optionsHash) {
+		fprintf(stderr, "Error: Checkpoint '%s' was written with different light-cutoff, light-samples, shadow-maps, "
+						"shadow-bias, sparse or relight options\n", checkpointRef->fname);
+		fclose(fp);
+		return 1;
+	}
+	if (memcmp(&header, &expected, sizeof(CheckpointHeader)) != 0) {
+		fprintf(stderr, "Error: Checkpoint '%s' was written for a %dx%d frame (region %dx%d+%d+%d, tile size %d), "
+						"this render is a %dx%d frame (region %dx%d+%d+%d, tile size %d)\n", checkpointRef->fname,
+				header.frameWidth, header.frameHeight, header.regionWidth, header.regionHeight, header.regionX,
+				header.regionY, header.tileSize, expected.frameWidth, expected.frameHeight, expected.regionWidth,
+				expected.regionHeight, expected.regionX, expected.regionY, expected.tileSize);
+		fclose(fp);
+		return 1;
+	}
+
+	uint8_t *done = malloc((size_t) header.tilesLength);
+	if (fread(done, 1, (size_t) header.tilesLength, fp) != (size_t) header.tilesLength ||
+		fread(contextRef->framebuffer, sizeof(RGBApixel), pixels, fp) != pixels) {
+		fprintf(stderr, "Error: Checkpoint '%s' ended before all of the tiles were read\n", checkpointRef->fname);
+		free(done);
+		fclose(fp);
+		return 1;
+	}
+	for (int i = 0; i < header.tilesLength; i++)
+		atomic_store(&tilesDone[i], done[i] ? TRUE : FALSE);
+	free(done);
+	fclose(fp);
+
+	printf("[INFO] Resuming from checkpoint '%s', %d of %d tiles are already finished\n", checkpointRef->fname,
+		   count_done(tilesDone, contextRef->tilesLength), contextRef->tilesLength);
+	return 0;
+}
+
+/**
+ * The checkpoint thread, writes a checkpoint every interval until it is stopped
+ * @param argRef - The Checkpoint
+ * @return NULL
+ */
+static void *checkpoint_writer(void *argRef) {
+	Checkpoint *checkpointRef = argRef;
+	TraceRecorder *traceRef = checkpointRef->contextRef->optionsRef->traceRef;
+	TraceBuffer *traceBufferRef = trace_thread_buffer(traceRef, "checkpoint writer", -1);
+	double wholeSeconds = (double) (long) checkpointRef->intervalSeconds;
+
+	pthread_mutex_lock(&checkpointRef->lock);
+	while (!checkpointRef->stopping) {
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (time_t) wholeSeconds;
+		deadline.tv_nsec += (long) ((checkpointRef->intervalSeconds - wholeSeconds) * 1e9);
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		int waitResult = 0;
+		while (!checkpointRef->stopping && waitResult != ETIMEDOUT)
+			waitResult = pthread_cond_timedwait(&checkpointRef->wake, &checkpointRef->lock, &deadline);
+		if (checkpointRef->stopping)
+			break;
+
+		// Render threads never take this lock, the write holds it so checkpoint_hold can wait the writer out
+		double writeStart = trace_now(traceRef);
+		checkpoint_write(checkpointRef);
+		trace_span(traceBufferRef, "checkpoint", writeStart, trace_now(traceRef));
+	}
+	pthread_mutex_unlock(&checkpointRef->lock);
+
+	return NULL;
+}
+
+/**
+ * Start writing checkpoints in the background
+ * @param checkpointRef - The checkpoint
+ * @param contextRef - The render being checkpointed
+ * @param pixmapRef - The framebuffer render workers write into
+ * @param tilesDone - The flags render workers set once a tile is finished
+ * @return 0 if success, otherwise a failure occurred
+ */
+int checkpoint_start(Checkpoint *checkpointRef, RenderContext *contextRef, RGBApixel *pixmapRef, atomic_int *tilesDone) {
+	checkpointRef->contextRef = contextRef;
+	checkpointRef->pixmapRef = pixmapRef;
+	checkpointRef->tilesDone = tilesDone;
+	checkpointRef->stopping = FALSE;
+	pthread_mutex_init(&checkpointRef->lock, NULL);
+	pthread_cond_init(&checkpointRef->wake, NULL);
+
+	if (pthread_create(&checkpointRef->thread, NULL, checkpoint_writer, checkpointRef) != 0) {
+		fprintf(stderr, "Warning: Could not start the checkpoint thread, no checkpoints will be written\n");
+		pthread_mutex_destroy(&checkpointRef->lock);
+		pthread_cond_destroy(&checkpointRef->wake);
+		return 1;
+	}
+	checkpointRef->running = TRUE;
+	return 0;
+}
+
+/**
+ * Stop the checkpoint thread. If the render did not finish a last checkpoint is written so that it
+ * can be resumed from exactly where it stopped.
+ * @param checkpointRef - The checkpoint
+ */
+void checkpoint_stop(Checkpoint *checkpointRef) {
+	if (!checkpointRef->running)
+		return;
+
+	pthread_mutex_lock(&checkpointRef->lock);
+	checkpointRef->stopping = TRUE;
+	pthread_cond_signal(&checkpointRef->wake);
+	pthread_mutex_unlock(&checkpointRef->lock);
+	pthread_join(checkpointRef->thread, NULL);
+	pthread_mutex_destroy(&checkpointRef->lock);
+	pthread_cond_destroy(&checkpointRef->wake);
+	checkpointRef->running = FALSE;
+
+	int tilesLength = checkpointRef->contextRef->tilesLength;
+	if (count_done(checkpointRef->tilesDone, tilesLength) < tilesLength)
+		checkpoint_write(checkpointRef);
+}
+
+/**
+ * Keep the checkpoint thread idle until checkpoint_release, waiting for a write in progress to finish.
+ * A process forked while the thread is inside the allocator or stdio would inherit their locks held, so
+ * render processes are only forked while the thread is held.
+ * @param checkpointRef - The checkpoint
+ */
+void checkpoint_hold(Checkpoint *checkpointRef) {
+	if (checkpointRef != NULL && checkpointRef->running)
+		pthread_mutex_lock(&checkpointRef->lock);
+}
+
+/**
+ * Let the checkpoint thread continue after checkpoint_hold
+ * @param checkpointRef - The checkpoint
+ */
+void checkpoint_release(Checkpoint *checkpointRef) {
+	if (checkpointRef != NULL && checkpointRef->running)
+		pthread_mutex_unlock(&checkpointRef->lock);
+}
+
+/**
+ * Delete the sidecar file once the output has been saved
+ * @param checkpointRef - The checkpoint
+ */
+void checkpoint_remove(Checkpoint *checkpointRef) {
+	if (remove(checkpointRef->fname) != 0 && errno != ENOENT)
+		fprintf(stderr, "Warning: Checkpoint '%s' could not be removed\n", checkpointRef->fname);
+}
@@ -0,0 +1,67 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_CHECKPOINT_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_CHECKPOINT_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "raycaster.h"
+
+#define DEFAULT_CHECKPOINT_INTERVAL 60.0
+#define CHECKPOINT_MAGIC "RTCKPT3\n"
+
+/**
+ * The fixed size start of a checkpoint file, followed by one byte per tile (1 when finished) and
+ * then the framebuffer of the rendered region, tile by tile
+ */
+typedef struct CheckpointHeader {
+	char magic[8];
+	uint64_t sceneHash;
+	uint64_t optionsHash;
+	int32_t frameWidth;
+	int32_t frameHeight;
+	int32_t regionX;
+	int32_t regionY;
+	int32_t regionWidth;
+	int32_t regionHeight;
+	int32_t tileSize;
+	int32_t tilesLength;
+} CheckpointHeader;
+
+/**
+ * Checkpoint - a sidecar file holding the finished tiles of a render, rewritten periodically by a
+ * background thread so that render threads never wait on it
+ */
+typedef struct Checkpoint {
+	char *fname;
+	double intervalSeconds;
+	int resume;
+	uint64_t sceneHash;
+	uint64_t optionsHash;
+	RenderContext *contextRef;
+	RGBApixel *pixmapRef;
+	atomic_int *tilesDone;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int running;
+	int stopping;
+	int written;
+} Checkpoint;
+
+void checkpoint_init(Checkpoint *checkpointRef, char *fname, double intervalSeconds, int resume);
+int checkpoint_hash_file(Checkpoint *checkpointRef, char *sceneFname);
+int checkpoint_hash_meshes(Checkpoint *checkpointRef, Scene *sceneRef);
+void checkpoint_hash_option(Checkpoint *checkpointRef, char *name, double value);
+int checkpoint_hash_option_file(Checkpoint *checkpointRef, char *name, char *fname);
+int checkpoint_load(Checkpoint *checkpointRef, RenderContext *contextRef, atomic_int *tilesDone);
+int checkpoint_start(Checkpoint *checkpointRef, RenderContext *contextRef, RGBApixel *pixmapRef, atomic_int *tilesDone);
+void checkpoint_stop(Checkpoint *checkpointRef);
+void checkpoint_hold(Checkpoint *checkpointRef);
+void checkpoint_release(Checkpoint *checkpointRef);
+void checkpoint_remove(Checkpoint *checkpointRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_CHECKPOINT_H
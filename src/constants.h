@@ -9,5 +9,7 @@
 #define FALSE 0
 #define LOG_LEVEL 2
 #define INITIAL_BUFFER_SIZE 64
+#define MAX_RECURSE_DEPTH 100
+#define RENDER_STATS 1
 
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_CONSTANTS_H
\ No newline at end of file
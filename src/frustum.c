@@ -0,0 +1,237 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "frustum.h"
+#include "mesh.h"
+#include "constants.h"
+
+/**
+ * The tiles a sphere can be seen in. Camera rays through the sphere pass the view plane between the
+ * sphere's tangent planes through the camera, that range is widened by a pixel on every side so
+ * rounding never drops a sphere a camera ray hits.
+ * @param contextRef - The render
+ * @param centerRef - The center of the sphere
+ * @param radius - The radius of the sphere
+ * @param tiles - Set to the first and last column of tiles, then the first and last row
+ * @return TRUE if a camera ray of the render may hit the sphere, otherwise FALSE
+ */
+static int sphere_tiles(RenderContext *contextRef, V3 *centerRef, double radius, int tiles[4]) {
+	Camera *cameraRef = &contextRef->sceneRef->camera;
+	double x = centerRef->data.X, y = centerRef->data.Y, z = centerRef->data.Z;
+	double denominator = z*z - radius*radius;
+
+	tiles[0] = 0;
+	tiles[1] = contextRef->tilesX - 1;
+	tiles[2] = 0;
+	tiles[3] = contextRef->tilesY - 1;
+	// Camera rays all head towards the view plane, so a sphere behind the camera is never hit while one
+	// reaching past the camera may be seen anywhere
+	if (z + radius < 0)
+		return FALSE;
+	if (z <= radius || denominator < 1e-6 * (z*z + radius*radius))
+		return TRUE;
+
+	double spreadX = radius * sqrt(x*x + denominator);
+	double spreadY = radius * sqrt(y*y + denominator);
+	double minX = (x*z - spreadX) / denominator, maxX = (x*z + spreadX) / denominator;
+	double minY = (y*z - spreadY) / denominator, maxY = (y*z + spreadY) / denominator;
+	// The ray of column j passes X = -width/2 + pixelWidth*(originX + j + 0.5), rows count down from Y = height/2
+	double firstColumn = (minX + cameraRef->width/2) / contextRef->pixelWidth - contextRef->originX - 1.5;
+	double lastColumn = (maxX + cameraRef->width/2) / contextRef->pixelWidth - contextRef->originX + 0.5;
+	double firstRow = (cameraRef->height/2 - maxY) / contextRef->pixelHeight - contextRef->originY - 1.5;
+	double lastRow = (cameraRef->height/2 - minY) / contextRef->pixelHeight - contextRef->originY + 0.5;
+
+	if (lastColumn < 0 || lastRow < 0 || firstColumn > contextRef->imageWidth - 1 || firstRow > contextRef->imageHeight - 1)
+		return FALSE;
+	tiles[0] = (int) fmax(firstColumn, 0) / contextRef->tileSize;
+	tiles[1] = (int) fmin(lastColumn, contextRef->imageWidth - 1) / contextRef->tileSize;
+	tiles[2] = (int) fmax(firstRow, 0) / contextRef->tileSize;
+	tiles[3] = (int) fmin(lastRow, contextRef->imageHeight - 1) / contextRef->tileSize;
+	return TRUE;
+}
+
+/**
+ * Determine if a camera ray through a tile may hit a plane. A ray from the camera hits the plane when
+ * its direction points to the same side of the plane the plane lies on from the camera, the directions
+ * through the corners of the tile widened by a pixel bound every ray of the tile.
+ * @param contextRef - The render
+ * @param planeRef - The plane
+ * @param tileIndex - The tile
+ * @return TRUE if a camera ray of the tile may hit the plane, otherwise FALSE
+ */
+static int plane_in_tile(RenderContext *contextRef, Plane *planeRef, int tileIndex) {
+	Camera *cameraRef = &contextRef->sceneRef->camera;
+	V3 *normalRef = &planeRef->normal;
+	int tileX = (tileIndex % contextRef->tilesX) * contextRef->tileSize;
+	int tileY = (tileIndex / contextRef->tilesX) * contextRef->tileSize;
+	double side;
+
+	v3_dot(normalRef, &planeRef->position, &side);
+	if (side == 0)
+		return TRUE;
+	double left = -cameraRef->width/2 + contextRef->pixelWidth * (contextRef->originX + tileX - 1);
+	double right = -cameraRef->width/2 + contextRef->pixelWidth * (contextRef->originX + tileX + contextRef->tileSize + 1);
+	double top = cameraRef->height/2 - contextRef->pixelHeight * (contextRef->originY + tileY - 1);
+	double bottom = cameraRef->height/2 - contextRef->pixelHeight * (contextRef->originY + tileY + contextRef->tileSize + 1);
+	double corners[4][2] = {{left, top}, {right, top}, {left, bottom}, {right, bottom}};
+
+	for (int c = 0; c < 4; c++) {
+		double facing = normalRef->data.X * corners[c][0] + normalRef->data.Y * corners[c][1] + normalRef->data.Z;
+		if ((side > 0 ? facing : -facing) >= -1e-9)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * Count, or with fill set copy, the packed primitives of every tile's bin
+ */
+static void bin_primitives(RenderContext *contextRef, TileBins *binsRef, int fill) {
+	PrimitivePack *packRef = contextRef->sceneRef->packRef;
+	int tiles[4];
+
+	for (int k = 0; k < packRef->spheresLength; k++) {
+		Sphere *sphereRef = &packRef->spheres[k]->data.sphere;
+		if (!sphere_tiles(contextRef, &sphereRef->position, sphereRef->radius, tiles))
+			continue;
+		for (int tileY = tiles[2]; tileY <= tiles[3]; tileY++) {
+			for (int tileX = tiles[0]; tileX <= tiles[1]; tileX++) {
+				PrimitivePack *binRef = &binsRef->bins[tileY*contextRef->tilesX + tileX];
+				if (fill) {
+					binRef->x[binRef->spheresLength] = packRef->x[k];
+					binRef->y[binRef->spheresLength] = packRef->y[k];
+					binRef->z[binRef->spheresLength] = packRef->z[k];
+					binRef->radiusSquared[binRef->spheresLength] = packRef->radiusSquared[k];
+					binRef->spheres[binRef->spheresLength] = packRef->spheres[k];
+					binRef->sphereIndices[binRef->spheresLength] = packRef->sphereIndices[k];
+				}
+				binRef->spheresLength++;
+			}
+		}
+	}
+
+	for (int k = 0; k < packRef->othersLength; k++) {
+		Primitive *primitiveRef = packRef->others[k];
+		MeshData *meshRef = primitiveRef->type == MESH_T ? primitiveRef->data.mesh.dataRef : NULL;
+		tiles[0] = 0;
+		tiles[1] = contextRef->tilesX - 1;
+		tiles[2] = 0;
+		tiles[3] = contextRef->tilesY - 1;
+		// A mesh is binned by the sphere around the bounds of its hierarchy
+		if (meshRef != NULL && meshRef->nodesLength > 0) {
+			MeshNode *rootRef = &meshRef->nodes[0];
+			V3 center = {{(rootRef->boundsMin[0] + (double) rootRef->boundsMax[0]) / 2,
+						  (rootRef->boundsMin[1] + (double) rootRef->boundsMax[1]) / 2,
+						  (rootRef->boundsMin[2] + (double) rootRef->boundsMax[2]) / 2}};
+			V3 extent = {{rootRef->boundsMax[0] - (double) rootRef->boundsMin[0],
+						  rootRef->boundsMax[1] - (double) rootRef->boundsMin[1],
+						  rootRef->boundsMax[2] - (double) rootRef->boundsMin[2]}};
+			double diagonal;
+			v3_magnitude(&extent, &diagonal);
+			if (!sphere_tiles(contextRef, &center, diagonal / 2 * (1 + 1e-6) + MESH_MIN_DISTANCE, tiles))
+				continue;
+		}
+		for (int tileY = tiles[2]; tileY <= tiles[3]; tileY++) {
+			for (int tileX = tiles[0]; tileX <= tiles[1]; tileX++) {
+				int tileIndex = tileY*contextRef->tilesX + tileX;
+				PrimitivePack *binRef = &binsRef->bins[tileIndex];
+				if (primitiveRef->type == PLANE_T && !plane_in_tile(contextRef, &primitiveRef->data.plane, tileIndex))
+					continue;
+				if (fill) {
+					binRef->others[binRef->othersLength] = primitiveRef;
+					binRef->otherIndices[binRef->othersLength] = packRef->otherIndices[k];
+				}
+				binRef->othersLength++;
+			}
+		}
+	}
+}
+
+/**
+ * Bin the packed primitives of the scene by the tiles whose camera rays may hit them, so a camera ray
+ * only tests the primitives of its tile. Nothing is binned when the scene is not packed.
+ * @param contextRef - The prepared render, sets its tileBinsRef
+ * @return 0 if success, otherwise a failure occurred
+ */
+int tile_bins_build(RenderContext *contextRef) {
+	PrimitivePack *packRef = contextRef->sceneRef->packRef;
+	TileBins *binsRef;
+
+	contextRef->tileBinsRef = NULL;
+	if (packRef == NULL)
+		return 0;
+	binsRef = calloc(1, sizeof(TileBins));
+	if (binsRef == NULL || (binsRef->bins = calloc((size_t) contextRef->tilesLength, sizeof(PrimitivePack))) == NULL) {
+		fprintf(stderr, "Error: Could not allocate the tile bins\n");
+		free(binsRef);
+		return 1;
+	}
+	contextRef->tileBinsRef = binsRef;
+
+	bin_primitives(contextRef, binsRef, FALSE);
+	for (int i = 0; i < contextRef->tilesLength; i++) {
+		binsRef->spheresLength += binsRef->bins[i].spheresLength;
+		binsRef->othersLength += binsRef->bins[i].othersLength;
+	}
+	size_t spheres = binsRef->spheresLength > 0 ? binsRef->spheresLength : 1;
+	size_t others = binsRef->othersLength > 0 ? binsRef->othersLength : 1;
+	binsRef->x = malloc(sizeof(double) * spheres);
+	binsRef->y = malloc(sizeof(double) * spheres);
+	binsRef->z = malloc(sizeof(double) * spheres);
+	binsRef->radiusSquared = malloc(sizeof(double) * spheres);
+	binsRef->spheres = malloc(sizeof(Primitive *) * spheres);
+	binsRef->sphereIndices = malloc(sizeof(int) * spheres);
+	binsRef->others = malloc(sizeof(Primitive *) * others);
+	binsRef->otherIndices = malloc(sizeof(int) * others);
+	if (binsRef->x == NULL || binsRef->y == NULL || binsRef->z == NULL || binsRef->radiusSquared == NULL ||
+		binsRef->spheres == NULL || binsRef->sphereIndices == NULL || binsRef->others == NULL || binsRef->otherIndices == NULL) {
+		fprintf(stderr, "Error: Could not allocate the tile bins\n");
+		tile_bins_free(contextRef);
+		return 1;
+	}
+
+	// Every bin starts where the one before it ends and is filled again from empty
+	size_t sphereOffset = 0, otherOffset = 0;
+	for (int i = 0; i < contextRef->tilesLength; i++) {
+		PrimitivePack *binRef = &binsRef->bins[i];
+		binRef->x = binsRef->x + sphereOffset;
+		binRef->y = binsRef->y + sphereOffset;
+		binRef->z = binsRef->z + sphereOffset;
+		binRef->radiusSquared = binsRef->radiusSquared + sphereOffset;
+		binRef->spheres = binsRef->spheres + sphereOffset;
+		binRef->sphereIndices = binsRef->sphereIndices + sphereOffset;
+		binRef->others = binsRef->others + otherOffset;
+		binRef->otherIndices = binsRef->otherIndices + otherOffset;
+		sphereOffset += binRef->spheresLength;
+		otherOffset += binRef->othersLength;
+		binRef->spheresLength = 0;
+		binRef->othersLength = 0;
+	}
+	bin_primitives(contextRef, binsRef, TRUE);
+	return 0;
+}
+
+/**
+ * Release the tile bins of a render
+ * @param contextRef - The render whose bins are freed
+ */
+void tile_bins_free(RenderContext *contextRef) {
+	TileBins *binsRef = contextRef->tileBinsRef;
+
+	if (binsRef == NULL)
+		return;
+	free(binsRef->bins);
+	free(binsRef->x);
+	free(binsRef->y);
+	free(binsRef->z);
+	free(binsRef->radiusSquared);
+	free(binsRef->spheres);
+	free(binsRef->sphereIndices);
+	free(binsRef->others);
+	free(binsRef->otherIndices);
+	free(binsRef);
+	contextRef->tileBinsRef = NULL;
+}
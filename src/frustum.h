@@ -0,0 +1,32 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_FRUSTUM_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_FRUSTUM_H
+
+#include "raycaster.h"
+#include "kernels.h"
+
+/**
+ * Tile Bins - for every tile of a render the packed primitives a camera ray through the tile can hit,
+ * in the order of the scene's pack. The bins of all of the tiles share one array per field.
+ */
+typedef struct TileBins {
+	PrimitivePack *bins;
+	double *x;
+	double *y;
+	double *z;
+	double *radiusSquared;
+	Primitive **spheres;
+	int *sphereIndices;
+	Primitive **others;
+	int *otherIndices;
+	size_t spheresLength;
+	size_t othersLength;
+} TileBins;
+
+int tile_bins_build(RenderContext *contextRef);
+void tile_bins_free(RenderContext *contextRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_FRUSTUM_H
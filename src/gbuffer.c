@@ -0,0 +1,177 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "gbuffer.h"
+#include "raycaster.h"
+#include "mesh.h"
+
+/**
+ * The fixed size start of a G-buffer file, followed by one GBufferSample per pixel row by row
+ */
+typedef struct GBufferHeader {
+	char magic[8];
+	uint64_t geometryHash;
+	int32_t frameWidth;
+	int32_t frameHeight;
+	int32_t regionX;
+	int32_t regionY;
+	int32_t regionWidth;
+	int32_t regionHeight;
+} GBufferHeader;
+
+/**
+ * Add bytes to a 64 bit FNV-1a hash
+ */
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t length) {
+	const uint8_t *bytes = data;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Hash everything which decides what a camera ray hits: the camera and the shape and order of every
+ * primitive. Lights and materials are left out so they can be edited between captures.
+ * @param sceneRef - The scene to hash
+ * @return The hash
+ */
+uint64_t scene_geometry_hash(Scene *sceneRef) {
+	uint64_t hash = 14695981039346656037ULL;
+
+	hash = fnv1a(hash, &sceneRef->camera.width, sizeof(double));
+	hash = fnv1a(hash, &sceneRef->camera.height, sizeof(double));
+	hash = fnv1a(hash, &sceneRef->primitivesLength, sizeof(int));
+	for (int i = 0; i < sceneRef->primitivesLength; i++) {
+		Primitive *primitiveRef = sceneRef->primitives[i];
+		hash = fnv1a(hash, &primitiveRef->type, sizeof(primitiveRef->type));
+		switch (primitiveRef->type) {
+			case SPHERE_T:
+				hash = fnv1a(hash, &primitiveRef->data.sphere.position, sizeof(V3));
+				hash = fnv1a(hash, &primitiveRef->data.sphere.radius, sizeof(double));
+				break;
+			case PLANE_T:
+				hash = fnv1a(hash, &primitiveRef->data.plane.position, sizeof(V3));
+				hash = fnv1a(hash, &primitiveRef->data.plane.normal, sizeof(V3));
+				break;
+			case MESH_T: {
+				MeshData *meshRef = primitiveRef->data.mesh.dataRef;
+				hash = fnv1a(hash, &meshRef->trianglesLength, sizeof(int));
+				hash = fnv1a(hash, meshRef->vertices, sizeof(float) * 3 * meshRef->verticesLength);
+				hash = fnv1a(hash, meshRef->indices, sizeof(uint32_t) * 3 * meshRef->trianglesLength);
+				break;
+			}
+		}
+	}
+	return hash;
+}
+
+/**
+ * Allocate the samples of a G-buffer
+ * @param gbufferRef - The G-buffer to allocate
+ * @param regionRef - The region of the frame it covers
+ * @param geometryHash - The scene_geometry_hash of the scene it is captured from
+ * @return 0 if success, otherwise a failure occurred
+ */
+int gbuffer_alloc(GBuffer *gbufferRef, ImageRegion *regionRef, uint64_t geometryHash) {
+	gbufferRef->geometryHash = geometryHash;
+	gbufferRef->region = *regionRef;
+	gbufferRef->samples = malloc(sizeof(GBufferSample) * regionRef->width * regionRef->height);
+	if (gbufferRef->samples == NULL) {
+		fprintf(stderr, "Error: Could not allocate a G-buffer of %dx%d pixels\n", regionRef->width, regionRef->height);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Write a G-buffer to a file
+ * @param gbufferRef - The G-buffer to write
+ * @param fname - The output filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int save_gbuffer(GBuffer *gbufferRef, char *fname) {
+	FILE *fp = fopen(fname, "wb");
+	size_t length = (size_t) gbufferRef->region.width * gbufferRef->region.height;
+	GBufferHeader header;
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+
+	memset(&header, 0, sizeof(GBufferHeader));
+	memcpy(header.magic, GBUFFER_MAGIC, sizeof(header.magic));
+	header.geometryHash = gbufferRef->geometryHash;
+	header.frameWidth = gbufferRef->region.frameWidth;
+	header.frameHeight = gbufferRef->region.frameHeight;
+	header.regionX = gbufferRef->region.x;
+	header.regionY = gbufferRef->region.y;
+	header.regionWidth = gbufferRef->region.width;
+	header.regionHeight = gbufferRef->region.height;
+
+	if (fwrite(&header, sizeof(GBufferHeader), 1, fp) != 1 ||
+		fwrite(gbufferRef->samples, sizeof(GBufferSample), length, fp) != length) {
+		fprintf(stderr, "Error: File '%s' could not be written\n", fname);
+		fclose(fp);
+		return 1;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+/**
+ * Read a G-buffer from a file, the samples are allocated here
+ * @param gbufferRef - The G-buffer to read into
+ * @param fname - The input filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int load_gbuffer(GBuffer *gbufferRef, char *fname) {
+	FILE *fp = fopen(fname, "rb");
+	GBufferHeader header;
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+
+	if (fread(&header, sizeof(GBufferHeader), 1, fp) != 1 || memcmp(header.magic, GBUFFER_MAGIC, sizeof(header.magic)) != 0 ||
+		header.regionWidth <= 0 || header.regionHeight <= 0) {
+		fprintf(stderr, "Error: File '%s' is not a G-buffer\n", fname);
+		fclose(fp);
+		return 1;
+	}
+
+	ImageRegion region = {header.regionX, header.regionY, header.regionWidth, header.regionHeight,
+						  header.frameWidth, header.frameHeight};
+	if (gbuffer_alloc(gbufferRef, &region, header.geometryHash) != 0) {
+		fclose(fp);
+		return 1;
+	}
+
+	size_t length = (size_t) region.width * region.height;
+	if (fread(gbufferRef->samples, sizeof(GBufferSample), length, fp) != length) {
+		fprintf(stderr, "Error: File '%s' ended before all of the samples were read\n", fname);
+		gbuffer_free(gbufferRef);
+		fclose(fp);
+		return 1;
+	}
+
+	fclose(fp);
+	return 0;
+}
+
+/**
+ * Release the samples of a G-buffer
+ * @param gbufferRef - The G-buffer to free
+ */
+void gbuffer_free(GBuffer *gbufferRef) {
+	free(gbufferRef->samples);
+	gbufferRef->samples = NULL;
+}
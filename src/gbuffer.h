@@ -0,0 +1,44 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_GBUFFER_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_GBUFFER_H
+
+#include <stdint.h>
+#include "3dmath.h"
+#include "imaging.h"
+
+#define GBUFFER_MAGIC "RTGBUF1\n"
+
+typedef struct Scene Scene;
+
+/**
+ * What the camera ray of one pixel hit, enough to shade the pixel again without tracing it, triangle is
+ * the mesh triangle hit or -1
+ */
+typedef struct GBufferSample {
+	int32_t primitive;
+	int32_t triangle;
+	V3 position;
+	V3 normal;
+	V3 direction;
+	double distance;
+} GBufferSample;
+
+/**
+ * G-Buffer - the camera hits of a rendered region, tied to the scene geometry it was captured from
+ */
+typedef struct GBuffer {
+	uint64_t geometryHash;
+	ImageRegion region;
+	GBufferSample *samples;
+} GBuffer;
+
+uint64_t scene_geometry_hash(Scene *sceneRef);
+int gbuffer_alloc(GBuffer *gbufferRef, ImageRegion *regionRef, uint64_t geometryHash);
+int save_gbuffer(GBuffer *gbufferRef, char *fname);
+int load_gbuffer(GBuffer *gbufferRef, char *fname);
+void gbuffer_free(GBuffer *gbufferRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_GBUFFER_H
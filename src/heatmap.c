@@ -0,0 +1,54 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <math.h>
+#include "heatmap.h"
+
+/**
+ * Map a value to a false color using a polynomial fit of the Turbo colormap
+ * @param x - The value to map, in the range [0, 1]
+ * @param pixel - The pixel to color
+ */
+static void turbo(double x, RGBApixel *pixel) {
+	double r = 0.13572138 + x*(4.61539260 + x*(-42.66032258 + x*(132.13108234 + x*(-152.94239396 + x*59.28637943))));
+	double g = 0.09140261 + x*(2.19418839 + x*(4.84296658 + x*(-14.18503333 + x*(4.27729857 + x*2.82956604))));
+	double b = 0.10667330 + x*(12.64194608 + x*(-60.58204836 + x*(110.36276771 + x*(-89.90310912 + x*27.34824973))));
+
+	pixel->r = (uint8_t) (fmin(fmax(r, 0), 1) * 255);
+	pixel->g = (uint8_t) (fmin(fmax(g, 0), 1) * 255);
+	pixel->b = (uint8_t) (fmin(fmax(b, 0), 1) * 255);
+	pixel->a = 255;
+}
+
+/**
+ * Converts a costmap into a false color heatmap image. Costs are log scaled against the most
+ * expensive pixel so that both cheap and expensive regions remain distinguishable.
+ * @param costmapRef - The costmap to convert
+ * @param imageRef - The output image, its pixmap is allocated here
+ * @param maxCostRef - Set to the cost of the most expensive pixel
+ * @return 0 if success, otherwise a failure occurred
+ */
+int costmap_to_heatmap(Costmap *costmapRef, Image *imageRef, float *maxCostRef) {
+	uint32_t length = costmapRef->width * costmapRef->height;
+	float maxCost = 0;
+
+	imageRef->width = costmapRef->width;
+	imageRef->height = costmapRef->height;
+	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * length);
+	if (imageRef->pixmapRef == NULL)
+		return 1;
+
+	for (uint32_t i = 0; i < length; i++) {
+		if (costmapRef->values[i] > maxCost)
+			maxCost = costmapRef->values[i];
+	}
+
+	double scale = maxCost > 0 ? 1 / log1p(maxCost) : 0;
+	for (uint32_t i = 0; i < length; i++)
+		turbo(log1p(fmax(costmapRef->values[i], 0)) * scale, &imageRef->pixmapRef[i]);
+
+	*maxCostRef = maxCost;
+	return 0;
+}
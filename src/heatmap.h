@@ -0,0 +1,12 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_HEATMAP_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_HEATMAP_H
+
+#include "imaging.h"
+
+int costmap_to_heatmap(Costmap *costmapRef, Image *imageRef, float *maxCostRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_HEATMAP_H
@@ -34,4 +34,21 @@ typedef struct Image {
 	RGBApixel *pixmapRef;
 } Image;
 
+/**
+ * ImageRegion - A sub-rectangle of a larger frame
+ */
+typedef struct ImageRegion {
+	int x, y;
+	int width, height;
+	int frameWidth, frameHeight;
+} ImageRegion;
+
+/**
+ * Costmap - A single float channel per pixel, laid out the same way as an Image
+ */
+typedef struct Costmap {
+	uint32_t width, height;
+	float *values;
+} Costmap;
+
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_IMAGING_H
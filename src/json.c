@@ -3,6 +3,7 @@
 //
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "json_parsers.h"
 #include "json_helpers.h"
@@ -34,6 +35,64 @@ int read_json(char* fname, JSONValue *JSONRootRef) {
 	return 0;
 }
 
+/**
+ * Read JSON held in memory into a JSONValue struct, the same way as read_json reads a file
+ * @param buffer - The JSON text, it does not need to be NUL terminated
+ * @param length - The length of the JSON text in bytes
+ * @param JSONRootRef - The JSONValue struct to use for the root of the JSON text
+ * @return 0 if success, otherwise a failure occurred
+ */
+int read_json_buffer(const char *buffer, size_t length, JSONValue *JSONRootRef) {
+	// The parser reads through a file handle, so the buffer is opened as one
+	FILE *fp = length > 0 ? fmemopen((void *) buffer, length, "r") : NULL;
+
+	if (fp == NULL) {
+		fprintf(stderr, "Error: The JSON buffer could not be opened for reading\n");
+		return 1;
+	}
+	if (read_JSONValue(fp, JSONRootRef) != 0) {
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+
+	return 0;
+}
+
+/**
+ * Release everything a fully read JSONValue holds, the struct itself belongs to the caller
+ * @param JSONValueRef - The JSONValue to free
+ */
+void free_JSONValue(JSONValue *JSONValueRef) {
+	switch (JSONValueRef->type) {
+		case STRING_T:
+			free(JSONValueRef->data.dataString);
+			break;
+		case OBJECT_T:
+			for (int i = 0; i < JSONValueRef->data.dataObject->length; i++) {
+				free(JSONValueRef->data.dataObject->keys[i]);
+				free(JSONValueRef->data.dataObject->values[i]->key);
+				free_JSONValue(JSONValueRef->data.dataObject->values[i]->value);
+				free(JSONValueRef->data.dataObject->values[i]->value);
+				free(JSONValueRef->data.dataObject->values[i]);
+			}
+			free(JSONValueRef->data.dataObject->keys);
+			free(JSONValueRef->data.dataObject->values);
+			free(JSONValueRef->data.dataObject);
+			break;
+		case ARRAY_T:
+			for (int i = 0; i < JSONValueRef->data.dataArray->length; i++) {
+				free_JSONValue(JSONValueRef->data.dataArray->values[i]);
+				free(JSONValueRef->data.dataArray->values[i]);
+			}
+			free(JSONValueRef->data.dataArray->values);
+			free(JSONValueRef->data.dataArray);
+			break;
+		default:
+			break;
+	}
+}
+
 /**
  * Resolves a JSONObject's key to a JSONValue if it exists
  * @param key - The key to look for
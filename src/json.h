@@ -5,6 +5,8 @@
 #ifndef CS430_PROJECT_2_BASIC_RAYCASTER_JSON_H
 #define CS430_PROJECT_2_BASIC_RAYCASTER_JSON_H
 
+#include <stddef.h>
+
 typedef enum JSONValueType_t {
 	STRING_T,
 	NUMBER_T,
@@ -47,6 +49,8 @@ typedef struct JSONArray {
 } JSONArray;
 
 int read_json(char* fname, JSONValue *JSONRootRef);
+int read_json_buffer(const char *buffer, size_t length, JSONValue *JSONRootRef);
+void free_JSONValue(JSONValue *JSONValueRef);
 int JSONObject_get_value(char* key, JSONObject* JSONObjectRef, JSONValue** JSONValueOutRef);
 int JSONArray_get_value(int index, JSONArray* JSONArrayRef, JSONValue** JSONValueOutRef);
 
@@ -13,7 +13,8 @@
 
 
 /**
- * Read a JSONValue from a file handle.
+ * Read a JSONValue from a file handle. On failure everything read into the value so far is freed again,
+ * leaving only the struct to the caller.
  * @param fp - The file handle to read from
  * @param JSONValueRef - The JSONValue struct to write the found data into
  * @return 0 if success, otherwise a failure occurred
@@ -34,7 +35,16 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 		// Create space for this object
 		JSONValueRef->data.dataObject = malloc(sizeof(JSONObject));
 
+		if (JSONValueRef->data.dataObject == NULL) {
+			fprintf(stderr, "Error: Could not allocate a JSON object\n");
+			JSONValueRef->type = NULL_T;
+			return 1;
+		}
+
 		if (read_JSONObject(fp, JSONValueRef->data.dataObject) != 0) {
+			// The object holds the elements read before the failure
+			free_JSONValue(JSONValueRef);
+			JSONValueRef->type = NULL_T;
 			return 1;
 		}
 
@@ -46,7 +56,16 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 		// Create space for this array
 		JSONValueRef->data.dataArray = malloc(sizeof(JSONArray));
 
+		if (JSONValueRef->data.dataArray == NULL) {
+			fprintf(stderr, "Error: Could not allocate a JSON array\n");
+			JSONValueRef->type = NULL_T;
+			return 1;
+		}
+
 		if (read_JSONArray(fp, JSONValueRef->data.dataArray) != 0) {
+			// The array holds the values read before the failure
+			free_JSONValue(JSONValueRef);
+			JSONValueRef->type = NULL_T;
 			return 1;
 		}
 
@@ -68,6 +87,7 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 		// Parse the string
 		char *string = parse_string(fp);
 		if (string == NULL) {
+			JSONValueRef->type = NULL_T;
 			return 1;
 		}
 
@@ -105,20 +125,24 @@ int read_JSONValue(FILE *fp, JSONValue *JSONValueRef){
 		}
 
 		fprintf(stderr, "Error: Found unexpected symbol '%c' when parsing for a value in a JSON file\n", c);
+		JSONValueRef->type = NULL_T;
 		return 1;
 	}
 	else if (c == EOF) {
 		fprintf(stderr, "Error: Unexpected EOF when parsing for a value in a JSON file\n");
+		JSONValueRef->type = NULL_T;
 		return 1;
 	}
 	else {
 		fprintf(stderr, "Error: Found unexpected symbol '%c' when parsing for a value in a JSON file\n", c);
+		JSONValueRef->type = NULL_T;
 		return 1;
 	}
 }
 
 /**
- * Read a JSONObject from a file handle.
+ * Read a JSONObject from a file handle. On failure the object still holds the elements read completely,
+ * so it can be freed as the data of a JSONValue.
  * @param fp - The file handle to read from
  * @param JSONObjectRef - The JSONObject struct to write the found data into
  * @return 0 if success, otherwise a failure occurred
@@ -131,6 +155,11 @@ int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef) {
 
 	JSONObjectRef->keys = malloc(sizeof(char*) * size);
 	JSONObjectRef->values = malloc(sizeof(JSONElement*) * size);
+	JSONObjectRef->length = 0;
+	if (JSONObjectRef->keys == NULL || JSONObjectRef->values == NULL) {
+		fprintf(stderr, "Error: Could not allocate a JSON object\n");
+		return 1;
+	}
 
 	skip_whitespace(fp);
 
@@ -160,21 +189,44 @@ int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef) {
 
 		// Make sure we have enough space for this element
 		if (length == size) {
+			char **keys = realloc(JSONObjectRef->keys, sizeof(char*) * size * 2);
+			if (keys != NULL)
+				JSONObjectRef->keys = keys;
+			JSONElement **values = realloc(JSONObjectRef->values, sizeof(JSONElement*) * size * 2);
+			if (values != NULL)
+				JSONObjectRef->values = values;
+			if (keys == NULL || values == NULL) {
+				fprintf(stderr, "Error: Could not allocate a JSON object\n");
+				return 1;
+			}
 			size *= 2;
-			JSONObjectRef->keys = realloc(JSONObjectRef->keys, sizeof(char*) * size);
-			JSONObjectRef->values = realloc(JSONObjectRef->values, sizeof(JSONElement*) * size);
 		}
 
 		// Read the JSON element in
-		JSONObjectRef->values[length] = malloc(sizeof(JSONElement));
-
-		if (read_JSONElement(fp, JSONObjectRef->values[length]) != 0) {
+		JSONElement *elementRef = malloc(sizeof(JSONElement));
+		if (elementRef == NULL) {
+			fprintf(stderr, "Error: Could not allocate a JSON object\n");
+			return 1;
+		}
+		if (read_JSONElement(fp, elementRef) != 0) {
+			free(elementRef);
+			return 1;
+		}
+		char *key = strdup(elementRef->key);
+		if (key == NULL) {
+			free(elementRef->key);
+			free_JSONValue(elementRef->value);
+			free(elementRef->value);
+			free(elementRef);
+			fprintf(stderr, "Error: Could not allocate a JSON object\n");
 			return 1;
 		}
 
 		// Set the key we found
-		JSONObjectRef->keys[length] = strdup(JSONObjectRef->values[length]->key);
+		JSONObjectRef->values[length] = elementRef;
+		JSONObjectRef->keys[length] = key;
 		length++;
+		JSONObjectRef->length = length;
 
 		skip_whitespace(fp);
 
@@ -201,7 +253,7 @@ int read_JSONObject(FILE *fp, JSONObject *JSONObjectRef) {
 }
 
 /**
- * Read a JSONElement from a file handle.
+ * Read a JSONElement from a file handle. On failure nothing is left allocated in the element.
  * @param fp - The file handle to read from
  * @param JSONElementRef - The JSONElement struct to write the found data into
  * @return 0 if success, otherwise a failure occurred
@@ -211,23 +263,37 @@ int read_JSONElement(FILE *fp, JSONElement *JSONElementRef) {
 
 	skip_whitespace(fp);
 	char *key = parse_string(fp);
+	if (key == NULL) {
+		fprintf(stderr, "Error: Expected a string key for an element in an object in a JSON file\n");
+		return 1;
+	}
 	skip_whitespace(fp);
 
 	c = getc(fp);
 	if (c == EOF) {
 		fprintf(stderr, "Error: Unexpected EOF when parsing for an element in an object in a JSON file\n");
+		free(key);
 		return 1;
 	}
 	if (c != ':') {
 		fprintf(stderr, "Error: Found unexpected symbol '%c' when parsing for a ':' in a JSON file\n", c);
+		free(key);
 		return 1;
 	}
 	skip_whitespace(fp);
 
 	JSONElementRef->key = key;
-	JSONElementRef->value = malloc(sizeof(JSONElement));
+	JSONElementRef->value = malloc(sizeof(JSONValue));
+	if (JSONElementRef->value == NULL) {
+		fprintf(stderr, "Error: Could not allocate a JSON value\n");
+		free(key);
+		return 1;
+	}
 
 	if (read_JSONValue(fp, JSONElementRef->value) != 0) {
+		// The value freed what it had read already
+		free(JSONElementRef->value);
+		free(key);
 		return 1;
 	}
 
@@ -235,7 +301,8 @@ int read_JSONElement(FILE *fp, JSONElement *JSONElementRef) {
 }
 
 /**
- * Read a JSONArray from a file handle.
+ * Read a JSONArray from a file handle. On failure the array still holds the values read completely, so
+ * it can be freed as the data of a JSONValue.
  * @param fp - The file handle to read from
  * @param JSONArrayRef - The JSONArray struct to write the found data into
  * @return 0 if success, otherwise a failure occurred
@@ -247,6 +314,11 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 	char isValueExpected = TRUE;
 
 	JSONArrayRef->values = malloc(sizeof(JSONValue*) * size);
+	JSONArrayRef->length = 0;
+	if (JSONArrayRef->values == NULL) {
+		fprintf(stderr, "Error: Could not allocate a JSON array\n");
+		return 1;
+	}
 
 	skip_whitespace(fp);
 
@@ -276,18 +348,29 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 
 		// Make sure we have enough space for this value
 		if (length == size) {
+			JSONValue **values = realloc(JSONArrayRef->values, sizeof(JSONValue*) * size * 2);
+			if (values == NULL) {
+				fprintf(stderr, "Error: Could not allocate a JSON array\n");
+				return 1;
+			}
+			JSONArrayRef->values = values;
 			size *= 2;
-			JSONArrayRef->values = realloc(JSONArrayRef->values, sizeof(JSONValue*) * size);
 		}
 
 		// Read the JSON element in
-		JSONArrayRef->values[length] = malloc(sizeof(JSONValue));
-
-		if (read_JSONValue(fp, JSONArrayRef->values[length]) != 0) {
+		JSONValue *valueRef = malloc(sizeof(JSONValue));
+		if (valueRef == NULL) {
+			fprintf(stderr, "Error: Could not allocate a JSON array\n");
+			return 1;
+		}
+		if (read_JSONValue(fp, valueRef) != 0) {
+			free(valueRef);
 			return 1;
 		}
 
+		JSONArrayRef->values[length] = valueRef;
 		length++;
+		JSONArrayRef->length = length;
 
 		skip_whitespace(fp);
 
@@ -322,7 +405,7 @@ int read_JSONArray(FILE *fp, JSONArray *JSONArrayRef) {
 char* parse_string(FILE *fh) {
 	int c;
 	int size = INITIAL_BUFFER_SIZE;
-	char *buffer = malloc(sizeof(char) * size);
+	char *buffer;
 
 	// Check for a beginning quote "
 	c = fgetc(fh);
@@ -331,16 +414,29 @@ char* parse_string(FILE *fh) {
 			fprintf(stderr, "Error: Expected string\n");
 		return NULL;
 	}
+	buffer = malloc(sizeof(char) * size);
+	if (buffer == NULL)
+		return NULL;
 
 	// Read characters from the file until we find an ending quote "
 	int i = 0;
 	do {
 		// Reallocate space if we don't have enough for this letter + the null terminator
-		if (i + 2 > c) {
+		if (i + 2 > size) {
 			size *= 2;
-			buffer = realloc(buffer, size * sizeof(char));
+			char *grown = realloc(buffer, size * sizeof(char));
+			if (grown == NULL) {
+				free(buffer);
+				return NULL;
+			}
+			buffer = grown;
 		}
 		c = fgetc(fh);
+		if (c == EOF) {
+			fprintf(stderr, "Error: Unexpected EOF when parsing for a string in a JSON file\n");
+			free(buffer);
+			return NULL;
+		}
 		buffer[i++] = c;
 	}
 	while (c != '"');
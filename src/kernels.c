@@ -0,0 +1,252 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "kernels.h"
+#include "raycaster.h"
+#include "constants.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86 1
+#else
+#define KERNELS_X86 0
+#endif
+
+/**
+ * The distance to every sphere in a range of the pack, the same arithmetic as intersect_sphere in the
+ * same order so a variant vectorized for any instruction set matches it bit for bit. This file is built
+ * without floating point contraction, which would fuse the products into FMAs on hosts which have them,
+ * and without errno or trap semantics, which would keep sqrt and the selects from vectorizing.
+ */
+static inline __attribute__((always_inline)) void sphere_distances_body(PrimitivePack *packRef, int first, int count,
+																		 V3 *rayOriginRef, V3 *rayDirectionRef, double *distances) {
+	double originX = rayOriginRef->data.X, originY = rayOriginRef->data.Y, originZ = rayOriginRef->data.Z;
+	double directionX = rayDirectionRef->data.X, directionY = rayDirectionRef->data.Y, directionZ = rayDirectionRef->data.Z;
+	double *x = packRef->x + first, *y = packRef->y + first, *z = packRef->z + first;
+	double *radiusSquared = packRef->radiusSquared + first;
+
+	for (int k = 0; k < count; k++) {
+		double offsetX = originX - x[k];
+		double offsetY = originY - y[k];
+		double offsetZ = originZ - z[k];
+		double B = 2 * (directionX * offsetX + directionY * offsetY + directionZ * offsetZ);
+		double C = offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ - radiusSquared[k];
+		double discriminant = B * B - 4 * C;
+		double root = sqrt(discriminant > 0 ? discriminant : 0);
+		double far = (-B + root) / 2;
+		double near = (-B - root) / 2;
+		double t = near > 0 ? near : far;
+		distances[k] = (discriminant >= 0) & (t > 0) ? t : INFINITY;
+	}
+}
+
+/**
+ * The closest packed sphere along every ray of a batch, each sphere in turn against all of the rays.
+ * The arithmetic is the one of sphere_distances_body and a sphere only replaces a strictly closer one,
+ * so every ray finds the sphere the scan over its own distances would.
+ */
+static inline __attribute__((always_inline)) void closest_spheres_body(PrimitivePack *packRef, RayBatch *batchRef, int count) {
+	for (int s = 0; s < packRef->spheresLength; s++) {
+		double x = packRef->x[s], y = packRef->y[s], z = packRef->z[s];
+		double radiusSquared = packRef->radiusSquared[s];
+
+		for (int k = 0; k < count; k++) {
+			double offsetX = batchRef->originX[k] - x;
+			double offsetY = batchRef->originY[k] - y;
+			double offsetZ = batchRef->originZ[k] - z;
+			double B = 2 * (batchRef->directionX[k] * offsetX + batchRef->directionY[k] * offsetY + batchRef->directionZ[k] * offsetZ);
+			double C = offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ - radiusSquared;
+			double discriminant = B * B - 4 * C;
+			double root = sqrt(discriminant > 0 ? discriminant : 0);
+			double far = (-B + root) / 2;
+			double near = (-B - root) / 2;
+			double t = near > 0 ? near : far;
+			int closer = (discriminant >= 0) & (t > 0) & (t < batchRef->distances[k]) & (batchRef->ignore[k] != s);
+			batchRef->distances[k] = closer ? t : batchRef->distances[k];
+			batchRef->hits[k] = closer ? s : batchRef->hits[k];
+		}
+	}
+}
+
+/**
+ * Drop the alpha channel of a run of pixels, the layout of a PPM P6 row
+ */
+static inline __attribute__((always_inline)) void pack_rgb_body(RGBApixel *pixels, uint8_t *rgb, int count) {
+	for (int k = 0; k < count; k++) {
+		rgb[k*3] = pixels[k].r;
+		rgb[k*3 + 1] = pixels[k].g;
+		rgb[k*3 + 2] = pixels[k].b;
+	}
+}
+
+// Every variant is the same body compiled for another instruction set
+#define DEFINE_KERNELS(suffix, target) \
+	target static void sphere_distances_##suffix(PrimitivePack *packRef, int first, int count, V3 *rayOriginRef, \
+												 V3 *rayDirectionRef, double *distances) { \
+		sphere_distances_body(packRef, first, count, rayOriginRef, rayDirectionRef, distances); \
+	} \
+	target static void pack_rgb_##suffix(RGBApixel *pixels, uint8_t *rgb, int count) { \
+		pack_rgb_body(pixels, rgb, count); \
+	} \
+	target static void closest_spheres_##suffix(PrimitivePack *packRef, RayBatch *batchRef, int count) { \
+		closest_spheres_body(packRef, batchRef, count); \
+	}
+
+DEFINE_KERNELS(generic, )
+#if KERNELS_X86
+DEFINE_KERNELS(sse42, __attribute__((target("sse4.2"))))
+DEFINE_KERNELS(avx2, __attribute__((target("avx2"))))
+DEFINE_KERNELS(avx512, __attribute__((target("avx512f,avx512bw,prefer-vector-width=512"))))
+#endif
+
+/**
+ * Every variant from the slowest to the fastest, with the CPU features it needs
+ */
+static const struct {
+	KernelTable table;
+	const char *feature;
+} kernelVariants[] = {
+	{{"generic", sphere_distances_generic, pack_rgb_generic, closest_spheres_generic}, NULL},
+#if KERNELS_X86
+	{{"sse4.2", sphere_distances_sse42, pack_rgb_sse42, closest_spheres_sse42}, "sse4.2"},
+	{{"avx2", sphere_distances_avx2, pack_rgb_avx2, closest_spheres_avx2}, "avx2"},
+	{{"avx512", sphere_distances_avx512, pack_rgb_avx512, closest_spheres_avx512}, "avx512bw"},
+#endif
+};
+
+#define KERNEL_VARIANTS_LENGTH ((int) (sizeof(kernelVariants) / sizeof(kernelVariants[0])))
+
+KernelTable kernels = {"generic", sphere_distances_generic, pack_rgb_generic, closest_spheres_generic};
+
+/**
+ * Determine if the host can run a variant
+ */
+static int kernel_variant_supported(int variant) {
+	const char *feature = kernelVariants[variant].feature;
+
+	if (feature == NULL)
+		return TRUE;
+#if KERNELS_X86
+	__builtin_cpu_init();
+	if (strcmp(feature, "sse4.2") == 0)
+		return __builtin_cpu_supports("sse4.2");
+	if (strcmp(feature, "avx2") == 0)
+		return __builtin_cpu_supports("avx2");
+	if (strcmp(feature, "avx512bw") == 0)
+		return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+	return FALSE;
+}
+
+/**
+ * Select the kernels used by every render, once at startup before any thread is started
+ * @param name - The variant to use, or NULL for the fastest one the host supports
+ * @return 0 if success, otherwise the variant is unknown or not supported by the host
+ */
+int kernels_select(const char *name) {
+	int selected = 0;
+
+	for (int i = 0; i < KERNEL_VARIANTS_LENGTH; i++) {
+		if (name == NULL) {
+			if (kernel_variant_supported(i))
+				selected = i;
+			continue;
+		}
+		if (strcmp(name, kernelVariants[i].table.name) != 0)
+			continue;
+		if (!kernel_variant_supported(i)) {
+			fprintf(stderr, "Error: This CPU does not support the '%s' kernels\n", name);
+			return 1;
+		}
+		kernels = kernelVariants[i].table;
+		return 0;
+	}
+
+	if (name != NULL) {
+		fprintf(stderr, "Error: Unknown kernel instruction set '%s', expected one of:", name);
+		for (int i = 0; i < KERNEL_VARIANTS_LENGTH; i++)
+			fprintf(stderr, " %s", kernelVariants[i].table.name);
+		fprintf(stderr, "\n");
+		return 1;
+	}
+	kernels = kernelVariants[selected].table;
+	return 0;
+}
+
+/**
+ * Allocate an array of doubles aligned for the widest vector loads
+ */
+static double *pack_array(int length) {
+	size_t bytes = sizeof(double) * (size_t) (length > 0 ? length : 1);
+	return aligned_alloc(64, (bytes + 63) / 64 * 64);
+}
+
+/**
+ * Pack the spheres of a scene for the sphere kernels, the scene keeps its primitives in the same order
+ * @param sceneRef - The scene to pack
+ * @return 0 if success, otherwise a failure occurred
+ */
+int scene_pack_primitives(Scene *sceneRef) {
+	PrimitivePack *packRef = calloc(1, sizeof(PrimitivePack));
+	int length = sceneRef->primitivesLength;
+
+	if (packRef == NULL)
+		return 1;
+	packRef->x = pack_array(length);
+	packRef->y = pack_array(length);
+	packRef->z = pack_array(length);
+	packRef->radiusSquared = pack_array(length);
+	packRef->spheres = malloc(sizeof(Primitive *) * (length > 0 ? length : 1));
+	packRef->sphereIndices = malloc(sizeof(int) * (length > 0 ? length : 1));
+	packRef->others = malloc(sizeof(Primitive *) * (length > 0 ? length : 1));
+	packRef->otherIndices = malloc(sizeof(int) * (length > 0 ? length : 1));
+	sceneRef->packRef = packRef;
+	if (packRef->x == NULL || packRef->y == NULL || packRef->z == NULL || packRef->radiusSquared == NULL ||
+		packRef->spheres == NULL || packRef->sphereIndices == NULL || packRef->others == NULL || packRef->otherIndices == NULL) {
+		fprintf(stderr, "Error: Could not allocate the packed primitives\n");
+		scene_free_pack(sceneRef);
+		return 1;
+	}
+
+	for (int i = 0; i < length; i++) {
+		Primitive *primitiveRef = sceneRef->primitives[i];
+		if (primitiveRef->type == SPHERE_T) {
+			int k = packRef->spheresLength++;
+			packRef->x[k] = primitiveRef->data.sphere.position.data.X;
+			packRef->y[k] = primitiveRef->data.sphere.position.data.Y;
+			packRef->z[k] = primitiveRef->data.sphere.position.data.Z;
+			packRef->radiusSquared[k] = pow(primitiveRef->data.sphere.radius, 2);
+			packRef->spheres[k] = primitiveRef;
+			packRef->sphereIndices[k] = i;
+		}
+		else {
+			packRef->others[packRef->othersLength] = primitiveRef;
+			packRef->otherIndices[packRef->othersLength++] = i;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Release the packed primitives of a scene
+ * @param sceneRef - The scene whose pack is freed
+ */
+void scene_free_pack(Scene *sceneRef) {
+	PrimitivePack *packRef = sceneRef->packRef;
+
+	if (packRef == NULL)
+		return;
+	free(packRef->x);
+	free(packRef->y);
+	free(packRef->z);
+	free(packRef->radiusSquared);
+	free(packRef->spheres);
+	free(packRef->sphereIndices);
+	free(packRef->others);
+	free(packRef->otherIndices);
+	free(packRef);
+	sceneRef->packRef = NULL;
+}
@@ -0,0 +1,70 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_KERNELS_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_KERNELS_H
+
+#include <stdint.h>
+#include "3dmath.h"
+#include "imaging.h"
+
+// Rays are tested against this many packed spheres at a time
+#define KERNEL_CHUNK 256
+
+typedef struct Scene Scene;
+typedef struct Primitive Primitive;
+
+/**
+ * Primitive Pack - the spheres of a scene as separate coordinate arrays so a ray can be tested against
+ * several at once, plus the primitives of every other type. Both keep their index in the scene, which
+ * breaks ties between equal distances the same way a loop over the scene does.
+ */
+typedef struct PrimitivePack {
+	int spheresLength;
+	double *x;
+	double *y;
+	double *z;
+	double *radiusSquared;
+	Primitive **spheres;
+	int *sphereIndices;
+	int othersLength;
+	Primitive **others;
+	int *otherIndices;
+} PrimitivePack;
+
+/**
+ * Ray Batch - up to KERNEL_CHUNK rays as separate coordinate arrays, with the packed sphere each one
+ * skips, or -1, and the closest packed sphere found so far and its distance, -1 and INFINITY at first
+ */
+typedef struct RayBatch {
+	double originX[KERNEL_CHUNK];
+	double originY[KERNEL_CHUNK];
+	double originZ[KERNEL_CHUNK];
+	double directionX[KERNEL_CHUNK];
+	double directionY[KERNEL_CHUNK];
+	double directionZ[KERNEL_CHUNK];
+	double distances[KERNEL_CHUNK];
+	int ignore[KERNEL_CHUNK];
+	int hits[KERNEL_CHUNK];
+} RayBatch;
+
+/**
+ * Kernel Table - one instruction set variant of every dispatched kernel, all variants give bit
+ * identical results
+ */
+typedef struct KernelTable {
+	const char *name;
+	void (*sphere_distances)(PrimitivePack *packRef, int first, int count, V3 *rayOriginRef, V3 *rayDirectionRef, double *distances);
+	void (*pack_rgb)(RGBApixel *pixels, uint8_t *rgb, int count);
+	void (*closest_spheres)(PrimitivePack *packRef, RayBatch *batchRef, int count);
+} KernelTable;
+
+// The kernels selected for this host, the generic ones until kernels_select is called
+extern KernelTable kernels;
+
+int kernels_select(const char *name);
+int scene_pack_primitives(Scene *sceneRef);
+void scene_free_pack(Scene *sceneRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_KERNELS_H
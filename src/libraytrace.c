@@ -0,0 +1,134 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "libraytrace.h"
+#include "json.h"
+#include "raycaster.h"
+#include "raycaster_helpers.h"
+#include "lighttree.h"
+#include "kernels.h"
+#include "mesh.h"
+#include "material.h"
+
+/**
+ * Raytrace Scene - the scene with everything baked for it, owned by the handle
+ */
+struct RaytraceScene {
+	Scene scene;
+	LightTree lightTree;
+};
+
+// The kernels are picked once for the whole process, before the first scene is loaded
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Select the fastest kernels the host supports
+ */
+static void select_kernels() {
+	kernels_select(NULL);
+}
+
+/**
+ * Load a scene from JSON held in memory, in the format of the scene files read by raytrace. Meshes are
+ * still loaded from the model files the scene names.
+ * @param buffer - The JSON text of the scene, it does not need to be NUL terminated
+ * @param length - The length of the JSON text in bytes
+ * @param sceneRefRef - Set to the loaded scene, freed with raytrace_scene_free
+ * @return 0 if success, otherwise a failure occurred and nothing is set
+ */
+int raytrace_scene_load(const char *buffer, size_t length, RaytraceScene **sceneRefRef) {
+	RaytraceScene *handleRef = calloc(1, sizeof(RaytraceScene));
+	JSONValue JSONRoot;
+
+	pthread_once(&kernelsOnce, select_kernels);
+	if (handleRef == NULL) {
+		fprintf(stderr, "Error: Could not allocate the scene\n");
+		return 1;
+	}
+	if (read_json_buffer(buffer, length, &JSONRoot) != 0) {
+		free(handleRef);
+		return 1;
+	}
+	int result = create_scene_from_JSON(&JSONRoot, &handleRef->scene);
+	free_JSONValue(&JSONRoot);
+
+	if (result == 0) {
+		scene_bake_light_bounds(&handleRef->scene, 0);
+		result = scene_pack_primitives(&handleRef->scene);
+	}
+	// Many lights are found through a light tree
+	if (result == 0 && handleRef->scene.lightsLength >= LIGHT_TREE_MIN_LIGHTS) {
+		result = light_tree_build(&handleRef->lightTree, &handleRef->scene);
+		if (result == 0)
+			handleRef->scene.lightTreeRef = &handleRef->lightTree;
+	}
+	if (result != 0) {
+		raytrace_scene_free(handleRef);
+		return 1;
+	}
+
+	*sceneRefRef = handleRef;
+	return 0;
+}
+
+/**
+ * Render a scene into a buffer of the caller, on the calling thread and threads - 1 more
+ * @param sceneRef - The scene to render
+ * @param width - The width of the image in pixels
+ * @param height - The height of the image in pixels
+ * @param threads - The number of render threads, 0 uses every online CPU
+ * @param pixels - Set to the image, row by row from the top with 4 bytes per pixel in RGBA order, it
+ * must hold width * height * 4 bytes
+ * @param progress - Called as tiles finish, may be NULL
+ * @param progressDataRef - Passed to every progress call
+ * @return 0 if success, otherwise a failure occurred
+ */
+int raytrace_render(RaytraceScene *sceneRef, int width, int height, int threads, uint8_t *pixels,
+					RaytraceProgress progress, void *progressDataRef) {
+	RenderOptions options;
+	RenderContext context;
+	Image image;
+
+	if (width <= 0 || height <= 0) {
+		fprintf(stderr, "Error: Can not render an image of %dx%d pixels\n", width, height);
+		return 1;
+	}
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (int) cpus : 1;
+	}
+
+	render_options_init(&options);
+	options.threads = threads;
+	options.progress = progress;
+	options.progressDataRef = progressDataRef;
+	if (render_context_init(&context, &sceneRef->scene, &image, width, height, &options) != 0)
+		return 1;
+	int result = render_context_run(&context, threads);
+	if (result == 0)
+		render_context_linearize(&context, (RGBApixel *) pixels);
+	render_context_free(&context);
+
+	return result;
+}
+
+/**
+ * Release a scene and everything baked for it
+ * @param sceneRef - The scene to free, may be NULL
+ */
+void raytrace_scene_free(RaytraceScene *sceneRef) {
+	if (sceneRef == NULL)
+		return;
+	if (sceneRef->scene.lightTreeRef != NULL)
+		light_tree_free(&sceneRef->lightTree);
+	scene_free_meshes(&sceneRef->scene);
+	scene_free_pack(&sceneRef->scene);
+	scene_free_materials(&sceneRef->scene);
+	scene_free_primitives(&sceneRef->scene);
+	free(sceneRef);
+}
@@ -0,0 +1,33 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_LIBRAYTRACE_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_LIBRAYTRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Only the functions of this header are exported from the shared library
+#define RAYTRACE_API __attribute__((visibility("default")))
+
+/**
+ * Raytrace Scene - an opaque handle to a scene loaded, baked and packed for rendering. A scene is not
+ * changed by a render, so any number of renders of one scene may run at the same time.
+ */
+typedef struct RaytraceScene RaytraceScene;
+
+/**
+ * Called by the render threads as tiles finish, one call at a time and never after the render returns
+ * @param tilesRendered - The number of tiles finished so far
+ * @param tilesLength - The number of tiles of the render
+ * @param dataRef - The progress data passed to raytrace_render
+ */
+typedef void (*RaytraceProgress)(int tilesRendered, int tilesLength, void *dataRef);
+
+RAYTRACE_API int raytrace_scene_load(const char *buffer, size_t length, RaytraceScene **sceneRefRef);
+RAYTRACE_API int raytrace_render(RaytraceScene *sceneRef, int width, int height, int threads, uint8_t *pixels,
+								 RaytraceProgress progress, void *progressDataRef);
+RAYTRACE_API void raytrace_scene_free(RaytraceScene *sceneRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_LIBRAYTRACE_H
@@ -0,0 +1,260 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "lighttree.h"
+
+/**
+ * Get the position of a light, point and spot lights share the start of their data
+ */
+static V3 *light_position(Light *lightRef) {
+	return &lightRef->data.pointLight.position;
+}
+
+/**
+ * Build the subtree over a range of lights, reordering the range while splitting it
+ * @param treeRef - The tree being built
+ * @param sceneRef - The scene the lights belong to
+ * @param lights - The indices of the lights in the range
+ * @param length - The number of lights in the range
+ * @return The index of the subtree root
+ */
+static int light_tree_build_range(LightTree *treeRef, Scene *sceneRef, int *lights, int length) {
+	int nodeIndex = treeRef->nodesLength++;
+	LightNode *nodeRef = &treeRef->nodes[nodeIndex];
+
+	if (length == 1) {
+		Light *lightRef = sceneRef->lights[lights[0]];
+		V3 *colorRef = &lightRef->data.pointLight.color;
+		nodeRef->boundsMin = *light_position(lightRef);
+		nodeRef->boundsMax = *light_position(lightRef);
+		nodeRef->power = fmax(colorRef->array[0], fmax(colorRef->array[1], colorRef->array[2]));
+		nodeRef->maxInfluenceRadius = lightRef->influenceRadius;
+		nodeRef->light = lights[0];
+		nodeRef->left = -1;
+		nodeRef->right = -1;
+		return nodeIndex;
+	}
+
+	// Split at the middle of the longest axis of the positions, or in half when they all coincide
+	V3 boundsMin = *light_position(sceneRef->lights[lights[0]]);
+	V3 boundsMax = boundsMin;
+	for (int i = 1; i < length; i++) {
+		V3 *positionRef = light_position(sceneRef->lights[lights[i]]);
+		for (int k = 0; k < 3; k++) {
+			boundsMin.array[k] = fmin(boundsMin.array[k], positionRef->array[k]);
+			boundsMax.array[k] = fmax(boundsMax.array[k], positionRef->array[k]);
+		}
+	}
+	int axis = 0;
+	for (int k = 1; k < 3; k++) {
+		if (boundsMax.array[k] - boundsMin.array[k] > boundsMax.array[axis] - boundsMin.array[axis])
+			axis = k;
+	}
+	double middle = (boundsMin.array[axis] + boundsMax.array[axis]) / 2;
+	int split = 0;
+	for (int i = 0; i < length; i++) {
+		if (light_position(sceneRef->lights[lights[i]])->array[axis] < middle) {
+			int temp = lights[i];
+			lights[i] = lights[split];
+			lights[split++] = temp;
+		}
+	}
+	if (split == 0 || split == length)
+		split = length / 2;
+
+	int left = light_tree_build_range(treeRef, sceneRef, lights, split);
+	int right = light_tree_build_range(treeRef, sceneRef, lights + split, length - split);
+
+	LightNode *leftRef = &treeRef->nodes[left];
+	LightNode *rightRef = &treeRef->nodes[right];
+	for (int k = 0; k < 3; k++) {
+		nodeRef->boundsMin.array[k] = fmin(leftRef->boundsMin.array[k], rightRef->boundsMin.array[k]);
+		nodeRef->boundsMax.array[k] = fmax(leftRef->boundsMax.array[k], rightRef->boundsMax.array[k]);
+	}
+	nodeRef->power = leftRef->power + rightRef->power;
+	nodeRef->maxInfluenceRadius = fmax(leftRef->maxInfluenceRadius, rightRef->maxInfluenceRadius);
+	nodeRef->light = -1;
+	nodeRef->left = left;
+	nodeRef->right = right;
+	return nodeIndex;
+}
+
+/**
+ * Build a light tree over every light of a scene, the influence radii of the lights must be baked first
+ * @param treeRef - The tree to build
+ * @param sceneRef - The scene whose lights are bounded
+ * @return 0 if success, otherwise a failure occurred
+ */
+int light_tree_build(LightTree *treeRef, Scene *sceneRef) {
+	treeRef->nodes = NULL;
+	treeRef->nodesLength = 0;
+	if (sceneRef->lightsLength == 0)
+		return 0;
+
+	int *lights = malloc(sizeof(int) * sceneRef->lightsLength);
+	treeRef->nodes = malloc(sizeof(LightNode) * (2 * sceneRef->lightsLength - 1));
+	if (lights == NULL || treeRef->nodes == NULL) {
+		fprintf(stderr, "Error: Could not allocate a light tree for %d lights\n", sceneRef->lightsLength);
+		free(lights);
+		free(treeRef->nodes);
+		treeRef->nodes = NULL;
+		return 1;
+	}
+
+	for (int i = 0; i < sceneRef->lightsLength; i++)
+		lights[i] = i;
+	light_tree_build_range(treeRef, sceneRef, lights, sceneRef->lightsLength);
+	free(lights);
+	return 0;
+}
+
+/**
+ * Determine if no light of a node can light a surface point, either because every light is behind
+ * the surface or because the point is past the influence radius of every light
+ */
+static int light_node_culled(LightNode *nodeRef, V3 *positionRef, V3 *normalRef) {
+	double distanceSquared = 0;
+	double facing = 0;
+
+	for (int k = 0; k < 3; k++) {
+		double p = positionRef->array[k];
+		double gap = fmax(fmax(nodeRef->boundsMin.array[k] - p, p - nodeRef->boundsMax.array[k]), 0);
+		distanceSquared += gap * gap;
+
+		// The corner of the bounds furthest in front of the surface
+		double corner = normalRef->array[k] > 0 ? nodeRef->boundsMax.array[k] : nodeRef->boundsMin.array[k];
+		facing += normalRef->array[k] * (corner - p);
+	}
+
+	return facing < 0 || distanceSquared > nodeRef->maxInfluenceRadius * nodeRef->maxInfluenceRadius;
+}
+
+/**
+ * Gather the lights of a subtree which are not culled
+ */
+static int light_tree_gather_node(LightTree *treeRef, int nodeIndex, V3 *positionRef, V3 *normalRef, int *lightsRef) {
+	LightNode *nodeRef = &treeRef->nodes[nodeIndex];
+
+	if (light_node_culled(nodeRef, positionRef, normalRef))
+		return 0;
+	if (nodeRef->light >= 0) {
+		lightsRef[0] = nodeRef->light;
+		return 1;
+	}
+
+	int length = light_tree_gather_node(treeRef, nodeRef->left, positionRef, normalRef, lightsRef);
+	return length + light_tree_gather_node(treeRef, nodeRef->right, positionRef, normalRef, lightsRef + length);
+}
+
+/**
+ * Find the lights which may light a surface point, skipping whole groups of lights behind the surface
+ * or out of reach. The lights are found in tree order, not scene order.
+ * @param treeRef - The light tree of the scene
+ * @param positionRef - The surface point
+ * @param normalRef - The surface normal
+ * @param lightsRef - Set to the indices of the lights found, room for every light of the scene
+ * @return The number of lights found
+ */
+int light_tree_gather(LightTree *treeRef, V3 *positionRef, V3 *normalRef, int *lightsRef) {
+	if (treeRef->nodesLength == 0)
+		return 0;
+	return light_tree_gather_node(treeRef, 0, positionRef, normalRef, lightsRef);
+}
+
+/**
+ * Estimate how much a node lights a surface point, 0 only when none of its lights can
+ */
+static double light_node_importance(LightNode *nodeRef, Scene *sceneRef, V3 *positionRef, V3 *normalRef) {
+	V3 center;
+	V3 toCenter;
+	V3 extent;
+	double distanceSquared;
+	double extentSquared;
+	double cosine = 1;
+
+	if (light_node_culled(nodeRef, positionRef, normalRef))
+		return 0;
+
+	v3_add(&nodeRef->boundsMin, &nodeRef->boundsMax, &center);
+	v3_scale(&center, 0.5, &center);
+	v3_subtract(&center, positionRef, &toCenter);
+	v3_subtract(&nodeRef->boundsMax, &nodeRef->boundsMin, &extent);
+	v3_dot(&toCenter, &toCenter, &distanceSquared);
+	v3_dot(&extent, &extent, &extentSquared);
+
+	// A single light is bounded exactly by its angle to the surface and its spotlight cone
+	if (nodeRef->light >= 0) {
+		double fang;
+		v3_normalize(&toCenter, &toCenter);
+		v3_dot(normalRef, &toCenter, &cosine);
+		calculate_fang(sceneRef->lights[nodeRef->light], &toCenter, &fang);
+		cosine = fmax(cosine, 0) * fang;
+	}
+
+	// Points inside the bounds would otherwise get an unbounded importance
+	return nodeRef->power * cosine / fmax(fmax(distanceSquared, extentSquared / 4), 1e-12);
+}
+
+/**
+ * Draw a random number in [0, 1) from a splitmix64 generator
+ */
+static double light_tree_random(uint64_t *stateRef) {
+	uint64_t z = (*stateRef += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z ^= z >> 31;
+	return (double) (z >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Pick one light for a surface point with a probability following the importance of the tree nodes,
+ * so that bright, close and facing lights are picked more often
+ * @param treeRef - The light tree of the scene
+ * @param sceneRef - The scene the lights belong to
+ * @param positionRef - The surface point
+ * @param normalRef - The surface normal
+ * @param stateRef - The random generator state, advanced by every pick
+ * @param pdfRef - Set to the probability of the light picked
+ * @return The index of the light picked, -1 when no light can light the point
+ */
+int light_tree_sample(LightTree *treeRef, Scene *sceneRef, V3 *positionRef, V3 *normalRef, uint64_t *stateRef, double *pdfRef) {
+	int nodeIndex = 0;
+	double pdf = 1;
+
+	if (treeRef->nodesLength == 0 || light_node_importance(&treeRef->nodes[0], sceneRef, positionRef, normalRef) == 0)
+		return -1;
+
+	while (treeRef->nodes[nodeIndex].light < 0) {
+		LightNode *nodeRef = &treeRef->nodes[nodeIndex];
+		double left = light_node_importance(&treeRef->nodes[nodeRef->left], sceneRef, positionRef, normalRef);
+		double right = light_node_importance(&treeRef->nodes[nodeRef->right], sceneRef, positionRef, normalRef);
+		if (left + right <= 0)
+			return -1;
+
+		double pickLeft = left / (left + right);
+		if (light_tree_random(stateRef) < pickLeft) {
+			pdf *= pickLeft;
+			nodeIndex = nodeRef->left;
+		}
+		else {
+			pdf *= 1 - pickLeft;
+			nodeIndex = nodeRef->right;
+		}
+	}
+
+	*pdfRef = pdf;
+	return treeRef->nodes[nodeIndex].light;
+}
+
+/**
+ * Release the nodes of a light tree
+ * @param treeRef - The tree to free
+ */
+void light_tree_free(LightTree *treeRef) {
+	free(treeRef->nodes);
+	treeRef->nodes = NULL;
+	treeRef->nodesLength = 0;
+}
@@ -0,0 +1,42 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_LIGHTTREE_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_LIGHTTREE_H
+
+#include <stdint.h>
+#include "3dmath.h"
+#include "raycaster.h"
+
+// Scenes with fewer lights are cheaper to shade by looping over every light
+#define LIGHT_TREE_MIN_LIGHTS 8
+
+/**
+ * Light Node - the bounds of a group of lights, leaves hold a single light and inner nodes their
+ * two children
+ */
+typedef struct LightNode {
+	V3 boundsMin;
+	V3 boundsMax;
+	double power;
+	double maxInfluenceRadius;
+	int light;
+	int left;
+	int right;
+} LightNode;
+
+/**
+ * Light Tree - a bounding volume hierarchy over the light positions of a scene, node 0 is the root
+ */
+typedef struct LightTree {
+	LightNode *nodes;
+	int nodesLength;
+} LightTree;
+
+int light_tree_build(LightTree *treeRef, Scene *sceneRef);
+int light_tree_gather(LightTree *treeRef, V3 *positionRef, V3 *normalRef, int *lightsRef);
+int light_tree_sample(LightTree *treeRef, Scene *sceneRef, V3 *positionRef, V3 *normalRef, uint64_t *stateRef, double *pdfRef);
+void light_tree_free(LightTree *treeRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_LIGHTTREE_H
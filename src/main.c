@@ -1,11 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <time.h>
 #include "json.h"
 #include "raycaster.h"
 #include "ppm.h"
 #include "raycaster_helpers.h"
 #include "constants.h"
+#include "stats.h"
+#include "heatmap.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "gbuffer.h"
+#include "lighttree.h"
+#include "shadowmap.h"
+#include "mesh.h"
+#include "kernels.h"
+#include "material.h"
+#include "traversal.h"
+#include "batch.h"
 
 /**
  * Determine if the input string is a number, this does not currently support
@@ -28,12 +43,48 @@ int isinteger(char *string) {
  * Show a simple help message about the usage of this program
  */
 void show_help() {
-	printf("Usage: raytrace <render_width> <render_height> <input_scene> <output_file>\n");
+	printf("Usage: raytrace [options] <render_width> <render_height> <input_scene> <output_file>\n");
+	printf("       raytrace [options] --batch <batch_file>\n");
 	printf("\t render_width: The width of the image to render\n");
 	printf("\t render_height: The height of the image to render\n");
 	printf("\t input_scene: The input scene file in a supported JSON format\n");
 	printf("\t output_file: The location to write the output PPM P6 image\n");
 	printf("\n");
+	printf("Options:\n");
+	printf("\t --stats: Print render statistics (ray counts, intersection tests, stage times, rays/s)\n");
+	printf("\t --stats-json <file>: Write the render statistics to <file> in JSON format\n");
+	printf("\t --heatmap <file>: Write a per-pixel cost heatmap, a .pfm file gets the raw float costs instead of false color\n");
+	printf("\t --heatmap-metric <rays|tests|time>: The cost shown in the heatmap (default rays)\n");
+	printf("\t --threads <n>: Number of render threads, 0 uses every online CPU (default 0)\n");
+	printf("\t --processes <n>: Render with n forked worker processes sharing the framebuffer instead of threads\n");
+	printf("\t --tile-size <n>: Width and height of the tiles handed to render threads (default %d)\n", DEFAULT_TILE_SIZE);
+	printf("\t --trace <file>: Write a Chrome/Perfetto trace-event timeline of the render to <file>\n");
+	printf("\t --checkpoint <file>: Periodically save finished tiles to <file> (default <output_file>.ckpt with --resume)\n");
+	printf("\t --checkpoint-interval <s>: Seconds between checkpoints (default %g)\n", DEFAULT_CHECKPOINT_INTERVAL);
+	printf("\t --resume: Continue from the checkpoint, refused if the scene, a model, a pixel-affecting option, size, region or tile size changed\n");
+	printf("\t --sparse <n>: Preview by tracing every n-th pixel, tracing densely only near edges and interpolating the rest\n");
+	printf("\t --time-budget <ms>: Render a coarse pass then refine until <ms> after startup, always writing a complete image\n");
+	printf("\t --region <x,y,w,h>: Render only a w x h part of the frame at x,y, the output records its place for stitch\n");
+	printf("\t --band <i/n>: Render only the i-th of n equal horizontal bands of the frame, numbered from 0\n");
+	printf("\t --light-cutoff <i>: Ignore a light where its attenuated intensity is below <i>, 0 keeps every light (default 0)\n");
+	printf("\t --light-samples <k>: Shade each point with k lights picked by importance from the light tree instead\n"
+		   "\t\t of every light, trading noise for a cost that barely grows with the light count\n");
+	printf("\t --shadow-maps <res>: Bake a <res>x<res> shadow map per light (a cube map for point lights) and look\n"
+		   "\t\t shadows up instead of tracing shadow rays, for static scenes with many shaded points\n");
+	printf("\t --shadow-bias <f>: Fraction of the light distance an occluder must be in front of a point to\n"
+		   "\t\t shadow it in a shadow map (default %g)\n", DEFAULT_SHADOW_BIAS);
+	printf("\t --gbuffer-save <file>: Save the camera ray hit of every pixel to <file> for a later --relight\n");
+	printf("\t --relight <file>: Shade the camera ray hits saved in <file> instead of tracing camera rays, lights\n"
+		   "\t\t and materials may change but the camera and primitives must match the capture\n");
+	printf("\t --isa <generic|sse4.2|avx2|avx512>: Use the kernels built for this instruction set instead of the\n"
+		   "\t\t fastest one this CPU supports, every choice renders the same image\n");
+	printf("\t --wavefront: Trace reflection and refraction rays a generation at a time, sorted by direction and\n"
+		   "\t\t origin, instead of following each ray to its full depth\n");
+	printf("\t --traversal <scanline|morton|hilbert>: The order tiles are handed out in and the pixels of a tile\n"
+		   "\t\t are traced in (default hilbert), every order renders the same image\n");
+	printf("\t --batch <file>: Render every '<render_width> <render_height> <input_scene> <output_file>' line of\n"
+		   "\t\t <file>, loading the next scenes and saving the previous images while one renders\n");
+	printf("\n");
 	printf("\t Example: raytrace 1920 1080 scene.json out.ppm\n");
 }
 
@@ -41,51 +92,482 @@ void show_help() {
  * The main enchilada, do all the things!
  */
 int main (int argc, char *argv[]) {
-	if (argc != 5) {
+	char *positional[4];
+	int positionalLength = 0;
+	int showStats = FALSE;
+	char *statsFname = NULL;
+	char *heatmapFname = NULL;
+	char *traceFname = NULL;
+	int threads = 0;
+	char *checkpointFname = NULL;
+	double checkpointInterval = DEFAULT_CHECKPOINT_INTERVAL;
+	int resume = FALSE;
+	double timeBudgetMs = 0;
+	int bandIndex = 0;
+	int bandCount = 0;
+	double lightCutoff = 0;
+	int shadowMapResolution = 0;
+	double shadowBias = DEFAULT_SHADOW_BIAS;
+	char *gbufferFname = NULL;
+	char *relightFname = NULL;
+	char *isaName = NULL;
+	char *batchFname = NULL;
+	RenderOptions options;
+
+	struct timespec startTime;
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	render_options_init(&options);
+
+	// Options may appear anywhere, everything else is a positional argument
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--", 2) != 0) {
+			if (positionalLength == 4) {
+				fprintf(stderr, "Error: Too many arguments provided\n");
+				show_help();
+				return 1;
+			}
+			positional[positionalLength++] = argv[i];
+		}
+		else if (strcmp(argv[i], "--stats") == 0) {
+			showStats = TRUE;
+		}
+		else if (strcmp(argv[i], "--stats-json") == 0 && i + 1 < argc) {
+			statsFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+			heatmapFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			if (!isinteger(argv[++i]) || (threads = atoi(argv[i])) < 0) {
+				fprintf(stderr, "Error: Option threads must be a non-negative integer\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+			if (!isinteger(argv[++i]) || (options.processes = atoi(argv[i])) <= 0) {
+				fprintf(stderr, "Error: Option processes must be a positive integer\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--tile-size") == 0 && i + 1 < argc) {
+			if (!isinteger(argv[++i]) || (options.tileSize = atoi(argv[i])) <= 0) {
+				fprintf(stderr, "Error: Option tile-size must be a positive integer\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			traceFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+			checkpointFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--checkpoint-interval") == 0 && i + 1 < argc) {
+			if ((checkpointInterval = atof(argv[++i])) <= 0) {
+				fprintf(stderr, "Error: Option checkpoint-interval must be a positive number of seconds\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--sparse") == 0 && i + 1 < argc) {
+			if (!isinteger(argv[++i]) || (options.sparseStep = atoi(argv[i])) <= 0) {
+				fprintf(stderr, "Error: Option sparse must be a positive integer\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--time-budget") == 0 && i + 1 < argc) {
+			if ((timeBudgetMs = atof(argv[++i])) <= 0) {
+				fprintf(stderr, "Error: Option time-budget must be a positive number of milliseconds\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--light-cutoff") == 0 && i + 1 < argc) {
+			if ((lightCutoff = atof(argv[++i])) < 0) {
+				fprintf(stderr, "Error: Option light-cutoff must not be negative\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--light-samples") == 0 && i + 1 < argc) {
+			if (!isinteger(argv[++i]) || (options.lightSamples = atoi(argv[i])) <= 0) {
+				fprintf(stderr, "Error: Option light-samples must be a positive integer\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--shadow-maps") == 0 && i + 1 < argc) {
+			if (!isinteger(argv[++i]) || (shadowMapResolution = atoi(argv[i])) <= 0) {
+				fprintf(stderr, "Error: Option shadow-maps must be a positive integer\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--shadow-bias") == 0 && i + 1 < argc) {
+			shadowBias = atof(argv[++i]);
+			if (shadowBias < 0 || shadowBias >= 1) {
+				fprintf(stderr, "Error: Option shadow-bias must be at least 0 and less than 1\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--gbuffer-save") == 0 && i + 1 < argc) {
+			gbufferFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--relight") == 0 && i + 1 < argc) {
+			relightFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+			isaName = argv[++i];
+		}
+		else if (strcmp(argv[i], "--wavefront") == 0) {
+			options.wavefront = TRUE;
+		}
+		else if (strcmp(argv[i], "--traversal") == 0 && i + 1 < argc) {
+			if (traversal_parse(argv[++i], &options.traversal) != 0)
+				return 1;
+		}
+		else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			batchFname = argv[++i];
+		}
+		else if (strcmp(argv[i], "--resume") == 0) {
+			resume = TRUE;
+		}
+		else if (strcmp(argv[i], "--region") == 0 && i + 1 < argc) {
+			ImageRegion *regionRef = &options.region;
+			if (sscanf(argv[++i], "%d,%d,%d,%d", &regionRef->x, &regionRef->y, &regionRef->width, &regionRef->height) != 4 ||
+				regionRef->x < 0 || regionRef->y < 0 || regionRef->width <= 0 || regionRef->height <= 0) {
+				fprintf(stderr, "Error: Option region must be four non-negative integers x,y,w,h with a positive size\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--band") == 0 && i + 1 < argc) {
+			if (sscanf(argv[++i], "%d/%d", &bandIndex, &bandCount) != 2 || bandCount <= 0 ||
+				bandIndex < 0 || bandIndex >= bandCount) {
+				fprintf(stderr, "Error: Option band must be i/n with 0 <= i < n\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--heatmap-metric") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "rays") == 0)
+				options.costMetric = COST_RAYS_T;
+			else if (strcmp(argv[i], "tests") == 0)
+				options.costMetric = COST_TESTS_T;
+			else if (strcmp(argv[i], "time") == 0)
+				options.costMetric = COST_TIME_T;
+			else {
+				fprintf(stderr, "Error: Unknown heatmap metric '%s'\n", argv[i]);
+				show_help();
+				return 1;
+			}
+		}
+		else {
+			fprintf(stderr, "Error: Unknown or incomplete option '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+	}
+
+	if (batchFname != NULL) {
+		// Every job of a batch is a plain render, the options which produce more than its image are refused
+		if (positionalLength != 0 || showStats || statsFname != NULL || heatmapFname != NULL || traceFname != NULL ||
+			checkpointFname != NULL || resume || timeBudgetMs > 0 || options.region.width > 0 || bandCount > 0 ||
+			options.processes > 0 || gbufferFname != NULL || relightFname != NULL) {
+			fprintf(stderr, "Error: Option batch takes its sizes, scenes and outputs from the batch file and can not be used "
+							"with stats, stats-json, heatmap, trace, checkpoint, resume, time-budget, region, band, processes, "
+							"gbuffer-save or relight\n");
+			return 1;
+		}
+		if (threads == 0) {
+			long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+			threads = cpus > 0 ? (int) cpus : 1;
+		}
+		options.threads = threads;
+		if (kernels_select(isaName) != 0)
+			return 1;
+		printf("[INFO] Using the %s kernels\n", kernels.name);
+
+		BatchSettings settings = {lightCutoff, shadowMapResolution, shadowBias};
+		return batch_run(batchFname, &options, &settings);
+	}
+
+	if (positionalLength != 4) {
         fprintf(stderr, "Error: Not enough arguments provided\n");
 		show_help();
 		return 1;
 	}
 
-	int imageWidth = atoi(argv[1]);
-	int imageHeight = atoi(argv[2]);
-	char *inputFname = argv[3];
-	char *outputFname = argv[4];
+	int imageWidth = atoi(positional[0]);
+	int imageHeight = atoi(positional[1]);
+	char *inputFname = positional[2];
+	char *outputFname = positional[3];
 
-	if (!isinteger(argv[1]) || imageHeight <= 0) {
-        fprintf(stderr, "Error: Argument render_height must be an positive integer\n");
+	if (!isinteger(positional[0]) || imageWidth <= 0) {
+        fprintf(stderr, "Error: Argument render_width must be an positive integer\n");
         show_help();
 		return 1;
 	}
 
-	if (!isinteger(argv[2]) || imageWidth <= 0) {
-        fprintf(stderr, "Error: Argument render_width must be an positive integer\n");
+	if (!isinteger(positional[1]) || imageHeight <= 0) {
+        fprintf(stderr, "Error: Argument render_height must be an positive integer\n");
 		show_help();
 		return 1;
 	}
 
+	if (bandCount > 0) {
+		if (options.region.width > 0) {
+			fprintf(stderr, "Error: Options region and band can not be used together\n");
+			return 1;
+		}
+		if (bandCount > imageHeight) {
+			fprintf(stderr, "Error: Option band can not split %d rows into %d bands\n", imageHeight, bandCount);
+			return 1;
+		}
+		// Split the rows as evenly as possible, the bands always cover the frame exactly
+		options.region.x = 0;
+		options.region.y = (int) ((long long) imageHeight * bandIndex / bandCount);
+		options.region.width = imageWidth;
+		options.region.height = (int) ((long long) imageHeight * (bandIndex + 1) / bandCount) - options.region.y;
+	}
+	int isRegion = options.region.width > 0;
+
+	RenderQuality quality;
+	if (timeBudgetMs > 0) {
+		if (options.processes > 0 || checkpointFname != NULL || resume) {
+			fprintf(stderr, "Error: Option time-budget can not be used with processes, checkpoint or resume\n");
+			return 1;
+		}
+		// The budget starts when the program does, so parsing the scene counts against it
+		options.deadline = startTime.tv_sec + startTime.tv_nsec * 1e-9 + timeBudgetMs / 1000.0;
+		options.qualityRef = &quality;
+	}
+
+	GBuffer gbuffer;
+	if (gbufferFname != NULL || relightFname != NULL) {
+		if (gbufferFname != NULL && relightFname != NULL) {
+			fprintf(stderr, "Error: Options gbuffer-save and relight can not be used together\n");
+			return 1;
+		}
+		if (options.sparseStep > 1 || timeBudgetMs > 0) {
+			fprintf(stderr, "Error: Options gbuffer-save and relight can not be used with sparse or time-budget\n");
+			return 1;
+		}
+		// Worker processes and resumed tiles would leave holes in a capture
+		if (gbufferFname != NULL && (options.processes > 0 || resume)) {
+			fprintf(stderr, "Error: Option gbuffer-save can not be used with processes or resume\n");
+			return 1;
+		}
+		options.gbufferMode = gbufferFname != NULL ? GBUFFER_CAPTURE_T : GBUFFER_RELIGHT_T;
+		options.gbufferRef = &gbuffer;
+	}
+
+	// Wavefront tiles trace the rays of every pixel together, so there is no cost per pixel
+	if (options.wavefront && (heatmapFname != NULL || options.sparseStep > 1 || options.gbufferMode != GBUFFER_NONE_T)) {
+		fprintf(stderr, "Error: Option wavefront can not be used with heatmap, sparse, gbuffer-save or relight\n");
+		return 1;
+	}
+
+	Costmap costmap;
+	if (heatmapFname != NULL) {
+		if (options.costMetric == COST_NONE_T)
+			options.costMetric = COST_RAYS_T;
+		if (!RENDER_STATS && options.costMetric != COST_TIME_T) {
+			fprintf(stderr, "Error: Heatmap metric requires a build with RENDER_STATS enabled, use 'time' instead\n");
+			return 1;
+		}
+		options.costmapRef = &costmap;
+	}
+
+	if (threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (int) cpus : 1;
+	}
+	options.threads = threads;
+
+	TraceRecorder trace;
+	TraceBuffer *traceBufferRef = NULL;
+	double traceStart;
+	if (traceFname != NULL) {
+		trace_init(&trace);
+		traceBufferRef = trace_thread_buffer(&trace, "main", -1);
+		options.traceRef = &trace;
+	}
+
+	Checkpoint checkpoint;
+	char *defaultCheckpointFname = NULL;
+	if (resume && checkpointFname == NULL) {
+		defaultCheckpointFname = malloc(strlen(outputFname) + 6);
+		if (defaultCheckpointFname == NULL) {
+			fprintf(stderr, "Error: Could not allocate the checkpoint file name\n");
+			return 1;
+		}
+		sprintf(defaultCheckpointFname, "%s.ckpt", outputFname);
+		checkpointFname = defaultCheckpointFname;
+	}
+	if (checkpointFname != NULL) {
+		checkpoint_init(&checkpoint, checkpointFname, checkpointInterval, resume);
+		if (checkpoint_hash_file(&checkpoint, inputFname) != 0)
+			return 1;
+		// Tiles rendered with other options than these would not match the rest of the image
+		checkpoint_hash_option(&checkpoint, "light-cutoff", lightCutoff);
+		checkpoint_hash_option(&checkpoint, "light-samples", options.lightSamples);
+		checkpoint_hash_option(&checkpoint, "shadow-maps", shadowMapResolution);
+		checkpoint_hash_option(&checkpoint, "shadow-bias", shadowBias);
+		checkpoint_hash_option(&checkpoint, "sparse", options.sparseStep);
+		if (relightFname != NULL && checkpoint_hash_option_file(&checkpoint, "relight", relightFname) != 0)
+			return 1;
+		options.checkpointRef = &checkpoint;
+	}
+
+	// Pick the kernels once, before any render thread starts
+	if (kernels_select(isaName) != 0)
+		return 1;
+	printf("[INFO] Using the %s kernels\n", kernels.name);
+
+	RenderReport report;
+	report_init(&report);
+	report.kernelsName = kernels.name;
+	report.imageWidth = isRegion ? options.region.width : imageWidth;
+	report.imageHeight = isRegion ? options.region.height : imageHeight;
+	report.threads = options.processes > 0 ? options.processes : threads;
+	options.statsRef = &report.counters;
+
 	// Read the input JSON file
 	JSONValue JSONRoot;
 	printf("[INFO] Reading input scene file '%s'\n", inputFname);
+	report_stage_begin(&report, STAGE_PARSE_T);
+	traceStart = trace_now(options.traceRef);
 	if (read_json(inputFname, &JSONRoot) != 0)
 		return 1;
+	trace_span(traceBufferRef, "parse", traceStart, trace_now(options.traceRef));
+	report_stage_end(&report, STAGE_PARSE_T);
 
 	// Convert the JSON file to a scene
 	Scene scene;
 	printf("[INFO] Creating scene from input scene file\n");
+	report_stage_begin(&report, STAGE_SCENE_T);
+	traceStart = trace_now(options.traceRef);
 	if (create_scene_from_JSON(&JSONRoot, &scene) != 0)
 		return 1;
+	printf("[INFO] Scene has %d primitive(s) of %zu bytes sharing %d material(s)\n", scene.primitivesLength,
+		   sizeof(Primitive), scene.materialsLength);
+	for (int i = 0; i < scene.primitivesLength; i++) {
+		if (scene.primitives[i]->type != MESH_T)
+			continue;
+		MeshData *meshRef = scene.primitives[i]->data.mesh.dataRef;
+		size_t meshBytes = mesh_memory(meshRef);
+		printf("[INFO] Mesh primitive %d has %d vertices, %d triangles, %zu bytes (%.1f bytes per triangle)\n", i,
+			   meshRef->verticesLength, meshRef->trianglesLength, meshBytes, (double) meshBytes / meshRef->trianglesLength);
+	}
+	if (options.checkpointRef != NULL && checkpoint_hash_meshes(&checkpoint, &scene) != 0)
+		return 1;
+	scene_bake_light_bounds(&scene, lightCutoff);
+	if (scene_pack_primitives(&scene) != 0)
+		return 1;
+
+	// Many lights are found through a light tree, picking lights always needs one
+	LightTree lightTree;
+	if (scene.lightsLength >= LIGHT_TREE_MIN_LIGHTS || options.lightSamples > 0) {
+		if (light_tree_build(&lightTree, &scene) != 0)
+			return 1;
+		scene.lightTreeRef = &lightTree;
+	}
+
+	if (shadowMapResolution > 0) {
+		printf("[INFO] Baking %dx%d shadow maps for %d light(s)\n", shadowMapResolution, shadowMapResolution, scene.lightsLength);
+		double bakeStart = trace_now(options.traceRef);
+		if (scene_bake_shadow_maps(&scene, shadowMapResolution, shadowBias, threads) != 0)
+			return 1;
+		trace_span(traceBufferRef, "bake shadow maps", bakeStart, trace_now(options.traceRef));
+	}
+	trace_span(traceBufferRef, "create scene", traceStart, trace_now(options.traceRef));
+	report_stage_end(&report, STAGE_SCENE_T);
+
+	if (relightFname != NULL) {
+		printf("[INFO] Reading G-buffer file '%s'\n", relightFname);
+		if (load_gbuffer(&gbuffer, relightFname) != 0)
+			return 1;
+	}
 
 	// Raycast the scene into an image
 	Image image;
 	printf("[INFO] Raytracing scene into image\n");
-	if (raycast(&scene, &image, imageWidth, imageHeight) != 0)
+	if (isRegion)
+		printf("[INFO] Rendering only the %dx%d region at %d,%d of the %dx%d frame\n", options.region.width,
+			   options.region.height, options.region.x, options.region.y, imageWidth, imageHeight);
+	report_stage_begin(&report, STAGE_RENDER_T);
+	traceStart = trace_now(options.traceRef);
+	if (raycast(&scene, &image, imageWidth, imageHeight, &options) != 0)
 		return 1;
+	trace_span(traceBufferRef, "render", traceStart, trace_now(options.traceRef));
+	report_stage_end(&report, STAGE_RENDER_T);
+
+	if (options.qualityRef != NULL) {
+		printf("[INFO] Time budget reached quality level %d of %d (%s), %.1f%% of the next level was refined\n",
+			   quality.level, quality.levels, quality.levelName, quality.nextLevelFraction * 100);
+		report.qualityLevel = quality.level;
+		report.qualityLevels = quality.levels;
+		report.qualityName = quality.levelName;
+		report.qualityNextFraction = quality.nextLevelFraction;
+	}
 
 	// Write the image out to the specified file
 	printf("[INFO] Saving image (PPM P6) to output file '%s'\n", outputFname);
-	if (save_ppm_p6_image(&image, outputFname) != 0)
+	report_stage_begin(&report, STAGE_WRITE_T);
+	traceStart = trace_now(options.traceRef);
+	if (save_ppm_p6_image_region(&image, isRegion ? &options.region : NULL, outputFname) != 0)
 		return 1;
+	trace_span(traceBufferRef, "write image", traceStart, trace_now(options.traceRef));
+	report_stage_end(&report, STAGE_WRITE_T);
+
+	if (gbufferFname != NULL) {
+		printf("[INFO] Saving G-buffer to '%s'\n", gbufferFname);
+		if (save_gbuffer(&gbuffer, gbufferFname) != 0)
+			return 1;
+	}
+	if (options.gbufferRef != NULL)
+		gbuffer_free(&gbuffer);
+	if (scene.lightTreeRef != NULL)
+		light_tree_free(&lightTree);
+	scene_free_shadow_maps(&scene);
+	scene_free_meshes(&scene);
+	scene_free_pack(&scene);
+	scene_free_materials(&scene);
+	scene_free_primitives(&scene);
+
+	// The output is safely written, the checkpoint is no longer needed
+	if (options.checkpointRef != NULL) {
+		checkpoint_remove(&checkpoint);
+		free(defaultCheckpointFname);
+	}
+
+	if (heatmapFname != NULL) {
+		size_t heatmapFnameLength = strlen(heatmapFname);
+		if (heatmapFnameLength > 4 && strcmp(heatmapFname + heatmapFnameLength - 4, ".pfm") == 0) {
+			printf("[INFO] Saving cost map (PFM) to '%s'\n", heatmapFname);
+			if (save_pfm_image(&costmap, heatmapFname) != 0)
+				return 1;
+		}
+		else {
+			Image heatmap;
+			float maxCost;
+			if (costmap_to_heatmap(&costmap, &heatmap, &maxCost) != 0)
+				return 1;
+			printf("[INFO] Saving heatmap (PPM P6) to '%s', scale is log(1 + cost) up to %.0f\n", heatmapFname, maxCost);
+			if (save_ppm_p6_image(&heatmap, heatmapFname) != 0)
+				return 1;
+		}
+	}
+
+	if (showStats)
+		print_render_report(&report);
+
+	if (statsFname != NULL) {
+		printf("[INFO] Saving render statistics to '%s'\n", statsFname);
+		if (save_render_report_json(&report, statsFname) != 0)
+			return 1;
+	}
+
+	if (traceFname != NULL) {
+		printf("[INFO] Saving trace to '%s'\n", traceFname);
+		if (save_trace_json(&trace, traceFname) != 0)
+			return 1;
+		trace_free(&trace);
+	}
 
 	printf("[INFO] Finished!\n");
 	return 0;
@@ -0,0 +1,161 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "material.h"
+#include "constants.h"
+
+#define MATERIAL_TABLE_INITIAL_SLOTS 64
+
+/**
+ * Hash the fields of a material, materials are compared field by field so padding never matters
+ */
+static uint64_t material_hash(Material *materialRef) {
+	double fields[9] = {
+		materialRef->diffuseColor.array[0], materialRef->diffuseColor.array[1], materialRef->diffuseColor.array[2],
+		materialRef->specularColor.array[0], materialRef->specularColor.array[1], materialRef->specularColor.array[2],
+		materialRef->reflectivity, materialRef->refractivity, materialRef->ior
+	};
+	const unsigned char *bytes = (const unsigned char *) fields;
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < sizeof(fields); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Determine if two materials light a surface the same way
+ */
+static int material_equal(Material *a, Material *b) {
+	for (int i = 0; i < 3; i++) {
+		if (a->diffuseColor.array[i] != b->diffuseColor.array[i] || a->specularColor.array[i] != b->specularColor.array[i])
+			return FALSE;
+	}
+	return a->reflectivity == b->reflectivity && a->refractivity == b->refractivity && a->ior == b->ior;
+}
+
+/**
+ * Start an empty material table
+ * @param tableRef - The table to initialize
+ * @return 0 if success, otherwise a failure occurred
+ */
+int material_table_init(MaterialTable *tableRef) {
+	tableRef->length = 0;
+	tableRef->capacity = 0;
+	tableRef->materials = NULL;
+	tableRef->slotsLength = MATERIAL_TABLE_INITIAL_SLOTS;
+	tableRef->slots = malloc(sizeof(int32_t) * tableRef->slotsLength);
+	if (tableRef->slots == NULL) {
+		fprintf(stderr, "Error: Could not allocate the material table\n");
+		return 1;
+	}
+	memset(tableRef->slots, -1, sizeof(int32_t) * tableRef->slotsLength);
+	return 0;
+}
+
+/**
+ * Double the hash slots of a table and place every material again
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int material_table_grow(MaterialTable *tableRef) {
+	int slotsLength = tableRef->slotsLength * 2;
+	int32_t *slots = malloc(sizeof(int32_t) * slotsLength);
+
+	if (slots == NULL)
+		return 1;
+	memset(slots, -1, sizeof(int32_t) * slotsLength);
+	for (int i = 0; i < tableRef->length; i++) {
+		uint64_t slot = material_hash(&tableRef->materials[i]) & (slotsLength - 1);
+		while (slots[slot] >= 0)
+			slot = (slot + 1) & (slotsLength - 1);
+		slots[slot] = i;
+	}
+	free(tableRef->slots);
+	tableRef->slots = slots;
+	tableRef->slotsLength = slotsLength;
+	return 0;
+}
+
+/**
+ * Find the index of a material in a table, adding it if it is not there yet
+ * @param tableRef - The table
+ * @param materialRef - The material
+ * @param indexRef - Set to the index of the material
+ * @return 0 if success, otherwise a failure occurred
+ */
+int material_intern(MaterialTable *tableRef, Material *materialRef, uint32_t *indexRef) {
+	uint64_t slot = material_hash(materialRef) & (tableRef->slotsLength - 1);
+
+	while (tableRef->slots[slot] >= 0) {
+		if (material_equal(&tableRef->materials[tableRef->slots[slot]], materialRef)) {
+			*indexRef = (uint32_t) tableRef->slots[slot];
+			return 0;
+		}
+		slot = (slot + 1) & (tableRef->slotsLength - 1);
+	}
+
+	if (tableRef->length == tableRef->capacity) {
+		int capacity = tableRef->capacity > 0 ? tableRef->capacity * 2 : 16;
+		Material *materials = realloc(tableRef->materials, sizeof(Material) * capacity);
+		if (materials == NULL) {
+			fprintf(stderr, "Error: Could not allocate the material table\n");
+			return 1;
+		}
+		tableRef->materials = materials;
+		tableRef->capacity = capacity;
+	}
+	tableRef->materials[tableRef->length] = *materialRef;
+	tableRef->slots[slot] = tableRef->length;
+	*indexRef = (uint32_t) tableRef->length++;
+
+	// Keep the slots at most half full so probe runs stay short
+	if (tableRef->length * 2 > tableRef->slotsLength && material_table_grow(tableRef) != 0) {
+		fprintf(stderr, "Error: Could not allocate the material table\n");
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Release a table whose materials were not handed to a scene
+ * @param tableRef - The table, empty on return
+ */
+void material_table_free(MaterialTable *tableRef) {
+	free(tableRef->materials);
+	free(tableRef->slots);
+	tableRef->materials = NULL;
+	tableRef->slots = NULL;
+	tableRef->length = 0;
+	tableRef->capacity = 0;
+}
+
+/**
+ * Hand the materials of a table to a scene and release the hash slots
+ * @param tableRef - The table, empty on return
+ * @param sceneRef - The scene which takes the materials
+ */
+void material_table_to_scene(MaterialTable *tableRef, Scene *sceneRef) {
+	sceneRef->materials = tableRef->materials;
+	sceneRef->materialsLength = tableRef->length;
+	free(tableRef->slots);
+	tableRef->materials = NULL;
+	tableRef->slots = NULL;
+	tableRef->length = 0;
+	tableRef->capacity = 0;
+}
+
+/**
+ * Release the material table of a scene
+ * @param sceneRef - The scene whose materials are freed
+ */
+void scene_free_materials(Scene *sceneRef) {
+	free(sceneRef->materials);
+	sceneRef->materials = NULL;
+	sceneRef->materialsLength = 0;
+}
@@ -0,0 +1,29 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_MATERIAL_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_MATERIAL_H
+
+#include <stdint.h>
+#include "raycaster.h"
+
+/**
+ * Material Table - the distinct materials of a scene being loaded, with an open addressing hash table
+ * of their indices so that every material is stored once however many primitives use it
+ */
+typedef struct MaterialTable {
+	Material *materials;
+	int length;
+	int capacity;
+	int32_t *slots;
+	int slotsLength;
+} MaterialTable;
+
+int material_table_init(MaterialTable *tableRef);
+int material_intern(MaterialTable *tableRef, Material *materialRef, uint32_t *indexRef);
+void material_table_to_scene(MaterialTable *tableRef, Scene *sceneRef);
+void material_table_free(MaterialTable *tableRef);
+void scene_free_materials(Scene *sceneRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_MATERIAL_H
@@ -0,0 +1,872 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mesh.h"
+#include "stats.h"
+#include "raycaster.h"
+
+__thread MeshHit threadMeshHit;
+
+/**
+ * A growable array used while a model is parsed
+ */
+typedef struct MeshBuffer {
+	void *data;
+	size_t length;
+	size_t capacity;
+	size_t elementSize;
+} MeshBuffer;
+
+/**
+ * A view of a model file mapped into memory, the mapping is not NUL terminated
+ */
+typedef struct MeshFile {
+	char *fname;
+	const char *start;
+	const char *position;
+	const char *end;
+} MeshFile;
+
+/**
+ * Make room for count more elements in a buffer
+ * @return A pointer to the first new element, or NULL when it could not grow
+ */
+static void *mesh_buffer_push(MeshBuffer *bufferRef, size_t count) {
+	if (bufferRef->length + count > bufferRef->capacity) {
+		size_t capacity = bufferRef->capacity > 0 ? bufferRef->capacity * 2 : 1024;
+		while (capacity < bufferRef->length + count)
+			capacity *= 2;
+		void *data = realloc(bufferRef->data, capacity * bufferRef->elementSize);
+		if (data == NULL)
+			return NULL;
+		bufferRef->data = data;
+		bufferRef->capacity = capacity;
+	}
+	void *element = (char *) bufferRef->data + bufferRef->length * bufferRef->elementSize;
+	bufferRef->length += count;
+	return element;
+}
+
+/**
+ * Skip spaces and tabs, but not the end of the line
+ */
+static void mesh_skip_blanks(MeshFile *fileRef) {
+	while (fileRef->position < fileRef->end && (*fileRef->position == ' ' || *fileRef->position == '\t' || *fileRef->position == '\r'))
+		fileRef->position++;
+}
+
+/**
+ * Move past the end of the current line
+ */
+static void mesh_skip_line(MeshFile *fileRef) {
+	while (fileRef->position < fileRef->end && *fileRef->position != '\n')
+		fileRef->position++;
+	if (fileRef->position < fileRef->end)
+		fileRef->position++;
+}
+
+/**
+ * Copy the next whitespace separated token of the current line into a NUL terminated buffer
+ * @return The length of the token, 0 at the end of the line
+ */
+static int mesh_read_token(MeshFile *fileRef, char *token, int size) {
+	int length = 0;
+
+	mesh_skip_blanks(fileRef);
+	while (fileRef->position < fileRef->end && *fileRef->position != '\n' && *fileRef->position != ' ' &&
+		   *fileRef->position != '\t' && *fileRef->position != '\r') {
+		if (length + 1 < size)
+			token[length++] = *fileRef->position;
+		fileRef->position++;
+	}
+	token[length] = '\0';
+	return length;
+}
+
+/**
+ * Read the next token of the current line as a number
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int mesh_read_number(MeshFile *fileRef, double *valueRef) {
+	char token[64];
+	char *tokenEnd;
+
+	if (mesh_read_token(fileRef, token, sizeof(token)) == 0)
+		return 1;
+	*valueRef = strtod(token, &tokenEnd);
+	return *tokenEnd != '\0';
+}
+
+/**
+ * Resolve a 1 based OBJ index, negative indices count back from the last element read
+ * @return The 0 based index, or -1 when it is out of range
+ */
+static long mesh_obj_index(long index, size_t length) {
+	if (index < 0)
+		index += (long) length;
+	else
+		index -= 1;
+	return index >= 0 && index < (long) length ? index : -1;
+}
+
+/**
+ * Parse a Wavefront OBJ model, only positions, normals and faces are read and polygons are split into
+ * triangle fans
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int mesh_parse_obj(MeshFile *fileRef, MeshBuffer *verticesRef, MeshBuffer *normalsRef, MeshBuffer *indicesRef,
+						  MeshBuffer *normalIndicesRef) {
+	char token[64];
+	int faceNormals = 1;
+	int line = 0;
+
+	while (fileRef->position < fileRef->end) {
+		line++;
+		if (mesh_read_token(fileRef, token, sizeof(token)) == 0 || token[0] == '#') {
+			mesh_skip_line(fileRef);
+			continue;
+		}
+
+		if (strcmp(token, "v") == 0 || strcmp(token, "vn") == 0) {
+			MeshBuffer *bufferRef = token[1] == 'n' ? normalsRef : verticesRef;
+			float *values = mesh_buffer_push(bufferRef, 3);
+			if (values == NULL)
+				return 1;
+			for (int k = 0; k < 3; k++) {
+				double value;
+				if (mesh_read_number(fileRef, &value) != 0) {
+					fprintf(stderr, "Error: Model '%s' has an invalid vector on line %d\n", fileRef->fname, line);
+					return 1;
+				}
+				values[k] = (float) value;
+			}
+		}
+		else if (strcmp(token, "f") == 0) {
+			long first[2] = {-1, -1};
+			long previous[2] = {-1, -1};
+			int corners = 0;
+
+			while (mesh_read_token(fileRef, token, sizeof(token)) > 0) {
+				char *field = token;
+				char *fieldEnd;
+				long corner[2] = {-1, -1};
+
+				corner[0] = mesh_obj_index(strtol(field, &fieldEnd, 10), verticesRef->length / 3);
+				if (fieldEnd == field || corner[0] < 0) {
+					fprintf(stderr, "Error: Model '%s' has an invalid face on line %d\n", fileRef->fname, line);
+					return 1;
+				}
+
+				// Corners are v, v/vt, v//vn or v/vt/vn, texture coordinates are ignored
+				if (*fieldEnd == '/') {
+					field = strchr(fieldEnd + 1, '/');
+					if (field != NULL && field[1] != '\0')
+						corner[1] = mesh_obj_index(strtol(field + 1, &fieldEnd, 10), normalsRef->length / 3);
+				}
+				if (corner[1] < 0)
+					faceNormals = 0;
+
+				if (corners == 0) {
+					first[0] = corner[0];
+					first[1] = corner[1];
+				}
+				else if (corners >= 2) {
+					uint32_t *triangle = mesh_buffer_push(indicesRef, 3);
+					uint32_t *normalTriangle = mesh_buffer_push(normalIndicesRef, 3);
+					if (triangle == NULL || normalTriangle == NULL)
+						return 1;
+					triangle[0] = (uint32_t) first[0];
+					triangle[1] = (uint32_t) previous[0];
+					triangle[2] = (uint32_t) corner[0];
+					normalTriangle[0] = (uint32_t) first[1];
+					normalTriangle[1] = (uint32_t) previous[1];
+					normalTriangle[2] = (uint32_t) corner[1];
+				}
+				previous[0] = corner[0];
+				previous[1] = corner[1];
+				corners++;
+			}
+
+			if (corners < 3) {
+				fprintf(stderr, "Error: Model '%s' has a face with fewer than 3 corners on line %d\n", fileRef->fname, line);
+				return 1;
+			}
+		}
+		mesh_skip_line(fileRef);
+	}
+
+	// Normals are only used when every face has them
+	if (!faceNormals)
+		normalIndicesRef->length = 0;
+	return 0;
+}
+
+/**
+ * PLY scalar types
+ */
+typedef enum PlyType_t {
+	PLY_NONE_T,
+	PLY_INT8_T,
+	PLY_UINT8_T,
+	PLY_INT16_T,
+	PLY_UINT16_T,
+	PLY_INT32_T,
+	PLY_UINT32_T,
+	PLY_FLOAT32_T,
+	PLY_FLOAT64_T
+} PlyType_t;
+
+/**
+ * Get the type of a PLY property type name
+ */
+static PlyType_t ply_type(const char *name) {
+	if (strcmp(name, "char") == 0 || strcmp(name, "int8") == 0)
+		return PLY_INT8_T;
+	if (strcmp(name, "uchar") == 0 || strcmp(name, "uint8") == 0)
+		return PLY_UINT8_T;
+	if (strcmp(name, "short") == 0 || strcmp(name, "int16") == 0)
+		return PLY_INT16_T;
+	if (strcmp(name, "ushort") == 0 || strcmp(name, "uint16") == 0)
+		return PLY_UINT16_T;
+	if (strcmp(name, "int") == 0 || strcmp(name, "int32") == 0)
+		return PLY_INT32_T;
+	if (strcmp(name, "uint") == 0 || strcmp(name, "uint32") == 0)
+		return PLY_UINT32_T;
+	if (strcmp(name, "float") == 0 || strcmp(name, "float32") == 0)
+		return PLY_FLOAT32_T;
+	if (strcmp(name, "double") == 0 || strcmp(name, "float64") == 0)
+		return PLY_FLOAT64_T;
+	return PLY_NONE_T;
+}
+
+/**
+ * Get the size in bytes of a PLY type
+ */
+static int ply_type_size(PlyType_t type) {
+	static const int sizes[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+	return sizes[type];
+}
+
+/**
+ * Read one PLY value, as text or as little endian binary
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int ply_read_value(MeshFile *fileRef, int binary, PlyType_t type, double *valueRef) {
+	if (!binary) {
+		// Values of an element may continue on the next line
+		while (fileRef->position < fileRef->end && (*fileRef->position == '\n' || *fileRef->position == ' ' ||
+													*fileRef->position == '\t' || *fileRef->position == '\r'))
+			fileRef->position++;
+		return mesh_read_number(fileRef, valueRef);
+	}
+
+	int size = ply_type_size(type);
+	if (fileRef->end - fileRef->position < size)
+		return 1;
+
+	union {
+		int8_t i8; uint8_t u8; int16_t i16; uint16_t u16; int32_t i32; uint32_t u32; float f32; double f64;
+	} value;
+	memcpy(&value, fileRef->position, size);
+	fileRef->position += size;
+	switch (type) {
+		case PLY_INT8_T: *valueRef = value.i8; break;
+		case PLY_UINT8_T: *valueRef = value.u8; break;
+		case PLY_INT16_T: *valueRef = value.i16; break;
+		case PLY_UINT16_T: *valueRef = value.u16; break;
+		case PLY_INT32_T: *valueRef = value.i32; break;
+		case PLY_UINT32_T: *valueRef = value.u32; break;
+		case PLY_FLOAT32_T: *valueRef = value.f32; break;
+		case PLY_FLOAT64_T: *valueRef = value.f64; break;
+		default: return 1;
+	}
+	return 0;
+}
+
+#define PLY_MAX_ELEMENTS 8
+#define PLY_MAX_PROPERTIES 32
+
+/**
+ * A PLY element from the header, list properties have a count type
+ */
+typedef struct PlyElement {
+	char name[32];
+	long length;
+	int propertiesLength;
+	char propertyNames[PLY_MAX_PROPERTIES][32];
+	PlyType_t propertyTypes[PLY_MAX_PROPERTIES];
+	PlyType_t propertyCountTypes[PLY_MAX_PROPERTIES];
+} PlyElement;
+
+/**
+ * Parse a PLY model in ascii or binary_little_endian format, vertices keep their x, y, z and optional
+ * nx, ny, nz properties and faces their vertex_indices list, polygons are split into triangle fans
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int mesh_parse_ply(MeshFile *fileRef, MeshBuffer *verticesRef, MeshBuffer *normalsRef, MeshBuffer *indicesRef) {
+	PlyElement elements[PLY_MAX_ELEMENTS];
+	int elementsLength = 0;
+	int binary = -1;
+	char token[64];
+
+	// Read the header
+	while (1) {
+		if (fileRef->position >= fileRef->end || mesh_read_token(fileRef, token, sizeof(token)) == 0) {
+			if (fileRef->position >= fileRef->end) {
+				fprintf(stderr, "Error: Model '%s' has no end_header\n", fileRef->fname);
+				return 1;
+			}
+			mesh_skip_line(fileRef);
+			continue;
+		}
+
+		if (strcmp(token, "end_header") == 0) {
+			mesh_skip_line(fileRef);
+			break;
+		}
+		else if (strcmp(token, "format") == 0) {
+			mesh_read_token(fileRef, token, sizeof(token));
+			if (strcmp(token, "ascii") == 0)
+				binary = 0;
+			else if (strcmp(token, "binary_little_endian") == 0)
+				binary = 1;
+			else {
+				fprintf(stderr, "Error: Model '%s' has the unsupported PLY format '%s'\n", fileRef->fname, token);
+				return 1;
+			}
+		}
+		else if (strcmp(token, "element") == 0) {
+			if (elementsLength == PLY_MAX_ELEMENTS) {
+				fprintf(stderr, "Error: Model '%s' has too many PLY elements\n", fileRef->fname);
+				return 1;
+			}
+			PlyElement *elementRef = &elements[elementsLength++];
+			double length;
+			mesh_read_token(fileRef, elementRef->name, sizeof(elementRef->name));
+			if (mesh_read_number(fileRef, &length) != 0 || length < 0) {
+				fprintf(stderr, "Error: Model '%s' has an invalid PLY element count\n", fileRef->fname);
+				return 1;
+			}
+			elementRef->length = (long) length;
+			elementRef->propertiesLength = 0;
+		}
+		else if (strcmp(token, "property") == 0) {
+			if (elementsLength == 0 || elements[elementsLength - 1].propertiesLength == PLY_MAX_PROPERTIES) {
+				fprintf(stderr, "Error: Model '%s' has a PLY property outside of an element\n", fileRef->fname);
+				return 1;
+			}
+			PlyElement *elementRef = &elements[elementsLength - 1];
+			int property = elementRef->propertiesLength++;
+			mesh_read_token(fileRef, token, sizeof(token));
+			elementRef->propertyCountTypes[property] = PLY_NONE_T;
+			if (strcmp(token, "list") == 0) {
+				mesh_read_token(fileRef, token, sizeof(token));
+				elementRef->propertyCountTypes[property] = ply_type(token);
+				mesh_read_token(fileRef, token, sizeof(token));
+			}
+			elementRef->propertyTypes[property] = ply_type(token);
+			mesh_read_token(fileRef, elementRef->propertyNames[property], sizeof(elementRef->propertyNames[property]));
+			if (elementRef->propertyTypes[property] == PLY_NONE_T) {
+				fprintf(stderr, "Error: Model '%s' has the unknown PLY type '%s'\n", fileRef->fname, token);
+				return 1;
+			}
+		}
+		mesh_skip_line(fileRef);
+	}
+
+	if (binary < 0) {
+		fprintf(stderr, "Error: Model '%s' has no PLY format\n", fileRef->fname);
+		return 1;
+	}
+
+	// Read the elements in order, anything but vertices and faces is skipped
+	for (int e = 0; e < elementsLength; e++) {
+		PlyElement *elementRef = &elements[e];
+		int isVertex = strcmp(elementRef->name, "vertex") == 0;
+		int isFace = strcmp(elementRef->name, "face") == 0;
+		// One bit per component of the position and of the normal that the vertices have
+		int positionComponents = 0;
+		int normalComponents = 0;
+
+		if (isVertex) {
+			for (int p = 0; p < elementRef->propertiesLength; p++) {
+				char *name = elementRef->propertyNames[p];
+				if (elementRef->propertyCountTypes[p] != PLY_NONE_T)
+					continue;
+				if (name[0] >= 'x' && name[0] <= 'z' && name[1] == '\0')
+					positionComponents |= 1 << (name[0] - 'x');
+				if (name[0] == 'n' && name[1] >= 'x' && name[1] <= 'z' && name[2] == '\0')
+					normalComponents |= 1 << (name[1] - 'x');
+			}
+			// Every component a vertex has is written, a missing one would be left uninitialized
+			if (positionComponents != 7) {
+				fprintf(stderr, "Error: Model '%s' has vertices without all of x, y and z\n", fileRef->fname);
+				return 1;
+			}
+			if (normalComponents != 0 && normalComponents != 7) {
+				fprintf(stderr, "Error: Model '%s' has normals without all of nx, ny and nz\n", fileRef->fname);
+				return 1;
+			}
+		}
+		int hasNormals = normalComponents == 7;
+
+		for (long i = 0; i < elementRef->length; i++) {
+			float *vertex = isVertex ? mesh_buffer_push(verticesRef, 3) : NULL;
+			float *normal = isVertex && hasNormals ? mesh_buffer_push(normalsRef, 3) : NULL;
+			if (isVertex && (vertex == NULL || (hasNormals && normal == NULL)))
+				return 1;
+
+			for (int p = 0; p < elementRef->propertiesLength; p++) {
+				char *name = elementRef->propertyNames[p];
+				double value;
+
+				if (elementRef->propertyCountTypes[p] != PLY_NONE_T) {
+					double count;
+					int isIndices = isFace && (strcmp(name, "vertex_indices") == 0 || strcmp(name, "vertex_index") == 0);
+					long corners[3];
+
+					if (ply_read_value(fileRef, binary, elementRef->propertyCountTypes[p], &count) != 0)
+						goto truncated;
+					for (long c = 0; c < (long) count; c++) {
+						if (ply_read_value(fileRef, binary, elementRef->propertyTypes[p], &value) != 0)
+							goto truncated;
+						if (!isIndices)
+							continue;
+						if (value < 0 || value >= verticesRef->length / 3) {
+							fprintf(stderr, "Error: Model '%s' has a face with an invalid vertex index\n", fileRef->fname);
+							return 1;
+						}
+						if (c < 2) {
+							corners[c] = (long) value;
+							continue;
+						}
+						corners[2] = (long) value;
+						uint32_t *triangle = mesh_buffer_push(indicesRef, 3);
+						if (triangle == NULL)
+							return 1;
+						triangle[0] = (uint32_t) corners[0];
+						triangle[1] = (uint32_t) corners[1];
+						triangle[2] = (uint32_t) corners[2];
+						corners[1] = corners[2];
+					}
+					if (isIndices && count < 3) {
+						fprintf(stderr, "Error: Model '%s' has a face with fewer than 3 corners\n", fileRef->fname);
+						return 1;
+					}
+					continue;
+				}
+
+				if (ply_read_value(fileRef, binary, elementRef->propertyTypes[p], &value) != 0)
+					goto truncated;
+				if (vertex != NULL && name[1] == '\0' && name[0] >= 'x' && name[0] <= 'z')
+					vertex[name[0] - 'x'] = (float) value;
+				if (normal != NULL && name[0] == 'n' && name[1] >= 'x' && name[1] <= 'z' && name[2] == '\0')
+					normal[name[1] - 'x'] = (float) value;
+			}
+		}
+	}
+	return 0;
+
+truncated:
+	fprintf(stderr, "Error: Model '%s' ended before all of its elements were read\n", fileRef->fname);
+	return 1;
+}
+
+/**
+ * Grow the bounds of a node by one vertex
+ */
+static void mesh_bounds_add(MeshNode *nodeRef, float *vertex) {
+	for (int k = 0; k < 3; k++) {
+		if (vertex[k] < nodeRef->boundsMin[k])
+			nodeRef->boundsMin[k] = vertex[k];
+		if (vertex[k] > nodeRef->boundsMax[k])
+			nodeRef->boundsMax[k] = vertex[k];
+	}
+}
+
+/**
+ * Swap two triangles along with their normal indices and centroids
+ */
+static void mesh_swap_triangles(MeshData *meshRef, float *centroids, int a, int b) {
+	for (int k = 0; k < 3; k++) {
+		uint32_t index = meshRef->indices[a*3 + k];
+		meshRef->indices[a*3 + k] = meshRef->indices[b*3 + k];
+		meshRef->indices[b*3 + k] = index;
+		if (meshRef->normalIndices != NULL && meshRef->normalIndices != meshRef->indices) {
+			index = meshRef->normalIndices[a*3 + k];
+			meshRef->normalIndices[a*3 + k] = meshRef->normalIndices[b*3 + k];
+			meshRef->normalIndices[b*3 + k] = index;
+		}
+		float centroid = centroids[a*3 + k];
+		centroids[a*3 + k] = centroids[b*3 + k];
+		centroids[b*3 + k] = centroid;
+	}
+}
+
+/**
+ * Build the hierarchy over a range of triangles, reordering them so every leaf is contiguous
+ * @return The index of the node built
+ */
+static int mesh_build_node(MeshData *meshRef, float *centroids, int first, int count, int depth) {
+	int index = meshRef->nodesLength++;
+	MeshNode *nodeRef = &meshRef->nodes[index];
+	float centroidMin[3] = {INFINITY, INFINITY, INFINITY};
+	float centroidMax[3] = {-INFINITY, -INFINITY, -INFINITY};
+
+	for (int k = 0; k < 3; k++) {
+		nodeRef->boundsMin[k] = INFINITY;
+		nodeRef->boundsMax[k] = -INFINITY;
+	}
+	for (int i = first; i < first + count; i++) {
+		for (int c = 0; c < 3; c++)
+			mesh_bounds_add(nodeRef, &meshRef->vertices[meshRef->indices[i*3 + c] * 3]);
+		for (int k = 0; k < 3; k++) {
+			centroidMin[k] = fminf(centroidMin[k], centroids[i*3 + k]);
+			centroidMax[k] = fmaxf(centroidMax[k], centroids[i*3 + k]);
+		}
+	}
+
+	if (count <= MESH_LEAF_TRIANGLES) {
+		nodeRef->first = first;
+		nodeRef->count = count;
+		return index;
+	}
+
+	// Split at the middle of the longest axis of the centroids, in half when that leaves a side empty
+	// or the tree gets too deep for the traversal stack
+	int axis = 0;
+	for (int k = 1; k < 3; k++) {
+		if (centroidMax[k] - centroidMin[k] > centroidMax[axis] - centroidMin[axis])
+			axis = k;
+	}
+	float middle = (centroidMin[axis] + centroidMax[axis]) / 2;
+	int split = first;
+	if (depth < MESH_MAX_DEPTH / 2) {
+		for (int i = first; i < first + count; i++) {
+			if (centroids[i*3 + axis] < middle)
+				mesh_swap_triangles(meshRef, centroids, i, split++);
+		}
+	}
+	if (split == first || split == first + count)
+		split = first + count / 2;
+
+	nodeRef->count = 0;
+	mesh_build_node(meshRef, centroids, first, split - first, depth + 1);
+	int right = mesh_build_node(meshRef, centroids, split, first + count - split, depth + 1);
+	meshRef->nodes[index].first = right;
+	return index;
+}
+
+/**
+ * Build the bounding volume hierarchy of a mesh
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int mesh_build(MeshData *meshRef) {
+	float *centroids = malloc(sizeof(float) * 3 * meshRef->trianglesLength);
+	meshRef->nodes = malloc(sizeof(MeshNode) * 2 * meshRef->trianglesLength);
+	meshRef->nodesLength = 0;
+	if (centroids == NULL || meshRef->nodes == NULL) {
+		free(centroids);
+		return 1;
+	}
+
+	for (int i = 0; i < meshRef->trianglesLength; i++) {
+		for (int k = 0; k < 3; k++) {
+			centroids[i*3 + k] = (meshRef->vertices[meshRef->indices[i*3] * 3 + k] +
+								  meshRef->vertices[meshRef->indices[i*3 + 1] * 3 + k] +
+								  meshRef->vertices[meshRef->indices[i*3 + 2] * 3 + k]) / 3;
+		}
+	}
+	mesh_build_node(meshRef, centroids, 0, meshRef->trianglesLength, 0);
+
+	free(centroids);
+	return 0;
+}
+
+/**
+ * Load a triangle mesh from an OBJ or PLY model, chosen by the file extension. The file is mapped
+ * into memory and parsed in place, then moved to the position and scale it has in the scene.
+ * @param fname - The model file
+ * @param positionRef - Added to every vertex after scaling
+ * @param scale - Multiplies every vertex
+ * @param meshRef - The mesh loaded
+ * @return 0 if success, otherwise a failure occurred
+ */
+int load_mesh(char *fname, V3 *positionRef, double scale, MeshData *meshRef) {
+	MeshBuffer vertices = {NULL, 0, 0, sizeof(float)};
+	MeshBuffer normals = {NULL, 0, 0, sizeof(float)};
+	MeshBuffer indices = {NULL, 0, 0, sizeof(uint32_t)};
+	MeshBuffer normalIndices = {NULL, 0, 0, sizeof(uint32_t)};
+	size_t fnameLength = strlen(fname);
+	int isPly = fnameLength > 4 && strcmp(fname + fnameLength - 4, ".ply") == 0;
+	struct stat fileStat;
+	int result;
+
+	int fd = open(fname, O_RDONLY);
+	if (fd < 0 || fstat(fd, &fileStat) != 0) {
+		fprintf(stderr, "Error: Model '%s' could not be opened for reading\n", fname);
+		if (fd >= 0)
+			close(fd);
+		return 1;
+	}
+	if (fileStat.st_size == 0) {
+		fprintf(stderr, "Error: Model '%s' is empty\n", fname);
+		close(fd);
+		return 1;
+	}
+
+	char *mapped = mmap(NULL, (size_t) fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		fprintf(stderr, "Error: Model '%s' could not be mapped into memory\n", fname);
+		return 1;
+	}
+	madvise(mapped, (size_t) fileStat.st_size, MADV_SEQUENTIAL);
+
+	MeshFile file = {fname, mapped, mapped, mapped + fileStat.st_size};
+	if (isPly)
+		result = mesh_parse_ply(&file, &vertices, &normals, &indices);
+	else
+		result = mesh_parse_obj(&file, &vertices, &normals, &indices, &normalIndices);
+	munmap(mapped, (size_t) fileStat.st_size);
+
+	if (result == 0 && indices.length == 0) {
+		fprintf(stderr, "Error: Model '%s' has no faces\n", fname);
+		result = 1;
+	}
+	if (result != 0) {
+		free(vertices.data);
+		free(normals.data);
+		free(indices.data);
+		free(normalIndices.data);
+		return 1;
+	}
+
+	meshRef->fname = strdup(fname);
+	meshRef->verticesLength = (int) (vertices.length / 3);
+	meshRef->normalsLength = (int) (normals.length / 3);
+	meshRef->trianglesLength = (int) (indices.length / 3);
+	meshRef->vertices = vertices.data;
+	meshRef->normals = normals.data;
+	meshRef->indices = indices.data;
+	meshRef->normalIndices = normalIndices.length > 0 ? normalIndices.data : NULL;
+
+	// PLY normals belong to the vertices, so they share the vertex indices, and so do OBJ normals
+	// numbered like their vertices
+	if (isPly && meshRef->normalsLength == meshRef->verticesLength)
+		meshRef->normalIndices = meshRef->indices;
+	else if (normalIndices.length > 0 && memcmp(normalIndices.data, indices.data, sizeof(uint32_t) * indices.length) == 0) {
+		free(normalIndices.data);
+		meshRef->normalIndices = meshRef->indices;
+	}
+	if (meshRef->normalIndices == NULL || meshRef->normalsLength == 0) {
+		free(normalIndices.data);
+		free(normals.data);
+		meshRef->normalIndices = NULL;
+		meshRef->normals = NULL;
+		meshRef->normalsLength = 0;
+	}
+
+	for (int i = 0; i < meshRef->verticesLength * 3; i++)
+		meshRef->vertices[i] = (float) (meshRef->vertices[i] * scale + positionRef->array[i % 3]);
+
+	if (mesh_build(meshRef) != 0) {
+		fprintf(stderr, "Error: Could not allocate the hierarchy of model '%s'\n", fname);
+		mesh_free(meshRef);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Count the bytes held by a mesh
+ * @param meshRef - The mesh
+ * @return The size of its vertices, normals, indices and hierarchy
+ */
+size_t mesh_memory(MeshData *meshRef) {
+	size_t bytes = sizeof(MeshData);
+	bytes += sizeof(float) * 3 * ((size_t) meshRef->verticesLength + meshRef->normalsLength);
+	bytes += sizeof(uint32_t) * 3 * (size_t) meshRef->trianglesLength;
+	if (meshRef->normalIndices != NULL && meshRef->normalIndices != meshRef->indices)
+		bytes += sizeof(uint32_t) * 3 * (size_t) meshRef->trianglesLength;
+	bytes += sizeof(MeshNode) * (size_t) meshRef->nodesLength;
+	return bytes;
+}
+
+/**
+ * Slab test of a ray against the bounds of a node
+ * @return The distance the ray enters the bounds, INFINITY when it misses them or enters past maxDistance
+ */
+static double mesh_node_entry(MeshNode *nodeRef, V3 *rayOriginRef, V3 *inverseDirectionRef, double maxDistance) {
+	double entry = 0;
+	double exit = maxDistance;
+
+	for (int k = 0; k < 3; k++) {
+		double t0 = (nodeRef->boundsMin[k] - rayOriginRef->array[k]) * inverseDirectionRef->array[k];
+		double t1 = (nodeRef->boundsMax[k] - rayOriginRef->array[k]) * inverseDirectionRef->array[k];
+		entry = fmax(entry, fmin(t0, t1));
+		exit = fmin(exit, fmax(t0, t1));
+	}
+	return entry <= exit ? entry : INFINITY;
+}
+
+/**
+ * Closest hit of a ray with a mesh, each triangle is tested with the Moller-Trumbore test with every
+ * condition combined into one branch
+ * @param meshRef - The mesh
+ * @param rayOriginRef - The ray origin
+ * @param rayDirectionRef - The ray direction
+ * @param ignoreTriangle - A triangle never hit, the one a secondary ray starts on, or -1
+ * @param hitRef - Set to the triangle hit, may be NULL
+ * @return The hit distance along the ray, if positive. Otherwise INFINITY.
+ */
+double intersect_mesh(MeshData *meshRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreTriangle, MeshHit *hitRef) {
+	V3 inverseDirection;
+	int stack[MESH_MAX_DEPTH];
+	int stackLength = 0;
+	int node = 0;
+	double closest = INFINITY;
+	MeshHit hit = {-1, 0, 0};
+
+	for (int k = 0; k < 3; k++)
+		inverseDirection.array[k] = 1 / rayDirectionRef->array[k];
+	if (mesh_node_entry(&meshRef->nodes[0], rayOriginRef, &inverseDirection, closest) == INFINITY)
+		return INFINITY;
+
+	while (1) {
+		MeshNode *nodeRef = &meshRef->nodes[node];
+		if (nodeRef->count > 0) {
+			for (int i = nodeRef->first; i < nodeRef->first + nodeRef->count; i++) {
+				float *v0 = &meshRef->vertices[meshRef->indices[i*3] * 3];
+				float *v1 = &meshRef->vertices[meshRef->indices[i*3 + 1] * 3];
+				float *v2 = &meshRef->vertices[meshRef->indices[i*3 + 2] * 3];
+				V3 edge1 = {{v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]}};
+				V3 edge2 = {{v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]}};
+				V3 toOrigin = {{rayOriginRef->array[0] - v0[0], rayOriginRef->array[1] - v0[1], rayOriginRef->array[2] - v0[2]}};
+				V3 p, q;
+				double det, u, v, t;
+
+				STATS_INC(triangleTests);
+				v3_cross(rayDirectionRef, &edge2, &p);
+				v3_dot(&edge1, &p, &det);
+				double inverseDet = 1 / det;
+				v3_dot(&toOrigin, &p, &u);
+				u *= inverseDet;
+				v3_cross(&toOrigin, &edge1, &q);
+				v3_dot(rayDirectionRef, &q, &v);
+				v *= inverseDet;
+				v3_dot(&edge2, &q, &t);
+				t *= inverseDet;
+
+				// A parallel ray gets an infinite or NaN inverse determinant which fails these compares
+				if ((u >= 0) & (v >= 0) & (u + v <= 1) & (t > MESH_MIN_DISTANCE) & (t < closest) & (i != ignoreTriangle)) {
+					closest = t;
+					hit.triangle = i;
+					hit.u = u;
+					hit.v = v;
+				}
+			}
+		}
+		else {
+			// Visit the nearer child first so the farther one is often skipped
+			int left = node + 1;
+			int right = nodeRef->first;
+			double leftEntry = mesh_node_entry(&meshRef->nodes[left], rayOriginRef, &inverseDirection, closest);
+			double rightEntry = mesh_node_entry(&meshRef->nodes[right], rayOriginRef, &inverseDirection, closest);
+			if (leftEntry > rightEntry) {
+				int swap = left;
+				double swapEntry = leftEntry;
+				left = right;
+				right = swap;
+				leftEntry = rightEntry;
+				rightEntry = swapEntry;
+			}
+			if (leftEntry != INFINITY) {
+				if (rightEntry != INFINITY)
+					stack[stackLength++] = right;
+				node = left;
+				continue;
+			}
+		}
+
+		if (stackLength == 0)
+			break;
+		node = stack[--stackLength];
+	}
+
+	if (hitRef != NULL)
+		*hitRef = hit;
+	return closest;
+}
+
+/**
+ * Computes the normal of a mesh at a hit, interpolated from the vertex normals when the model has
+ * them and the face normal from the winding order otherwise
+ * @param meshRef - The mesh
+ * @param hitRef - The triangle hit and where
+ * @param normalRef - The unit normal found
+ */
+void mesh_normal(MeshData *meshRef, MeshHit *hitRef, V3 *normalRef) {
+	int triangle = hitRef->triangle;
+
+	if (meshRef->normals != NULL) {
+		double w = 1 - hitRef->u - hitRef->v;
+		float *n0 = &meshRef->normals[meshRef->normalIndices[triangle*3] * 3];
+		float *n1 = &meshRef->normals[meshRef->normalIndices[triangle*3 + 1] * 3];
+		float *n2 = &meshRef->normals[meshRef->normalIndices[triangle*3 + 2] * 3];
+		for (int k = 0; k < 3; k++)
+			normalRef->array[k] = w * n0[k] + hitRef->u * n1[k] + hitRef->v * n2[k];
+	}
+	else {
+		float *v0 = &meshRef->vertices[meshRef->indices[triangle*3] * 3];
+		float *v1 = &meshRef->vertices[meshRef->indices[triangle*3 + 1] * 3];
+		float *v2 = &meshRef->vertices[meshRef->indices[triangle*3 + 2] * 3];
+		V3 edge1 = {{v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]}};
+		V3 edge2 = {{v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]}};
+		v3_cross(&edge1, &edge2, normalRef);
+	}
+	v3_normalize(normalRef, normalRef);
+}
+
+/**
+ * Release the buffers of a mesh
+ * @param meshRef - The mesh to free
+ */
+void mesh_free(MeshData *meshRef) {
+	if (meshRef->normalIndices != meshRef->indices)
+		free(meshRef->normalIndices);
+	free(meshRef->indices);
+	free(meshRef->vertices);
+	free(meshRef->normals);
+	free(meshRef->nodes);
+	free(meshRef->fname);
+	meshRef->fname = NULL;
+	meshRef->indices = NULL;
+	meshRef->normalIndices = NULL;
+	meshRef->vertices = NULL;
+	meshRef->normals = NULL;
+	meshRef->nodes = NULL;
+}
+
+/**
+ * Release the meshes of every mesh primitive of a scene
+ * @param sceneRef - The scene whose meshes are freed
+ */
+void scene_free_meshes(Scene *sceneRef) {
+	for (int i = 0; i < sceneRef->primitivesLength; i++) {
+		Primitive *primitiveRef = sceneRef->primitives[i];
+		if (primitiveRef->type == MESH_T && primitiveRef->data.mesh.dataRef != NULL) {
+			mesh_free(primitiveRef->data.mesh.dataRef);
+			free(primitiveRef->data.mesh.dataRef);
+			primitiveRef->data.mesh.dataRef = NULL;
+		}
+	}
+}
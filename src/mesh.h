@@ -0,0 +1,66 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_MESH_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_MESH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "3dmath.h"
+
+#define MESH_LEAF_TRIANGLES 4
+#define MESH_MAX_DEPTH 64
+#define MESH_MIN_DISTANCE 1e-7
+
+typedef struct Scene Scene;
+
+/**
+ * Mesh Node - a node of the bounding volume hierarchy of a mesh, a leaf holds count triangles starting
+ * at first while an inner node has count 0, its left child right after it and its right child at first
+ */
+typedef struct MeshNode {
+	float boundsMin[3];
+	float boundsMax[3];
+	int32_t first;
+	int32_t count;
+} MeshNode;
+
+/**
+ * Mesh Data - the model file of a triangle mesh and its shared buffers, triangles are three indices into the vertices
+ * and, when the model has normals, three indices into the normals. Normal indices equal to the vertex
+ * indices share the same buffer.
+ */
+typedef struct MeshData {
+	char *fname;
+	int verticesLength;
+	int normalsLength;
+	int trianglesLength;
+	int nodesLength;
+	float *vertices;
+	float *normals;
+	uint32_t *indices;
+	uint32_t *normalIndices;
+	MeshNode *nodes;
+} MeshData;
+
+/**
+ * The triangle a ray hit and the barycentric coordinates of the hit on it
+ */
+typedef struct MeshHit {
+	int triangle;
+	double u;
+	double v;
+} MeshHit;
+
+// The mesh triangle found by the last closest hit search of the calling thread
+extern __thread MeshHit threadMeshHit;
+
+int load_mesh(char *fname, V3 *positionRef, double scale, MeshData *meshRef);
+size_t mesh_memory(MeshData *meshRef);
+double intersect_mesh(MeshData *meshRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreTriangle, MeshHit *hitRef);
+void mesh_normal(MeshData *meshRef, MeshHit *hitRef, V3 *normalRef);
+void mesh_free(MeshData *meshRef);
+void scene_free_meshes(Scene *sceneRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_MESH_H
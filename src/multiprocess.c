@@ -0,0 +1,317 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "multiprocess.h"
+#include "constants.h"
+#include "stats.h"
+#include "trace.h"
+#include "checkpoint.h"
+
+/**
+ * Allocate zeroed memory which stays shared with processes forked after this call
+ * @param size - The number of bytes to allocate
+ * @return The memory, or NULL if it could not be allocated
+ */
+static void *shared_alloc(size_t size) {
+	void *memoryRef = mmap(NULL, size > 0 ? size : 1, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	return memoryRef == MAP_FAILED ? NULL : memoryRef;
+}
+
+/**
+ * Release memory from shared_alloc, NULL is ignored
+ */
+static void shared_free(void *memoryRef, size_t size) {
+	if (memoryRef != NULL)
+		munmap(memoryRef, size > 0 ? size : 1);
+}
+
+/**
+ * Allocate a queue and its arrays in shared memory, the queue starts out empty
+ * @param tilesLength - The number of tiles in the render
+ * @param processes - The number of worker processes
+ * @return The queue, or NULL if it could not be allocated
+ */
+static TileQueue *queue_create(int tilesLength, int processes) {
+	TileQueue *queueRef = shared_alloc(sizeof(TileQueue));
+	if (queueRef == NULL)
+		return NULL;
+
+	queueRef->capacity = tilesLength;
+	queueRef->tiles = shared_alloc(sizeof(int) * tilesLength);
+	queueRef->owners = shared_alloc(sizeof(atomic_int) * tilesLength);
+	queueRef->done = shared_alloc(sizeof(atomic_int) * tilesLength);
+	queueRef->startUs = shared_alloc(sizeof(double) * tilesLength);
+	queueRef->endUs = shared_alloc(sizeof(double) * tilesLength);
+	queueRef->workerStats = shared_alloc(sizeof(RenderStats) * processes);
+	atomic_init(&queueRef->head, 0);
+	atomic_init(&queueRef->tail, 0);
+	return queueRef;
+}
+
+/**
+ * Release a queue from queue_create, NULL is ignored
+ */
+static void queue_free(TileQueue *queueRef, int tilesLength, int processes) {
+	if (queueRef == NULL)
+		return;
+	shared_free(queueRef->tiles, sizeof(int) * tilesLength);
+	shared_free(queueRef->owners, sizeof(atomic_int) * tilesLength);
+	shared_free(queueRef->done, sizeof(atomic_int) * tilesLength);
+	shared_free(queueRef->startUs, sizeof(double) * tilesLength);
+	shared_free(queueRef->endUs, sizeof(double) * tilesLength);
+	shared_free(queueRef->workerStats, sizeof(RenderStats) * processes);
+	shared_free(queueRef, sizeof(TileQueue));
+}
+
+/**
+ * Claim the next tile in the queue
+ * @return The tile index, or -1 if the queue is empty
+ */
+static int queue_pop(TileQueue *queueRef) {
+	int head = atomic_load_explicit(&queueRef->head, memory_order_relaxed);
+	do {
+		if (head >= atomic_load_explicit(&queueRef->tail, memory_order_acquire))
+			return -1;
+	} while (!atomic_compare_exchange_weak_explicit(&queueRef->head, &head, head + 1,
+													memory_order_relaxed, memory_order_relaxed));
+	return queueRef->tiles[head % queueRef->capacity];
+}
+
+/**
+ * Add a tile to the queue, only the parent process may push
+ */
+static void queue_push(TileQueue *queueRef, int tileIndex) {
+	int tail = atomic_load_explicit(&queueRef->tail, memory_order_relaxed);
+	queueRef->tiles[tail % queueRef->capacity] = tileIndex;
+	atomic_store_explicit(&queueRef->tail, tail + 1, memory_order_release);
+}
+
+/**
+ * Put every unfinished tile back in the queue
+ * @param queueRef - The queue
+ * @param tilesLength - The number of tiles in the render
+ * @param owner - Only requeue tiles claimed by this worker, or -1 for every unfinished tile. Only pass -1
+ * when no worker is running and the queue is empty
+ * @return The number of tiles requeued
+ */
+static int queue_requeue_unfinished(TileQueue *queueRef, int tilesLength, int owner) {
+	int requeued = 0;
+	for (int i = 0; i < tilesLength; i++) {
+		if (atomic_load(&queueRef->done[i]) || (owner >= 0 && atomic_load(&queueRef->owners[i]) != owner))
+			continue;
+		atomic_store(&queueRef->owners[i], -1);
+		queue_push(queueRef, i);
+		requeued++;
+	}
+	return requeued;
+}
+
+/**
+ * The body of a worker process, claims tiles until there are none left then publishes its counters
+ */
+static void process_worker(RenderContext *contextRef, TileQueue *queueRef, int index) {
+	TraceRecorder *traceRef = contextRef->optionsRef->traceRef;
+	int tileIndex;
+
+	stats_reset_thread();
+	while ((tileIndex = queue_pop(queueRef)) >= 0) {
+		atomic_store(&queueRef->owners[tileIndex], index);
+		queueRef->startUs[tileIndex] = trace_now(traceRef);
+		render_tile(contextRef, tileIndex);
+		queueRef->endUs[tileIndex] = trace_now(traceRef);
+		atomic_store_explicit(&queueRef->done[tileIndex], TRUE, memory_order_release);
+	}
+	stats_merge(&queueRef->workerStats[index], &threadStats);
+}
+
+/**
+ * Fork a worker process, the checkpoint thread is held idle across the fork so the worker never
+ * inherits a lock it took
+ * @return The pid of the worker, or -1 if it could not be started
+ */
+static pid_t spawn_worker(RenderContext *contextRef, TileQueue *queueRef, int index) {
+	Checkpoint *checkpointRef = contextRef->optionsRef->checkpointRef;
+
+	checkpoint_hold(checkpointRef);
+	pid_t pid = fork();
+	if (pid == 0) {
+		process_worker(contextRef, queueRef, index);
+		_exit(0);
+	}
+	checkpoint_release(checkpointRef);
+	return pid;
+}
+
+/**
+ * Runs forked worker processes over every tile of a prepared render context. The scene is shared
+ * copy-on-write, tiles are handed out through a queue in shared memory and rendered into a shared
+ * framebuffer. When a worker dies the tiles it had claimed are requeued and a replacement is started.
+ * @param contextRef - The render to run
+ * @param processes - The number of worker processes
+ * @return 0 if success, otherwise a failure occurred
+ */
+int render_context_run_processes(RenderContext *contextRef, int processes) {
+	int tilesLength = contextRef->tilesLength;
+	size_t pixels = (size_t) contextRef->imageWidth * contextRef->imageHeight;
+	Costmap *costmapRef = contextRef->costMetric != COST_NONE_T ? contextRef->optionsRef->costmapRef : NULL;
+	TraceRecorder *traceRef = contextRef->optionsRef->traceRef;
+	int result = 0;
+
+	if (processes < 1)
+		processes = 1;
+	if (processes > tilesLength)
+		processes = tilesLength;
+
+	TileQueue *queueRef = queue_create(tilesLength, processes);
+	RGBApixel *sharedPixmap = shared_alloc(sizeof(RGBApixel) * pixels);
+	float *sharedCosts = costmapRef != NULL ? shared_alloc(sizeof(float) * pixels) : NULL;
+	pid_t *pids = malloc(sizeof(pid_t) * processes);
+	if (queueRef == NULL || queueRef->tiles == NULL || queueRef->owners == NULL || queueRef->done == NULL ||
+		queueRef->startUs == NULL || queueRef->endUs == NULL || queueRef->workerStats == NULL ||
+		sharedPixmap == NULL || (costmapRef != NULL && sharedCosts == NULL) || pids == NULL) {
+		fprintf(stderr, "Error: Could not allocate the shared framebuffer\n");
+		free(pids);
+		queue_free(queueRef, tilesLength, processes);
+		shared_free(sharedPixmap, sizeof(RGBApixel) * pixels);
+		shared_free(sharedCosts, sizeof(float) * pixels);
+		return 1;
+	}
+	// Tiles restored from a checkpoint are never queued
+	for (int i = 0; i < tilesLength; i++) {
+		int done = contextRef->tilesDone != NULL && atomic_load(&contextRef->tilesDone[i]);
+		atomic_init(&queueRef->owners[i], -1);
+		atomic_init(&queueRef->done[i], done);
+	}
+	for (int i = 0; i < tilesLength; i++) {
+		int tileIndex = contextRef->tileOrder != NULL ? contextRef->tileOrder[i] : i;
+		if (!atomic_load(&queueRef->done[tileIndex]))
+			queue_push(queueRef, tileIndex);
+	}
+
+	// Workers render into the shared buffers, the results are copied back once they are all done
+	RGBApixel *framebuffer = contextRef->framebuffer;
+	memcpy(sharedPixmap, framebuffer, sizeof(RGBApixel) * pixels);
+	contextRef->framebuffer = sharedPixmap;
+	float *costsRef = NULL;
+	if (costmapRef != NULL) {
+		costsRef = costmapRef->values;
+		costmapRef->values = sharedCosts;
+	}
+
+	int live = 0;
+	int restarts = 0;
+	for (int i = 0; i < processes; i++) {
+		pids[i] = spawn_worker(contextRef, queueRef, i);
+		if (pids[i] < 0)
+			fprintf(stderr, "Warning: Could not start render process %d\n", i);
+		else
+			live++;
+	}
+
+	// Started once the first workers are forked, replacements are forked while it is held
+	Checkpoint *checkpointRef = contextRef->optionsRef->checkpointRef;
+	if (checkpointRef != NULL)
+		checkpoint_start(checkpointRef, contextRef, sharedPixmap, queueRef->done);
+
+	while (TRUE) {
+		if (live == 0) {
+			// A worker can die between claiming a tile and recording itself as its owner, sweep those up
+			int head = atomic_load(&queueRef->head);
+			if (head < atomic_load(&queueRef->tail) || restarts >= MAX_WORKER_RESTARTS ||
+				queue_requeue_unfinished(queueRef, tilesLength, -1) == 0)
+				break;
+			restarts++;
+			if ((pids[0] = spawn_worker(contextRef, queueRef, 0)) < 0)
+				break;
+			live++;
+		}
+
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		int index = -1;
+		for (int i = 0; i < processes; i++) {
+			if (pids[i] == pid)
+				index = i;
+		}
+		if (index < 0)
+			continue;
+		pids[index] = -1;
+		live--;
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+			continue;
+
+		int requeued = queue_requeue_unfinished(queueRef, tilesLength, index);
+		if (WIFSIGNALED(status))
+			fprintf(stderr, "Warning: Render process %d was killed by signal %d, requeued %d tile(s)\n",
+					index, WTERMSIG(status), requeued);
+		else
+			fprintf(stderr, "Warning: Render process %d exited with status %d, requeued %d tile(s)\n",
+					index, WEXITSTATUS(status), requeued);
+
+		if (restarts < MAX_WORKER_RESTARTS) {
+			restarts++;
+			if ((pids[index] = spawn_worker(contextRef, queueRef, index)) >= 0)
+				live++;
+		}
+	}
+
+	if (checkpointRef != NULL)
+		checkpoint_stop(checkpointRef);
+
+	int missing = 0;
+	for (int i = 0; i < tilesLength; i++) {
+		if (!atomic_load(&queueRef->done[i]))
+			missing++;
+	}
+	if (missing > 0) {
+		fprintf(stderr, "Error: %d tile(s) could not be rendered after %d worker restarts\n", missing, restarts);
+		result = 1;
+	}
+
+	memcpy(framebuffer, sharedPixmap, sizeof(RGBApixel) * pixels);
+	contextRef->framebuffer = framebuffer;
+	if (costmapRef != NULL) {
+		memcpy(costsRef, sharedCosts, sizeof(float) * pixels);
+		costmapRef->values = costsRef;
+	}
+
+	if (contextRef->optionsRef->statsRef != NULL) {
+		for (int i = 0; i < processes; i++)
+			stats_merge(contextRef->optionsRef->statsRef, &queueRef->workerStats[i]);
+	}
+
+	// Worker processes can not append to the recorder, so their tile spans are recorded here instead
+	if (traceRef != NULL) {
+		TraceBuffer **buffers = malloc(sizeof(TraceBuffer *) * processes);
+		for (int i = 0; i < processes; i++)
+			buffers[i] = trace_thread_buffer(traceRef, "render process", i);
+		for (int i = 0; i < tilesLength; i++) {
+			int owner = atomic_load(&queueRef->owners[i]);
+			if (atomic_load(&queueRef->done[i]) && owner >= 0)
+				trace_span_xy(buffers[owner], "tile", queueRef->startUs[i], queueRef->endUs[i],
+							  i % contextRef->tilesX, i / contextRef->tilesX);
+		}
+		free(buffers);
+	}
+
+	free(pids);
+	queue_free(queueRef, tilesLength, processes);
+	shared_free(sharedPixmap, sizeof(RGBApixel) * pixels);
+	shared_free(sharedCosts, sizeof(float) * pixels);
+	return result;
+}
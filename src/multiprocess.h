@@ -0,0 +1,31 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_MULTIPROCESS_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_MULTIPROCESS_H
+
+#include <stdatomic.h>
+#include "raycaster.h"
+
+#define MAX_WORKER_RESTARTS 16
+
+/**
+ * Tile Queue - a ring of tile indices in shared memory. Workers pop from the head, only the parent
+ * pushes to the tail, so a tile is never in the queue more than once and it never overflows.
+ */
+typedef struct TileQueue {
+	atomic_int head;
+	atomic_int tail;
+	int capacity;
+	int *tiles;
+	atomic_int *owners;
+	atomic_int *done;
+	double *startUs;
+	double *endUs;
+	RenderStats *workerStats;
+} TileQueue;
+
+int render_context_run_processes(RenderContext *contextRef, int processes);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_MULTIPROCESS_H
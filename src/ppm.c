@@ -4,7 +4,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include "imaging.h"
+#include "ppm.h"
+#include "constants.h"
+#include "kernels.h"
 
 /**
  * Write the specified image to a file using PPM P6 format
@@ -13,36 +18,202 @@
  * @return 0 if success, otherwise a failure occurred
  */
 int save_ppm_p6_image(Image *imageRef, char *fname) {
+	return save_ppm_p6_image_region(imageRef, NULL, fname);
+}
+
+/**
+ * Write the specified image to a file using PPM P6 format, recording where it belongs in a larger
+ * frame with a "# region <x> <y> <frame_width> <frame_height>" header comment
+ * @param imageRef - The image to write
+ * @param regionRef - The region of the frame the image covers, or NULL to write a plain image
+ * @param fname - The output filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int save_ppm_p6_image_region(Image *imageRef, ImageRegion *regionRef, char *fname) {
 	FILE* fp = fopen(fname, "w");
 	int i;
-	int j;
-	// a small buffer to hold our values for the pixel to be written
-	char buffer[3];
-	if (fp) {
+	// a buffer to hold one row of pixels to be written
+	uint8_t *buffer = malloc((size_t) imageRef->width * 3 + 1);
+	if (fp && buffer) {
 		// write the magic number
 		fprintf(fp, "P6\n");
+		// write the placement in the full frame
+		if (regionRef != NULL)
+			fprintf(fp, "# region %i %i %i %i\n", regionRef->x, regionRef->y, regionRef->frameWidth, regionRef->frameHeight);
 		// write the width and height
 		fprintf(fp, "%i %i\n", imageRef->width, imageRef->height);
 		// write the max color
 		fprintf(fp, "255\n");
 		for (i=0; i<imageRef->height; i++) {
-			for (j=0; j<imageRef->width; j++) {
-				// grab the correct pixel
-				RGBApixel pixel = imageRef->pixmapRef[i*imageRef->width + j];
-				// copy the rgb values to our buffer
-				buffer[0] = pixel.r;
-				buffer[1] = pixel.g;
-				buffer[2] = pixel.b;
-				// write the pixel to the file
-				fwrite(buffer, sizeof(uint8_t), 3, fp);
-			}
+			// drop the alpha channel of the row and write it to the file
+			kernels.pack_rgb(&imageRef->pixmapRef[(size_t) i*imageRef->width], buffer, imageRef->width);
+			fwrite(buffer, sizeof(uint8_t), (size_t) imageRef->width * 3, fp);
 		}
 		// close the file
+		free(buffer);
 		fclose(fp);
 		return 0;
 	}
 	else {
+		if (fp)
+			fclose(fp);
+		free(buffer);
 		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
 		return 1;
 	}
+}
+
+/**
+ * Write the specified costmap to a file using the grayscale PFM (Pf) format
+ * @param costmapRef - The costmap to write
+ * @param fname - The output filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int save_pfm_image(Costmap *costmapRef, char *fname) {
+	FILE* fp = fopen(fname, "wb");
+	int i;
+	uint32_t endianCheck = 1;
+	if (fp) {
+		// write the magic number
+		fprintf(fp, "Pf\n");
+		// write the width and height
+		fprintf(fp, "%i %i\n", costmapRef->width, costmapRef->height);
+		// write the scale, a negative scale marks the data as little endian
+		fprintf(fp, "%s\n", *(uint8_t *) &endianCheck == 1 ? "-1.0" : "1.0");
+		// PFM stores the rows from bottom to top
+		for (i=costmapRef->height - 1; i>=0; i--) {
+			fwrite(&costmapRef->values[i*costmapRef->width], sizeof(float), costmapRef->width, fp);
+		}
+		// close the file
+		fclose(fp);
+		return 0;
+	}
+	else {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+}
+
+/**
+ * Read a number from a PPM header, skipping whitespace and comments
+ * @param fp - The file handle to read from
+ * @param result - The number read
+ * @param regionRef - Filled in from a region comment if one is skipped, may be NULL
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int read_ppm_header_value(FILE *fp, int *result, ImageRegion *regionRef) {
+	char comment[128];
+	ImageRegion region = {0};
+	int c;
+	while (TRUE) {
+		c = fgetc(fp);
+		if (c == '#') {
+			// read the comment until the end of the line, only the start of long comments is kept
+			int length = 0;
+			while (c != '\n' && c != EOF) {
+				if (length < (int) sizeof(comment) - 1)
+					comment[length++] = (char) c;
+				c = fgetc(fp);
+			}
+			comment[length] = '\0';
+			if (regionRef != NULL && sscanf(comment, "# region %d %d %d %d", &region.x, &region.y,
+											&region.frameWidth, &region.frameHeight) == 4)
+				*regionRef = region;
+		}
+		else if (!isspace(c)) {
+			break;
+		}
+	}
+	if (!isdigit(c))
+		return 1;
+
+	*result = 0;
+	while (isdigit(c)) {
+		*result = *result * 10 + (c - '0');
+		c = fgetc(fp);
+	}
+	// c is the single whitespace character which ends the value
+	return isspace(c) ? 0 : 1;
+}
+
+/**
+ * Read the header of a PPM P6 image with a max color of 255, leaving the file positioned at the first pixel
+ * @param fp - The file handle to read from
+ * @param fname - The filename, used for error messages
+ * @param widthRef - The width read
+ * @param heightRef - The height read
+ * @param regionRef - Filled in from a region comment, the region is left with a width of 0 when there is none.
+ * May be NULL
+ * @return 0 if success, otherwise a failure occurred
+ */
+int read_ppm_p6_header(FILE *fp, char *fname, int *widthRef, int *heightRef, ImageRegion *regionRef) {
+	int maxColor;
+	char magic[2];
+
+	if (regionRef != NULL)
+		memset(regionRef, 0, sizeof(ImageRegion));
+
+	if (fread(magic, 1, 2, fp) != 2 || magic[0] != 'P' || magic[1] != '6' ||
+		read_ppm_header_value(fp, widthRef, regionRef) != 0 || read_ppm_header_value(fp, heightRef, regionRef) != 0 ||
+		read_ppm_header_value(fp, &maxColor, regionRef) != 0 || *widthRef <= 0 || *heightRef <= 0) {
+		fprintf(stderr, "Error: File '%s' is not a PPM P6 image\n", fname);
+		return 1;
+	}
+	if (maxColor != 255) {
+		fprintf(stderr, "Error: File '%s' must have a max color of 255\n", fname);
+		return 1;
+	}
+
+	if (regionRef != NULL && regionRef->frameWidth > 0) {
+		regionRef->width = *widthRef;
+		regionRef->height = *heightRef;
+	}
+	return 0;
+}
+
+/**
+ * Read an image from a file in PPM P6 format with a max color of 255
+ * @param imageRef - The image to read into, its pixmap is allocated here
+ * @param fname - The input filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int load_ppm_p6_image(Image *imageRef, char *fname) {
+	FILE* fp = fopen(fname, "rb");
+	int width, height;
+	uint8_t *buffer;
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for reading\n", fname);
+		return 1;
+	}
+
+	if (read_ppm_p6_header(fp, fname, &width, &height, NULL) != 0) {
+		fclose(fp);
+		return 1;
+	}
+
+	imageRef->width = (uint32_t) width;
+	imageRef->height = (uint32_t) height;
+	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * width * height);
+	buffer = malloc((size_t) width * 3);
+
+	for (int i = 0; i < height; i++) {
+		if (fread(buffer, sizeof(uint8_t), (size_t) width * 3, fp) != (size_t) width * 3) {
+			fprintf(stderr, "Error: File '%s' ended before all of the pixels were read\n", fname);
+			free(buffer);
+			fclose(fp);
+			return 1;
+		}
+		for (int j = 0; j < width; j++) {
+			RGBApixel *pixel = &imageRef->pixmapRef[i*width + j];
+			pixel->r = buffer[j*3];
+			pixel->g = buffer[j*3 + 1];
+			pixel->b = buffer[j*3 + 2];
+			pixel->a = 255;
+		}
+	}
+
+	free(buffer);
+	fclose(fp);
+	return 0;
 }
\ No newline at end of file
@@ -5,8 +5,13 @@
 #ifndef CS430_PROJECT_2_BASIC_RAYCASTER_PPM_H
 #define CS430_PROJECT_2_BASIC_RAYCASTER_PPM_H
 
+#include <stdio.h>
 #include "imaging.h"
 
 int save_ppm_p6_image(Image *imageRef, char *fname);
+int save_ppm_p6_image_region(Image *imageRef, ImageRegion *regionRef, char *fname);
+int read_ppm_p6_header(FILE *fp, char *fname, int *widthRef, int *heightRef, ImageRegion *regionRef);
+int save_pfm_image(Costmap *costmapRef, char *fname);
+int load_ppm_p6_image(Image *imageRef, char *fname);
 
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_PPM_H
@@ -4,56 +4,1081 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include "3dmath.h"
 #include "raycaster.h"
 #include "imaging.h"
+#include "constants.h"
+#include "stats.h"
+#include "trace.h"
+#include "multiprocess.h"
+#include "checkpoint.h"
+#include "gbuffer.h"
+#include "lighttree.h"
+#include "shadowmap.h"
+#include "mesh.h"
+#include "kernels.h"
+#include "wavefront.h"
+#include "traversal.h"
+#include "frustum.h"
+#include "tilelights.h"
 
-#define MAX_RECURSE_DEPTH 100
+/**
+ * Set the render options to their defaults
+ * @param optionsRef - The options to initialize
+ */
+void render_options_init(RenderOptions *optionsRef) {
+	optionsRef->costMetric = COST_NONE_T;
+	optionsRef->costmapRef = NULL;
+	optionsRef->threads = 1;
+	optionsRef->processes = 0;
+	optionsRef->tileSize = DEFAULT_TILE_SIZE;
+	optionsRef->sparseStep = 1;
+	optionsRef->region.width = 0;
+	optionsRef->region.height = 0;
+	optionsRef->statsRef = NULL;
+	optionsRef->traceRef = NULL;
+	optionsRef->checkpointRef = NULL;
+	optionsRef->deadline = 0;
+	optionsRef->qualityRef = NULL;
+	optionsRef->gbufferMode = GBUFFER_NONE_T;
+	optionsRef->gbufferRef = NULL;
+	optionsRef->lightSamples = 0;
+	optionsRef->wavefront = FALSE;
+	optionsRef->traversal = TRAVERSAL_HILBERT_T;
+	optionsRef->progress = NULL;
+	optionsRef->progressDataRef = NULL;
+}
 
 /**
- * Allocates space in the imageRef specified for an image of the selected imageWidth and imageHeight.
- * Then raycasts a specified scene into the specified image.
+ * The recursion limit of the calling thread, lowered by the cheap passes of a render with a time budget
+ */
+static __thread int threadMaxDepth = MAX_RECURSE_DEPTH;
+
+/**
+ * The number of lights picked for each shading point by the calling thread, 0 uses every light
+ */
+static __thread int threadLightSamples = 0;
+
+/**
+ * The primitives the camera rays of the tile being rendered by the calling thread can hit, NULL when
+ * camera rays test the whole scene
+ */
+static __thread PrimitivePack *threadCameraPack = NULL;
+
+/**
+ * The lights classified for the camera hits of the tile being shaded by the calling thread, NULL when
+ * every shadow ray of a camera hit tests the whole scene
+ */
+static __thread TileLight *threadCameraLights = NULL;
+
+// The camera hits and light classification of the tile being rendered, reused from tile to tile
+static __thread TileLights threadTileLights;
+
+// Grown to the light count of the scene by thread_light_buffer
+static __thread int *threadLights = NULL;
+static __thread int threadLightsCapacity = 0;
+
+/**
+ * Get the buffer of the calling thread which light indices are gathered into, it is reused by every
+ * shading point since the lights of a point are done before its reflection and refraction rays
+ * @param length - The number of lights it must hold
+ * @return The buffer, or NULL if it could not be grown
+ */
+static int *thread_light_buffer(int length) {
+	if (length > threadLightsCapacity) {
+		int *lights = realloc(threadLights, sizeof(int) * length);
+		if (lights == NULL)
+			return NULL;
+		threadLights = lights;
+		threadLightsCapacity = length;
+	}
+	return threadLights;
+}
+
+// The state, camera hit distance and camera hit primitive of every pixel of a sparse tile, grown as needed
+static __thread uint8_t *threadSparseStates = NULL;
+static __thread double *threadSparseDistances = NULL;
+static __thread Primitive **threadSparseHits = NULL;
+static __thread int threadSparseCapacity = 0;
+
+/**
+ * Make room for the pixels of a sparse tile in the buffers of the calling thread
+ * @param pixels - The number of pixels in the tile
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int thread_sparse_reserve(int pixels) {
+	if (pixels > threadSparseCapacity) {
+		uint8_t *states = realloc(threadSparseStates, sizeof(uint8_t) * pixels);
+		if (states != NULL)
+			threadSparseStates = states;
+		double *distances = realloc(threadSparseDistances, sizeof(double) * pixels);
+		if (distances != NULL)
+			threadSparseDistances = distances;
+		Primitive **hits = realloc(threadSparseHits, sizeof(Primitive *) * pixels);
+		if (hits != NULL)
+			threadSparseHits = hits;
+		if (states == NULL || distances == NULL || hits == NULL)
+			return 1;
+		threadSparseCapacity = pixels;
+	}
+	return 0;
+}
+
+/**
+ * Compare two light indices for qsort
+ */
+static int compare_light_index(const void *a, const void *b) {
+	return *(const int *) a - *(const int *) b;
+}
+
+/**
+ * Seed the light picks of a shading point from its position, so a render picks the same lights no
+ * matter how its pixels are split over threads, processes or regions
+ */
+static uint64_t light_sample_seed(V3 *positionRef, int depth) {
+	uint64_t hash = 14695981039346656037ULL ^ (uint64_t) depth;
+	const uint8_t *bytes = (const uint8_t *) positionRef->array;
+	for (size_t i = 0; i < sizeof(positionRef->array); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * The passes of a render with a time budget, from cheapest to the full quality render
+ */
+static const struct {
+	const char *name;
+	int sampleStep;
+	int maxDepth;
+} renderLevels[] = {
+	{"coarse", 4, 0},
+	{"preview", 1, 1},
+	{"full", 1, MAX_RECURSE_DEPTH}
+};
+
+#define RENDER_LEVELS ((int) (sizeof(renderLevels) / sizeof(renderLevels[0])))
+
+/**
+ * Read the monotonic clock in seconds
+ */
+static double monotonic_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Set once the deadline passes in the middle of a tile, the tile is then left as far as it was refined
+static __thread int threadTileAbandoned = FALSE;
+
+/**
+ * Check the deadline of the render while a tile is refined, a render without one is never abandoned.
+ * The coarse pass already filled every pixel, so a tile can be left part way through a refinement.
+ * @param contextRef - The shared state of the render
+ * @return TRUE if the tile being rendered should be left as it is
+ */
+static int tile_abandoned(RenderContext *contextRef) {
+	if (contextRef->deadline > 0 && monotonic_seconds() >= contextRef->deadline)
+		threadTileAbandoned = TRUE;
+	return threadTileAbandoned;
+}
+
+/**
+ * Read the current value of the selected per-pixel cost metric
+ * @param metric - The metric to read
+ * @return The current value, only differences between two reads are meaningful
+ */
+static double read_cost(CostMetric_t metric) {
+	struct timespec ts;
+	switch (metric) {
+		case COST_RAYS_T:
+			return stats_total_rays(&threadStats);
+		case COST_TESTS_T:
+			return stats_total_tests(&threadStats);
+		case COST_TIME_T:
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			return ts.tv_sec * 1e9 + ts.tv_nsec;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * Prepares the shared state of a render, allocating the output image and costmap. When a region
+ * is set in the options only that part of the frame is rendered and the image is the size of the region.
+ * @param contextRef - The context to populate
  * @param sceneRef - The input scene to render
  * @param imageRef - The output image to write to
- * @param imageWidth - The height of the output image
- * @param imageHeight - The width of the output image
+ * @param frameWidth - The width of the full frame
+ * @param frameHeight - The height of the full frame
+ * @param optionsRef - The render options
  * @return 0 if success, otherwise a failure occurred
  */
-int raycast(Scene *sceneRef, Image* imageRef, int imageWidth, int imageHeight) {
+int render_context_init(RenderContext *contextRef, Scene *sceneRef, Image *imageRef, int frameWidth, int frameHeight, RenderOptions *optionsRef) {
+	ImageRegion *regionRef = &optionsRef->region;
+	int imageWidth = frameWidth;
+	int imageHeight = frameHeight;
+
+	contextRef->originX = 0;
+	contextRef->originY = 0;
+	if (regionRef->width > 0 && regionRef->height > 0) {
+		if (regionRef->x < 0 || regionRef->y < 0 ||
+			regionRef->x + regionRef->width > frameWidth || regionRef->y + regionRef->height > frameHeight) {
+			fprintf(stderr, "Error: Region %dx%d+%d+%d is outside of the %dx%d frame\n", regionRef->width,
+					regionRef->height, regionRef->x, regionRef->y, frameWidth, frameHeight);
+			return 1;
+		}
+		contextRef->originX = regionRef->x;
+		contextRef->originY = regionRef->y;
+		imageWidth = regionRef->width;
+		imageHeight = regionRef->height;
+	}
+	regionRef->frameWidth = frameWidth;
+	regionRef->frameHeight = frameHeight;
 
 	imageRef->width = (uint32_t) imageWidth;
 	imageRef->height= (uint32_t) imageHeight;
-	imageRef->pixmapRef = malloc(sizeof(RGBApixel) * imageWidth * imageHeight);
+	// The image itself is only allocated once the framebuffer is linearized into it
+	imageRef->pixmapRef = NULL;
+	contextRef->framebuffer = malloc(sizeof(RGBApixel) * imageWidth * imageHeight);
+	if (contextRef->framebuffer == NULL) {
+		fprintf(stderr, "Error: Could not allocate an image of %dx%d pixels\n", imageWidth, imageHeight);
+		return 1;
+	}
+
+	contextRef->costMetric = optionsRef->costmapRef != NULL ? optionsRef->costMetric : COST_NONE_T;
+	if (contextRef->costMetric != COST_NONE_T) {
+		optionsRef->costmapRef->width = (uint32_t) imageWidth;
+		optionsRef->costmapRef->height = (uint32_t) imageHeight;
+		optionsRef->costmapRef->values = calloc((size_t) imageWidth * imageHeight, sizeof(float));
+		if (optionsRef->costmapRef->values == NULL) {
+			fprintf(stderr, "Error: Could not allocate a heatmap of %dx%d pixels\n", imageWidth, imageHeight);
+			return 1;
+		}
+	}
+
+	contextRef->sceneRef = sceneRef;
+	contextRef->imageRef = imageRef;
+	contextRef->optionsRef = optionsRef;
+	contextRef->imageWidth = imageWidth;
+	contextRef->imageHeight = imageHeight;
+	contextRef->frameWidth = frameWidth;
+	contextRef->frameHeight = frameHeight;
+	// Pixel sizes always come from the full frame so that a region's rays match the full render exactly
+	contextRef->pixelWidth = sceneRef->camera.width/frameWidth;
+	contextRef->pixelHeight = sceneRef->camera.height/frameHeight;
+	contextRef->tileSize = optionsRef->tileSize > 0 ? optionsRef->tileSize : DEFAULT_TILE_SIZE;
+	contextRef->tilesX = (imageWidth + contextRef->tileSize - 1) / contextRef->tileSize;
+	contextRef->tilesY = (imageHeight + contextRef->tileSize - 1) / contextRef->tileSize;
+	contextRef->tilesLength = contextRef->tilesX * contextRef->tilesY;
+	// Tiles are handed out and their pixels traced in the order of a curve, scanline order needs neither
+	contextRef->tileOrder = NULL;
+	contextRef->pixelOrder = NULL;
+	if (optionsRef->traversal != TRAVERSAL_SCANLINE_T) {
+		contextRef->tileOrder = traversal_order(optionsRef->traversal, contextRef->tilesX, contextRef->tilesY);
+		contextRef->pixelOrder = traversal_order(optionsRef->traversal, contextRef->tileSize, contextRef->tileSize);
+		if (contextRef->tileOrder == NULL || contextRef->pixelOrder == NULL) {
+			fprintf(stderr, "Error: Could not allocate the traversal order\n");
+			return 1;
+		}
+	}
+	ImageRegion renderedRegion = {contextRef->originX, contextRef->originY, imageWidth, imageHeight, frameWidth, frameHeight};
+	if (optionsRef->gbufferMode == GBUFFER_CAPTURE_T &&
+		gbuffer_alloc(optionsRef->gbufferRef, &renderedRegion, scene_geometry_hash(sceneRef)) != 0)
+		return 1;
+	if (optionsRef->gbufferMode == GBUFFER_RELIGHT_T) {
+		ImageRegion *capturedRef = &optionsRef->gbufferRef->region;
+		if (optionsRef->gbufferRef->geometryHash != scene_geometry_hash(sceneRef)) {
+			fprintf(stderr, "Error: The G-buffer was captured from a scene with a different camera or primitives\n");
+			return 1;
+		}
+		if (memcmp(capturedRef, &renderedRegion, sizeof(ImageRegion)) != 0) {
+			fprintf(stderr, "Error: The G-buffer was captured for the %dx%d region at %d,%d of a %dx%d frame, "
+							"this render is the %dx%d region at %d,%d of a %dx%d frame\n",
+					capturedRef->width, capturedRef->height, capturedRef->x, capturedRef->y, capturedRef->frameWidth,
+					capturedRef->frameHeight, imageWidth, imageHeight, contextRef->originX, contextRef->originY,
+					frameWidth, frameHeight);
+			return 1;
+		}
+	}
+
+	if (tile_bins_build(contextRef) != 0)
+		return 1;
+
+	atomic_init(&contextRef->nextTile, 0);
+	atomic_init(&contextRef->tilesRendered, 0);
+	contextRef->sampleStep = 1;
+	contextRef->sparseStep = optionsRef->sparseStep;
+	contextRef->maxDepth = MAX_RECURSE_DEPTH;
+	contextRef->lightSamples = optionsRef->lightSamples;
+	contextRef->deadline = 0;
+	// Finished tiles are only tracked when something needs to know about them
+	contextRef->tilesDone = NULL;
+	if (optionsRef->checkpointRef != NULL) {
+		contextRef->tilesDone = malloc(sizeof(atomic_int) * contextRef->tilesLength);
+		if (contextRef->tilesDone == NULL) {
+			fprintf(stderr, "Error: Could not allocate the finished tiles of the checkpoint\n");
+			return 1;
+		}
+		for (int i = 0; i < contextRef->tilesLength; i++)
+			atomic_init(&contextRef->tilesDone[i], FALSE);
+	}
+	pthread_mutex_init(&contextRef->statsLock, NULL);
+
+	return 0;
+}
+
+/**
+ * Raycasts part of a tile with one ray for each sampleStep x sampleStep block, the ray through the
+ * middle of a block colors all of its pixels
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ */
+static void render_tile_coarse(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	Scene *sceneRef = contextRef->sceneRef;
+	RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+	int imageWidth = contextRef->imageWidth;
+	int tileWidth = tileEndX - tileX;
+	int step = contextRef->sampleStep;
+	V3 cameraPos = {{0, 0, 0}};
+	V3 rayDirection = {{0, 0, 0}};
+	V3 point = {{0, 0, 1}};
+	RGBAColor colorFound;
+	RGBApixel pixel;
+
+	for (int i=tileY; i<tileEndY; i+=step) {
+		int blockEndY = i + step < tileEndY ? i + step : tileEndY;
+		point.data.Y = -(0 - sceneRef->camera.height/2.0 + contextRef->pixelHeight * (contextRef->originY + (i + blockEndY - 1) / 2 + 0.5));
+		for (int j=tileX; j<tileEndX; j+=step) {
+			int blockEndX = j + step < tileEndX ? j + step : tileEndX;
+			double cost = 0;
+			point.data.X = 0 - sceneRef->camera.width/2.0 + contextRef->pixelWidth * (contextRef->originX + (j + blockEndX - 1) / 2 + 0.5);
+			v3_normalize(&point, &rayDirection);
+			if (contextRef->costMetric != COST_NONE_T) {
+				double costStart = read_cost(contextRef->costMetric);
+				shoot(&cameraPos, &rayDirection, sceneRef, &colorFound);
+				cost = read_cost(contextRef->costMetric) - costStart;
+			}
+			else {
+				shoot(&cameraPos, &rayDirection, sceneRef, &colorFound);
+			}
+			shade(&colorFound, &pixel);
+
+			for (int y=i; y<blockEndY; y++) {
+				for (int x=j; x<blockEndX; x++) {
+					tilePixels[(y - tileY)*tileWidth + x - tileX] = pixel;
+					if (contextRef->costMetric != COST_NONE_T)
+						contextRef->optionsRef->costmapRef->values[y*imageWidth + x] = (float) cost;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Traces the camera ray of a single pixel, exactly as a full render would
+ * @param contextRef - The shared state of the render
+ * @param i - The row of the pixel in the rendered region
+ * @param j - The column of the pixel in the rendered region
+ * @param distanceRef - Set to the distance to the closest hit or INFINITY
+ * @param hitRef - Set to the primitive hit or NULL
+ * @param directionRef - Set to the direction of the camera ray, may be NULL
+ */
+static void trace_pixel(RenderContext *contextRef, int i, int j, double *distanceRef, Primitive **hitRef, V3 *directionRef) {
+	Scene *sceneRef = contextRef->sceneRef;
+	int index = i*contextRef->imageWidth + j;
+	V3 cameraPos = {{0, 0, 0}};
+	V3 rayDirection = {{0, 0, 0}};
+	V3 point = {{0, 0, 1}};
+	RGBAColor colorFound;
+
+	point.data.Y = -(0 - sceneRef->camera.height/2.0 + contextRef->pixelHeight * (contextRef->originY + i + 0.5));
+	point.data.X = 0 - sceneRef->camera.width/2.0 + contextRef->pixelWidth * (contextRef->originX + j + 0.5);
+	v3_normalize(&point, &rayDirection);
+	if (contextRef->costMetric != COST_NONE_T) {
+		double costStart = read_cost(contextRef->costMetric);
+		shoot_primary(&cameraPos, &rayDirection, sceneRef, &colorFound, distanceRef, hitRef);
+		contextRef->optionsRef->costmapRef->values[index] = (float) (read_cost(contextRef->costMetric) - costStart);
+	}
+	else {
+		shoot_primary(&cameraPos, &rayDirection, sceneRef, &colorFound, distanceRef, hitRef);
+	}
+	shade(&colorFound, render_pixel(contextRef, j, i));
+	if (directionRef != NULL)
+		*directionRef = rayDirection;
+}
+
+/**
+ * Determine if two traced pixels lie on different sides of an edge: a different primitive, a jump
+ * in depth, or a jump in color
+ */
+static int is_discontinuous(RGBApixel *a, double distanceA, Primitive *hitA, RGBApixel *b, double distanceB, Primitive *hitB) {
+	if (hitA != hitB)
+		return TRUE;
+	if (hitA != NULL && fabs(distanceA - distanceB) > SPARSE_DEPTH_THRESHOLD * fmin(distanceA, distanceB))
+		return TRUE;
+	return abs(a->r - b->r) > SPARSE_COLOR_THRESHOLD || abs(a->g - b->g) > SPARSE_COLOR_THRESHOLD ||
+		   abs(a->b - b->b) > SPARSE_COLOR_THRESHOLD;
+}
+
+/**
+ * Raycasts a tile sparsely. A lattice of every sparseStep-th pixel is traced, each lattice cell whose
+ * corners are discontinuous is then traced densely and the rest are filled by bilinear interpolation
+ * of their corners, which never blends across an edge since those cells were traced.
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ * @return 0 if success, otherwise the buffers of the tile could not be allocated and nothing was traced
+ */
+static int render_tile_sparse(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	enum { PIXEL_EMPTY, PIXEL_TRACED, PIXEL_INTERPOLATED };
+	RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+	int imageWidth = contextRef->imageWidth;
+	int step = contextRef->sparseStep;
+	int width = tileEndX - tileX;
+	int height = tileEndY - tileY;
+	// The lattice always includes the last row and column of the tile so every pixel lies in a cell
+	int columns = (width - 1 + step - 1) / step + 1;
+	int rows = (height - 1 + step - 1) / step + 1;
+
+	if (thread_sparse_reserve(width * height) != 0)
+		return 1;
+	uint8_t *states = threadSparseStates;
+	double *distances = threadSparseDistances;
+	Primitive **hits = threadSparseHits;
+	memset(states, PIXEL_EMPTY, (size_t) width * height);
+
+	for (int a=0; a<rows; a++) {
+		if (tile_abandoned(contextRef))
+			return 0;
+		int i = tileY + a*step < tileEndY - 1 ? tileY + a*step : tileEndY - 1;
+		for (int b=0; b<columns; b++) {
+			int j = tileX + b*step < tileEndX - 1 ? tileX + b*step : tileEndX - 1;
+			int local = (i - tileY)*width + (j - tileX);
+			trace_pixel(contextRef, i, j, &distances[local], &hits[local], NULL);
+			states[local] = PIXEL_TRACED;
+		}
+	}
+
+	for (int a=0; a<rows; a++) {
+		if (tile_abandoned(contextRef))
+			return 0;
+		int y0 = tileY + a*step < tileEndY - 1 ? tileY + a*step : tileEndY - 1;
+		int y1 = a + 1 < rows && tileY + (a + 1)*step < tileEndY - 1 ? tileY + (a + 1)*step : tileEndY - 1;
+		for (int b=0; b<columns; b++) {
+			int x0 = tileX + b*step < tileEndX - 1 ? tileX + b*step : tileEndX - 1;
+			int x1 = b + 1 < columns && tileX + (b + 1)*step < tileEndX - 1 ? tileX + (b + 1)*step : tileEndX - 1;
+			int corners[4] = {
+				(y0 - tileY)*width + (x0 - tileX), (y0 - tileY)*width + (x1 - tileX),
+				(y1 - tileY)*width + (x0 - tileX), (y1 - tileY)*width + (x1 - tileX)
+			};
+			RGBApixel *cornerPixels[4] = {
+				&tilePixels[corners[0]], &tilePixels[corners[1]], &tilePixels[corners[2]], &tilePixels[corners[3]]
+			};
+
+			int edge = FALSE;
+			for (int c=1; c<4 && !edge; c++)
+				edge = is_discontinuous(cornerPixels[0], distances[corners[0]], hits[corners[0]],
+										cornerPixels[c], distances[corners[c]], hits[corners[c]]);
+
+			for (int i=y0; i<=y1; i++) {
+				for (int j=x0; j<=x1; j++) {
+					int local = (i - tileY)*width + (j - tileX);
+					if (states[local] == PIXEL_TRACED || (!edge && states[local] == PIXEL_INTERPOLATED))
+						continue;
+					if (edge) {
+						trace_pixel(contextRef, i, j, &distances[local], &hits[local], NULL);
+						states[local] = PIXEL_TRACED;
+						continue;
+					}
+
+					double u = x1 > x0 ? (double) (j - x0) / (x1 - x0) : 0;
+					double v = y1 > y0 ? (double) (i - y0) / (y1 - y0) : 0;
+					double weights[4] = {(1 - u)*(1 - v), u*(1 - v), (1 - u)*v, u*v};
+					double r = 0, g = 0, bl = 0;
+					for (int c=0; c<4; c++) {
+						r += weights[c] * cornerPixels[c]->r;
+						g += weights[c] * cornerPixels[c]->g;
+						bl += weights[c] * cornerPixels[c]->b;
+					}
+					RGBApixel *pixelRef = &tilePixels[local];
+					pixelRef->r = (uint8_t) (r + 0.5);
+					pixelRef->g = (uint8_t) (g + 0.5);
+					pixelRef->b = (uint8_t) (bl + 0.5);
+					pixelRef->a = 255;
+					if (contextRef->costMetric != COST_NONE_T)
+						contextRef->optionsRef->costmapRef->values[i*imageWidth + j] = 0;
+					states[local] = PIXEL_INTERPOLATED;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Raycasts a tile while recording the camera hit of every pixel into the G-buffer
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ */
+static void render_tile_capture(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	GBufferSample *samples = contextRef->optionsRef->gbufferRef->samples;
+	V3 cameraPos = {{0, 0, 0}};
+	Primitive *primitiveHitRef;
+
+	for (int i=tileY; i<tileEndY; i++) {
+		for (int j=tileX; j<tileEndX; j++) {
+			GBufferSample *sampleRef = &samples[i*contextRef->imageWidth + j];
+			trace_pixel(contextRef, i, j, &sampleRef->distance, &primitiveHitRef, &sampleRef->direction);
+			sampleRef->primitive = -1;
+			sampleRef->triangle = -1;
+			if (primitiveHitRef == NULL)
+				continue;
+
+			// Shading traced more rays since the camera hit, so find the mesh triangle again
+			if (primitiveHitRef->type == MESH_T) {
+				double distance;
+				find_closest_hit(&cameraPos, &sampleRef->direction, contextRef->sceneRef, NULL, &distance);
+				sampleRef->triangle = threadMeshHit.triangle;
+			}
+
+			// Recompute the hit exactly as shade_hit did so a relight reproduces this render
+			for (int k = 0; k < contextRef->sceneRef->primitivesLength; k++) {
+				if (contextRef->sceneRef->primitives[k] == primitiveHitRef)
+					sampleRef->primitive = k;
+			}
+			v3_scale(&sampleRef->direction, sampleRef->distance, &sampleRef->position);
+			v3_add(&cameraPos, &sampleRef->position, &sampleRef->position);
+			surface_normal(primitiveHitRef, &sampleRef->position, &sampleRef->normal);
+		}
+	}
+}
+
+/**
+ * Shades a tile from the camera hits in the G-buffer, only shadow, reflection and refraction rays are traced
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ */
+static void render_tile_relight(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	Scene *sceneRef = contextRef->sceneRef;
+	GBufferSample *samples = contextRef->optionsRef->gbufferRef->samples;
+	RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+	int tileWidth = tileEndX - tileX;
+	V3 color;
+	RGBAColor colorFound;
+
+	for (int i=tileY; i<tileEndY; i++) {
+		for (int j=tileX; j<tileEndX; j++) {
+			int index = i*contextRef->imageWidth + j;
+			GBufferSample *sampleRef = &samples[index];
+			double costStart = contextRef->costMetric != COST_NONE_T ? read_cost(contextRef->costMetric) : 0;
+
+			if (sampleRef->primitive >= 0 && sampleRef->primitive < sceneRef->primitivesLength) {
+				STATS_DEPTH(0);
+				threadMeshHit.triangle = sampleRef->triangle;
+				shade_surface(&sampleRef->direction, sceneRef, sceneRef->primitives[sampleRef->primitive],
+							  &sampleRef->position, &sampleRef->normal, &color, 0);
+			}
+			else {
+				color.array[0] = 0;
+				color.array[1] = 0;
+				color.array[2] = 0;
+			}
+			color_to_rgba(&color, &colorFound);
+			shade(&colorFound, &tilePixels[(i - tileY)*tileWidth + j - tileX]);
+
+			if (contextRef->costMetric != COST_NONE_T)
+				contextRef->optionsRef->costmapRef->values[index] = (float) (read_cost(contextRef->costMetric) - costStart);
+		}
+	}
+}
+
+/**
+ * Find what a camera ray hits, testing only the primitives binned for the tile when there is a bin
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - The scene
+ * @param distanceRef - Set to the distance to the closest hit or INFINITY
+ * @return The primitive hit, or NULL
+ */
+static Primitive *find_camera_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, double *distanceRef) {
+	STATS_INC(cameraRays);
+	STATS_DEPTH(0);
+	return threadCameraPack != NULL ?
+		find_closest_packed_hit(rayOriginRef, rayDirectionRef, sceneRef, threadCameraPack, NULL, distanceRef) :
+		find_closest_hit(rayOriginRef, rayDirectionRef, sceneRef, NULL, distanceRef);
+}
+
+/**
+ * Raycasts a tile in two passes: every camera ray of the tile is traced first, then the lights of the
+ * scene are classified for the points hit, and only then are the points shaded, so the shadow rays of
+ * a light which is seen by or hidden from the whole tile are not cast and the others only test the
+ * primitives near the tile. Pixels are visited in the order of the traversal curve, so consecutive
+ * camera rays stay close together and keep touching the same primitives. Every pixel is colored
+ * exactly as by shoot.
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ * @return 0 if success, otherwise the camera hits of the tile did not fit in memory
+ */
+static int render_tile_lit(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	Scene *sceneRef = contextRef->sceneRef;
+	TileLights *tileLightsRef = &threadTileLights;
+	RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+	float *costs = contextRef->costMetric != COST_NONE_T ? contextRef->optionsRef->costmapRef->values : NULL;
+	int tileSize = contextRef->tileSize;
+	int tileWidth = tileEndX - tileX;
+	int tileHeight = tileEndY - tileY;
+	int length = contextRef->pixelOrder != NULL ? tileSize*tileSize : tileWidth*tileHeight;
+	V3 cameraPos = {{0, 0, 0}};
+	V3 point = {{0, 0, 1}};
+	V3 color;
+	RGBAColor colorFound;
+
+	if (tile_lights_reserve(tileLightsRef, tileWidth*tileHeight) != 0)
+		return 1;
+
+	for (int k = 0; k < length; k++) {
+		int x = k % tileWidth;
+		int y = k / tileWidth;
+		// Tiles at the right and bottom edges skip the part of the curve outside of the image
+		if (contextRef->pixelOrder != NULL) {
+			x = contextRef->pixelOrder[k] % tileSize;
+			y = contextRef->pixelOrder[k] / tileSize;
+			if (x >= tileWidth || y >= tileHeight)
+				continue;
+		}
+		int i = tileY + y;
+		int j = tileX + x;
+		int pixel = y*tileWidth + x;
+		// The deadline is checked about once per row of the tile
+		if (k % tileWidth == 0 && tile_abandoned(contextRef))
+			return 0;
+		double costStart = costs != NULL ? read_cost(contextRef->costMetric) : 0;
+		point.data.Y = -(0 - sceneRef->camera.height/2.0 + contextRef->pixelHeight * (contextRef->originY + i + 0.5));
+		point.data.X = 0 - sceneRef->camera.width/2.0 + contextRef->pixelWidth * (contextRef->originX + j + 0.5);
+		v3_normalize(&point, &tileLightsRef->directions[pixel]);
+		tileLightsRef->hits[pixel] = find_camera_hit(&cameraPos, &tileLightsRef->directions[pixel], sceneRef,
+													 &tileLightsRef->distances[pixel]);
+		tileLightsRef->meshHits[pixel] = threadMeshHit;
+		// The same arithmetic as shade_hit, so the classified points are the ones shaded
+		v3_scale(&tileLightsRef->directions[pixel], tileLightsRef->distances[pixel], &tileLightsRef->positions[pixel]);
+		v3_add(&cameraPos, &tileLightsRef->positions[pixel], &tileLightsRef->positions[pixel]);
+		if (costs != NULL)
+			costs[i*contextRef->imageWidth + j] = (float) (read_cost(contextRef->costMetric) - costStart);
+	}
+
+	// A tile which could not be classified is shaded with a shadow ray for every light
+	if (tile_lights_classify(tileLightsRef, sceneRef, tileWidth*tileHeight) == 0)
+		threadCameraLights = tileLightsRef->lights;
+
+	for (int k = 0; k < length; k++) {
+		int x = k % tileWidth;
+		int y = k / tileWidth;
+		if (contextRef->pixelOrder != NULL) {
+			x = contextRef->pixelOrder[k] % tileSize;
+			y = contextRef->pixelOrder[k] / tileSize;
+			if (x >= tileWidth || y >= tileHeight)
+				continue;
+		}
+		int pixel = y*tileWidth + x;
+		if (k % tileWidth == 0 && tile_abandoned(contextRef))
+			break;
+		double costStart = costs != NULL ? read_cost(contextRef->costMetric) : 0;
+		threadMeshHit = tileLightsRef->meshHits[pixel];
+		shade_hit(&cameraPos, &tileLightsRef->directions[pixel], sceneRef, tileLightsRef->hits[pixel],
+				  tileLightsRef->distances[pixel], &color, 0);
+		color_to_rgba(&color, &colorFound);
+		shade(&colorFound, &tilePixels[pixel]);
+		if (costs != NULL)
+			costs[(tileY + y)*contextRef->imageWidth + tileX + x] += (float) (read_cost(contextRef->costMetric) - costStart);
+	}
+	threadCameraLights = NULL;
+	return 0;
+}
+
+/**
+ * Fills a tile no camera ray can hit anything in with the color of a miss, without tracing
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ */
+static void render_tile_background(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+	RGBApixel background = {0, 0, 0, 255};
+
+	for (int k = 0; k < (tileEndX - tileX)*(tileEndY - tileY); k++)
+		tilePixels[k] = background;
+	if (contextRef->costMetric != COST_NONE_T) {
+		for (int i=tileY; i<tileEndY; i++) {
+			for (int j=tileX; j<tileEndX; j++)
+				contextRef->optionsRef->costmapRef->values[i*contextRef->imageWidth + j] = 0;
+		}
+	}
+}
+
+/**
+ * Raycasts the pixels of a tile in the way the render options ask for
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ */
+static void render_tile_traced(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	Scene *sceneRef = contextRef->sceneRef;
+	int imageWidth = contextRef->imageWidth;
+	int originX = contextRef->originX;
+	int originY = contextRef->originY;
+	RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+	int tileWidth = tileEndX - tileX;
 
 	double cameraHeight = sceneRef->camera.height;
 	double cameraWidth = sceneRef->camera.width;
 
-	V3 viewPlanePos = {0, 0, 1};
-    V3 cameraPos = {0, 0, 0};
-
-	double pixelHeight = cameraHeight/imageWidth;
-	double pixelWidth = cameraWidth/imageHeight;
+	V3 viewPlanePos = {{0, 0, 1}};
+	V3 cameraPos = {{0, 0, 0}};
 
-	V3 rayDirection = {0, 0, 0}; // The direction of our ray
-    V3 point = {0, 0, 0}; // The point on the viewPlane that we intersect
+	V3 rayDirection = {{0, 0, 0}}; // The direction of our ray
+	V3 point = {{0, 0, 0}}; // The point on the viewPlane that we intersect
 
 	RGBAColor colorFound;
 
-    point.data.Z = viewPlanePos.data.Z;
-	for (int i=0; i<imageWidth; i++) {
-        point.data.Y = -(viewPlanePos.data.Y - cameraHeight/2.0 + pixelHeight * (i + 0.5));
-		for (int j=0; j<imageHeight; j++) {
-            point.data.X = viewPlanePos.data.X - cameraWidth/2.0 + pixelWidth * (j + 0.5);
+	threadMaxDepth = contextRef->maxDepth;
+	threadLightSamples = contextRef->lightSamples;
+	if (contextRef->sampleStep > 1) {
+		render_tile_coarse(contextRef, tileX, tileY, tileEndX, tileEndY);
+		return;
+	}
+	// Without the memory for its lattice a tile is traced densely instead
+	if (contextRef->sparseStep > 1 && render_tile_sparse(contextRef, tileX, tileY, tileEndX, tileEndY) == 0)
+		return;
+	if (contextRef->optionsRef->gbufferMode == GBUFFER_CAPTURE_T) {
+		render_tile_capture(contextRef, tileX, tileY, tileEndX, tileEndY);
+		return;
+	}
+	if (contextRef->optionsRef->gbufferMode == GBUFFER_RELIGHT_T) {
+		render_tile_relight(contextRef, tileX, tileY, tileEndX, tileEndY);
+		return;
+	}
+	// Without the memory for its rays a tile is traced ray by ray instead, and so is a tile with a
+	// deadline since a generation of rays can not be left part way
+	if (contextRef->optionsRef->wavefront && contextRef->deadline == 0 && render_tile_wavefront(contextRef, tileX, tileY, tileEndX, tileEndY) == 0)
+		return;
+	if (render_tile_lit(contextRef, tileX, tileY, tileEndX, tileEndY) == 0)
+		return;
+
+	point.data.Z = viewPlanePos.data.Z;
+	for (int i=tileY; i<tileEndY; i++) {
+		if (tile_abandoned(contextRef))
+			return;
+		point.data.Y = -(viewPlanePos.data.Y - cameraHeight/2.0 + contextRef->pixelHeight * (originY + i + 0.5));
+		for (int j=tileX; j<tileEndX; j++) {
+			point.data.X = viewPlanePos.data.X - cameraWidth/2.0 + contextRef->pixelWidth * (originX + j + 0.5);
 			v3_normalize(&point, &rayDirection); // normalization, find the ray direction
-			shoot(&cameraPos, &rayDirection, sceneRef, &colorFound);
-			shade(&colorFound, &imageRef->pixmapRef[i*imageHeight + j]);
+			if (contextRef->costMetric != COST_NONE_T) {
+				double costStart = read_cost(contextRef->costMetric);
+				shoot(&cameraPos, &rayDirection, sceneRef, &colorFound);
+				contextRef->optionsRef->costmapRef->values[i*imageWidth + j] = (float) (read_cost(contextRef->costMetric) - costStart);
+			}
+			else {
+				shoot(&cameraPos, &rayDirection, sceneRef, &colorFound);
+			}
+			shade(&colorFound, &tilePixels[(i - tileY)*tileWidth + j - tileX]);
 		}
 	}
+}
 
+/**
+ * Raycasts a single tile of the image, tiles cover the rendered region starting at its origin. With a
+ * sample step above 1 one ray is cast for each step x step block and its color fills the block. Camera
+ * rays only test the primitives binned for the tile, a tile whose bin is empty is filled without tracing.
+ * @param contextRef - The shared state of the render
+ * @param tileIndex - The tile to render, tiles are numbered row by row
+ * @return 0 if the tile was finished, otherwise the deadline passed and it was left part way through
+ */
+int render_tile(RenderContext *contextRef, int tileIndex) {
+	int tileX = (tileIndex % contextRef->tilesX) * contextRef->tileSize;
+	int tileY = (tileIndex / contextRef->tilesX) * contextRef->tileSize;
+	int tileEndX = tileX + contextRef->tileSize < contextRef->imageWidth ? tileX + contextRef->tileSize : contextRef->imageWidth;
+	int tileEndY = tileY + contextRef->tileSize < contextRef->imageHeight ? tileY + contextRef->tileSize : contextRef->imageHeight;
+	PrimitivePack *binRef = contextRef->tileBinsRef != NULL ? &contextRef->tileBinsRef->bins[tileIndex] : NULL;
+
+	// A G-buffer holds the camera ray of every pixel, so its tiles are always traced
+	if (binRef != NULL && binRef->spheresLength == 0 && binRef->othersLength == 0 &&
+		contextRef->optionsRef->gbufferMode == GBUFFER_NONE_T) {
+		render_tile_background(contextRef, tileX, tileY, tileEndX, tileEndY);
+		return 0;
+	}
+	threadTileAbandoned = FALSE;
+	threadCameraPack = binRef;
+	render_tile_traced(contextRef, tileX, tileY, tileEndX, tileEndY);
+	threadCameraPack = NULL;
+	return threadTileAbandoned ? 1 : 0;
+}
+
+/**
+ * A render thread, claims tiles until there are none left then merges its counters into the total
+ * @param argRef - The RenderWorker describing this thread
+ * @return NULL
+ */
+static void *render_worker(void *argRef) {
+	RenderWorker *workerRef = argRef;
+	RenderContext *contextRef = workerRef->contextRef;
+	TraceRecorder *traceRef = contextRef->optionsRef->traceRef;
+	TraceBuffer *traceBufferRef = trace_thread_buffer(traceRef, "render worker", workerRef->index);
+	int next;
+
+	stats_reset_thread();
+	double workerStart = trace_now(traceRef);
+
+	while ((next = atomic_fetch_add_explicit(&contextRef->nextTile, 1, memory_order_relaxed)) < contextRef->tilesLength) {
+		int tileIndex = contextRef->tileOrder != NULL ? contextRef->tileOrder[next] : next;
+		if (contextRef->tilesDone != NULL && atomic_load_explicit(&contextRef->tilesDone[tileIndex], memory_order_relaxed))
+			continue;
+		// Past the deadline no more tiles are started, and a tile being refined stops within a row
+		if (contextRef->deadline > 0 && monotonic_seconds() >= contextRef->deadline)
+			break;
+		double tileStart = trace_now(traceRef);
+		int abandoned = render_tile(contextRef, tileIndex);
+		trace_span_xy(traceBufferRef, "tile", tileStart, trace_now(traceRef),
+					  tileIndex % contextRef->tilesX, tileIndex / contextRef->tilesX);
+		// A tile left part way is not counted as rendered
+		if (abandoned)
+			break;
+		if (contextRef->tilesDone != NULL)
+			atomic_store_explicit(&contextRef->tilesDone[tileIndex], TRUE, memory_order_release);
+		// Progress is counted under the lock so the counts reported never go backwards
+		if (contextRef->optionsRef->progress != NULL) {
+			pthread_mutex_lock(&contextRef->statsLock);
+			int tilesRendered = atomic_fetch_add_explicit(&contextRef->tilesRendered, 1, memory_order_relaxed) + 1;
+			contextRef->optionsRef->progress(tilesRendered, contextRef->tilesLength, contextRef->optionsRef->progressDataRef);
+			pthread_mutex_unlock(&contextRef->statsLock);
+		}
+		else {
+			atomic_fetch_add_explicit(&contextRef->tilesRendered, 1, memory_order_relaxed);
+		}
+	}
+
+	trace_span(traceBufferRef, "render worker", workerStart, trace_now(traceRef));
+
+	if (contextRef->optionsRef->statsRef != NULL) {
+		pthread_mutex_lock(&contextRef->statsLock);
+		stats_collect_thread(contextRef->optionsRef->statsRef);
+		pthread_mutex_unlock(&contextRef->statsLock);
+	}
+	// Render threads come and go with every render, so the buffers they grew go with them
+	tile_lights_free(&threadTileLights);
+	wavefront_thread_free();
+	free(threadLights);
+	threadLights = NULL;
+	threadLightsCapacity = 0;
+	free(threadSparseStates);
+	free(threadSparseDistances);
+	free(threadSparseHits);
+	threadSparseStates = NULL;
+	threadSparseDistances = NULL;
+	threadSparseHits = NULL;
+	threadSparseCapacity = 0;
+
+	return NULL;
+}
 
+/**
+ * Runs workers over every tile of a prepared render context. With a single thread the tiles are
+ * rendered on the calling thread.
+ * @param contextRef - The render to run
+ * @param threads - The number of render threads
+ * @return 0 if success, otherwise a failure occurred
+ */
+int render_context_run(RenderContext *contextRef, int threads) {
+	if (threads < 1)
+		threads = 1;
+	if (threads > contextRef->tilesLength)
+		threads = contextRef->tilesLength;
+
+	RenderWorker *workers = malloc(sizeof(RenderWorker) * threads);
+	pthread_t *threadIds = malloc(sizeof(pthread_t) * threads);
+	int started = 0;
+
+	if (workers == NULL || threadIds == NULL) {
+		fprintf(stderr, "Error: Could not allocate the render threads\n");
+		free(workers);
+		free(threadIds);
+		return 1;
+	}
+
+	for (int i = 0; i < threads; i++) {
+		workers[i].contextRef = contextRef;
+		workers[i].index = i;
+	}
+
+	Checkpoint *checkpointRef = contextRef->optionsRef->checkpointRef;
+	if (checkpointRef != NULL)
+		checkpoint_start(checkpointRef, contextRef, contextRef->framebuffer, contextRef->tilesDone);
+
+	// The calling thread is always worker 0
+	for (int i = 1; i < threads; i++) {
+		if (pthread_create(&threadIds[i], NULL, render_worker, &workers[i]) != 0) {
+			fprintf(stderr, "Warning: Could only start %d of %d render threads\n", started + 1, threads);
+			break;
+		}
+		started++;
+	}
+	render_worker(&workers[0]);
+	for (int i = 1; i <= started; i++)
+		pthread_join(threadIds[i], NULL);
+	if (checkpointRef != NULL)
+		checkpoint_stop(checkpointRef);
+
+	free(threadIds);
+	free(workers);
 	return 0;
 }
 
+/**
+ * Renders in passes of increasing quality until the deadline in the options passes. The first, coarse
+ * pass always finishes, every later pass refines the image tile by tile and stops within a row of a tile
+ * at the deadline, so the image is always complete and the last pass is identical to a normal render.
+ * @param contextRef - The render to run
+ * @param threads - The number of render threads
+ * @param qualityRef - Set to the highest pass finished on every tile and how much of the next one was done
+ * @return 0 if success, otherwise a failure occurred
+ */
+int render_context_run_budget(RenderContext *contextRef, int threads, RenderQuality *qualityRef) {
+	double deadline = contextRef->optionsRef->deadline;
+
+	qualityRef->level = 0;
+	qualityRef->levels = RENDER_LEVELS;
+	qualityRef->levelName = "none";
+	qualityRef->nextLevelFraction = 0;
+
+	for (int i = 0; i < RENDER_LEVELS; i++) {
+		contextRef->sampleStep = renderLevels[i].sampleStep;
+		contextRef->maxDepth = renderLevels[i].maxDepth;
+		contextRef->deadline = i == 0 ? 0 : deadline;
+		atomic_store(&contextRef->nextTile, 0);
+		atomic_store(&contextRef->tilesRendered, 0);
+
+		if (render_context_run(contextRef, threads) != 0)
+			return 1;
+
+		int rendered = atomic_load(&contextRef->tilesRendered);
+		if (rendered < contextRef->tilesLength) {
+			qualityRef->nextLevelFraction = (double) rendered / contextRef->tilesLength;
+			break;
+		}
+		qualityRef->level = i + 1;
+		qualityRef->levelName = renderLevels[i].name;
+	}
+
+	contextRef->sampleStep = 1;
+	contextRef->maxDepth = MAX_RECURSE_DEPTH;
+	contextRef->deadline = 0;
+	return 0;
+}
+
+/**
+ * Copies the framebuffer of a finished render into a row major image, one row of a tile at a time
+ * @param contextRef - The render
+ * @param pixmapRef - The imageWidth x imageHeight image to write to
+ */
+void render_context_linearize(RenderContext *contextRef, RGBApixel *pixmapRef) {
+	int imageWidth = contextRef->imageWidth;
+	int tileSize = contextRef->tileSize;
+
+	for (int tileY = 0; tileY < contextRef->imageHeight; tileY += tileSize) {
+		int tileEndY = tileY + tileSize < contextRef->imageHeight ? tileY + tileSize : contextRef->imageHeight;
+		for (int tileX = 0; tileX < imageWidth; tileX += tileSize) {
+			int tileWidth = tileX + tileSize < imageWidth ? tileSize : imageWidth - tileX;
+			RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+			for (int i = tileY; i < tileEndY; i++)
+				memcpy(&pixmapRef[(size_t) i*imageWidth + tileX], &tilePixels[(size_t) (i - tileY)*tileWidth],
+					   sizeof(RGBApixel) * tileWidth);
+		}
+	}
+}
+
+/**
+ * Release what render_context_init allocated, the scene and options are left to the caller
+ * @param contextRef - The render context to free
+ */
+void render_context_free(RenderContext *contextRef) {
+	free(contextRef->framebuffer);
+	free(contextRef->tileOrder);
+	free(contextRef->pixelOrder);
+	tile_bins_free(contextRef);
+	free(contextRef->tilesDone);
+	pthread_mutex_destroy(&contextRef->statsLock);
+}
+
+/**
+ * Allocates space in the imageRef specified for an image of the selected imageWidth and imageHeight.
+ * Then raycasts a specified scene into the specified image.
+ * @param sceneRef - The input scene to render
+ * @param imageRef - The output image to write to
+ * @param imageWidth - The width of the output image
+ * @param imageHeight - The height of the output image
+ * @param optionsRef - The render options, a costmap is written to optionsRef->costmapRef if a cost metric is set,
+ * if optionsRef->region is set only that part of the imageWidth x imageHeight frame is rendered, if
+ * optionsRef->processes is set the tiles are rendered by that many forked processes instead of threads, if
+ * optionsRef->checkpointRef is set finished tiles are checkpointed and optionally resumed, if optionsRef->deadline
+ * is set the image is refined in passes until then and the quality reached is written to optionsRef->qualityRef
+ * @return 0 if success, otherwise a failure occurred
+ */
+int raycast(Scene *sceneRef, Image* imageRef, int imageWidth, int imageHeight, RenderOptions *optionsRef) {
+	RenderContext context;
+
+	if (render_context_init(&context, sceneRef, imageRef, imageWidth, imageHeight, optionsRef) != 0)
+		return 1;
+
+	if (optionsRef->checkpointRef != NULL && optionsRef->checkpointRef->resume &&
+		checkpoint_load(optionsRef->checkpointRef, &context, context.tilesDone) != 0) {
+		render_context_free(&context);
+		return 1;
+	}
+
+	int result;
+	if (optionsRef->deadline > 0 && optionsRef->qualityRef != NULL)
+		result = render_context_run_budget(&context, optionsRef->threads, optionsRef->qualityRef);
+	else if (optionsRef->processes > 0)
+		result = render_context_run_processes(&context, optionsRef->processes);
+	else
+		result = render_context_run(&context, optionsRef->threads);
+	if (result == 0) {
+		imageRef->pixmapRef = malloc(sizeof(RGBApixel) * context.imageWidth * context.imageHeight);
+		if (imageRef->pixmapRef == NULL) {
+			fprintf(stderr, "Error: Could not allocate an image of %dx%d pixels\n", context.imageWidth, context.imageHeight);
+			result = 1;
+		}
+		else {
+			render_context_linearize(&context, imageRef->pixmapRef);
+		}
+	}
+	render_context_free(&context);
+
+	return result;
+}
+
 /**
  * Shades a specific pixel based on the primitive provides
  * @param primitiveHitRef - The primitive that was hit during a call to the shoot function
@@ -78,20 +1103,47 @@ int shade(RGBAColor* colorRef, RGBApixel *pixel) {
  * @return
  */
 int shoot(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RGBAColor *foundColor) {
+	return shoot_primary(rayOriginRef, rayDirectionRef, sceneRef, foundColor, NULL, NULL);
+}
+
+/**
+ * Shoots a camera ray like shoot, also reporting what the ray hit
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene
+ * @param foundColor - The color found
+ * @param distanceRef - Set to the distance to the closest hit or INFINITY, may be NULL
+ * @param hitRef - Set to the primitive hit or NULL, may be NULL
+ * @return 0 if success, otherwise a failure occurred
+ */
+int shoot_primary(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RGBAColor *foundColor, double *distanceRef, Primitive **hitRef) {
 	V3 color;
-	if (shoot_rec(rayOriginRef, rayDirectionRef, sceneRef, &color, 0, NULL) != 0) {
+	double distance;
+	Primitive *primitiveHitRef = find_camera_hit(rayOriginRef, rayDirectionRef, sceneRef, &distance);
+	if (shade_hit(rayOriginRef, rayDirectionRef, sceneRef, primitiveHitRef, distance, &color, 0) != 0) {
 		return 1;
 	}
+	if (distanceRef != NULL)
+		*distanceRef = distance;
+	if (hitRef != NULL)
+		*hitRef = primitiveHitRef;
 
-	// Figure out lighting
-	foundColor->data.R = (uint8_t) (clamp(color.array[0])*255);
-	foundColor->data.G = (uint8_t) (clamp(color.array[1])*255);
-	foundColor->data.B = (uint8_t) (clamp(color.array[2])*255);
-	foundColor->data.A = 1;
-
+	color_to_rgba(&color, foundColor);
 	return 0;
 }
 
+/**
+ * Convert a traced color to an 8 bit color, clamping each channel
+ * @param colorRef - The traced color
+ * @param foundColor - The converted color
+ */
+void color_to_rgba(V3 *colorRef, RGBAColor *foundColor) {
+	foundColor->data.R = (uint8_t) (clamp(colorRef->array[0])*255);
+	foundColor->data.G = (uint8_t) (clamp(colorRef->array[1])*255);
+	foundColor->data.B = (uint8_t) (clamp(colorRef->array[2])*255);
+	foundColor->data.A = 1;
+}
+
 /**
  * Does the actual raytracing and sets the primitiveHit to a pointer to the primitive that was hit,
  * if any, when shooting the ray.
@@ -102,187 +1154,447 @@ int shoot(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RGBAColor *fou
  * @return
  */
 int shoot_rec(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, V3 *foundColor, int depth, Primitive *ignore) {
-	Primitive *primitiveRef;
+	double primitive_t;
+
+	STATS_DEPTH(depth);
+	Primitive *primitiveHitRef = find_closest_hit(rayOriginRef, rayDirectionRef, sceneRef, ignore, &primitive_t);
+	return shade_hit(rayOriginRef, rayDirectionRef, sceneRef, primitiveHitRef, primitive_t, foundColor, depth);
+}
+
+/**
+ * Tests a ray against a single primitive of any type
+ * @param primitiveRef - The primitive
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param ignoreTriangle - A mesh triangle to skip, or -1
+ * @param meshHitRef - Set to the triangle hit when the primitive is a mesh, may be NULL
+ * @return The hit distance along the ray, if positive. Otherwise INFINITY.
+ */
+static double intersect_primitive(Primitive *primitiveRef, V3 *rayOriginRef, V3 *rayDirectionRef, int ignoreTriangle, MeshHit *meshHitRef) {
+	switch(primitiveRef->type) {
+		case PLANE_T:
+			STATS_INC(planeTests);
+			return intersect_plane(&primitiveRef->data.plane, rayOriginRef, rayDirectionRef);
+		case SPHERE_T:
+			STATS_INC(sphereTests);
+			return intersect_sphere(&primitiveRef->data.sphere, rayOriginRef, rayDirectionRef);
+		case MESH_T:
+			return intersect_mesh(primitiveRef->data.mesh.dataRef, rayOriginRef, rayDirectionRef, ignoreTriangle, meshHitRef);
+	}
+	return INFINITY;
+}
+
+/**
+ * Finds the closest primitive along a ray among the primitives of a pack which are not spheres
+ */
+static Primitive *find_closest_other_hit(V3 *rayOriginRef, V3 *rayDirectionRef, PrimitivePack *packRef, Primitive *ignore,
+										 Primitive *primitiveHitRef, int closestIndex, double *distanceRef) {
+	double primitive_t = *distanceRef;
+	double possible_t;
+	MeshHit meshHit;
+
+	// On equal distances the first primitive of the scene wins, as it does in the loop over the scene
+	for (int i = 0; i < packRef->othersLength; i++) {
+		Primitive *primitiveRef = packRef->others[i];
+		if (primitiveRef == ignore)
+			continue;
+		possible_t = intersect_primitive(primitiveRef, rayOriginRef, rayDirectionRef, -1, &meshHit);
+		if (possible_t > 0 && (possible_t < primitive_t || (possible_t == primitive_t && primitiveHitRef != NULL && packRef->otherIndices[i] < closestIndex))) {
+			primitive_t = possible_t;
+			primitiveHitRef = primitiveRef;
+			closestIndex = packRef->otherIndices[i];
+			// The normal and shadow rays of a mesh hit need the triangle hit
+			if (primitiveRef->type == MESH_T)
+				threadMeshHit = meshHit;
+		}
+	}
+
+	*distanceRef = primitive_t;
+	return primitiveHitRef;
+}
+
+/**
+ * Finds the closest primitive along a ray among the primitives which are not packed spheres, once the
+ * packed spheres were tested
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene, with packed primitives
+ * @param ignore - A primitive to skip, or NULL
+ * @param primitiveHitRef - The closest sphere hit, or NULL
+ * @param closestIndex - The index in the scene of the closest sphere hit
+ * @param distanceRef - The distance to the closest sphere hit or INFINITY, set to the distance to the closest hit
+ * @return The primitive hit, or NULL if nothing was hit
+ */
+Primitive *find_closest_unpacked_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, Primitive *ignore,
+									 Primitive *primitiveHitRef, int closestIndex, double *distanceRef) {
+	return find_closest_other_hit(rayOriginRef, rayDirectionRef, sceneRef->packRef, ignore, primitiveHitRef, closestIndex, distanceRef);
+}
+
+/**
+ * Finds the closest primitive along a ray among the primitives of a pack, the scene's own or a subset
+ * of it in the same order, which finds the same primitive as long as the subset holds every primitive
+ * the ray can hit
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene
+ * @param packRef - The primitives to test
+ * @param ignore - A primitive to skip, or NULL
+ * @param distanceRef - Set to the distance along the ray to the hit, or INFINITY if nothing was hit
+ * @return The primitive hit, or NULL if nothing was hit
+ */
+Primitive *find_closest_packed_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, PrimitivePack *packRef,
+								   Primitive *ignore, double *distanceRef) {
 	Primitive *primitiveHitRef = NULL;
+	double primitive_t = INFINITY;
+	double distances[KERNEL_CHUNK];
+	int closestIndex = sceneRef->primitivesLength;
+
+	// Test the packed spheres a chunk at a time, then everything else one by one
+	for (int first = 0; first < packRef->spheresLength; first += KERNEL_CHUNK) {
+		int count = packRef->spheresLength - first < KERNEL_CHUNK ? packRef->spheresLength - first : KERNEL_CHUNK;
+		STATS_ADD(sphereTests, count);
+		kernels.sphere_distances(packRef, first, count, rayOriginRef, rayDirectionRef, distances);
+		for (int k = 0; k < count; k++) {
+			if (distances[k] < primitive_t && packRef->spheres[first + k] != ignore) {
+				primitive_t = distances[k];
+				primitiveHitRef = packRef->spheres[first + k];
+				closestIndex = packRef->sphereIndices[first + k];
+			}
+		}
+	}
+	*distanceRef = primitive_t;
+	return find_closest_other_hit(rayOriginRef, rayDirectionRef, packRef, ignore, primitiveHitRef, closestIndex, distanceRef);
+}
 
-	foundColor->array[0] = 0;
-	foundColor->array[1] = 0;
-	foundColor->array[2] = 0;
+/**
+ * Finds the closest primitive along a ray
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene
+ * @param ignore - A primitive to skip, or NULL
+ * @param distanceRef - Set to the distance along the ray to the hit, or INFINITY if nothing was hit
+ * @return The primitive hit, or NULL if nothing was hit
+ */
+Primitive *find_closest_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, Primitive *ignore, double *distanceRef) {
+	Primitive *primitiveRef;
+	Primitive *primitiveHitRef = NULL;
+	PrimitivePack *packRef = sceneRef->packRef;
+	MeshHit meshHit;
+	MeshHit closestMeshHit;
 
 	// Our current closest t value
 	double primitive_t = INFINITY;
 	// A possible t value replacement
 	double possible_t;
 
+	if (packRef != NULL)
+		return find_closest_packed_hit(rayOriginRef, rayDirectionRef, sceneRef, packRef, ignore, distanceRef);
+
 	for (int i = 0; i < sceneRef->primitivesLength; i++) {
-		possible_t = INFINITY;
 		primitiveRef = sceneRef->primitives[i];
 		if (primitiveRef == ignore)
 			continue;
 
-		switch(primitiveRef->type) {
-			case PLANE_T:
-				possible_t = intersect_plane(&primitiveRef->data.plane, rayOriginRef, rayDirectionRef);
-				break;
-			case SPHERE_T:
-				possible_t = intersect_sphere(&primitiveRef->data.sphere, rayOriginRef, rayDirectionRef);
-				break;
-		}
+		possible_t = intersect_primitive(primitiveRef, rayOriginRef, rayDirectionRef, -1, &meshHit);
 		// Set the new possible shadow
 		if (possible_t > 0 && possible_t < primitive_t) {
 			primitive_t = possible_t;
 			primitiveHitRef = primitiveRef;
+			if (primitiveRef->type == MESH_T)
+				closestMeshHit = meshHit;
+		}
+	}
+
+	// The normal and shadow rays of a mesh hit need the triangle hit
+	if (primitiveHitRef != NULL && primitiveHitRef->type == MESH_T)
+		threadMeshHit = closestMeshHit;
+
+	*distanceRef = primitive_t;
+	return primitiveHitRef;
+}
+
+/**
+ * Computes the color seen along a ray which hit a primitive: direct lighting with shadow rays plus
+ * reflection and refraction rays while the recursion limit allows
+ * @param rayOriginRef - The origin of the ray
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene
+ * @param primitiveHitRef - The primitive hit, if NULL the color is black
+ * @param primitive_t - The distance along the ray to the hit
+ * @param foundColor - The color found
+ * @param depth - The recursion depth of the ray
+ * @return 0 if success, otherwise a failure occurred
+ */
+int shade_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, Primitive *primitiveHitRef, double primitive_t, V3 *foundColor, int depth) {
+	V3 position;
+	V3 normal;
+
+	if (primitiveHitRef == NULL) {
+		foundColor->array[0] = 0;
+		foundColor->array[1] = 0;
+		foundColor->array[2] = 0;
+		return 0;
+	}
+
+	// Calculate the hit position
+	v3_scale(rayDirectionRef, primitive_t, &position);
+	v3_add(rayOriginRef, &position, &position);
+	surface_normal(primitiveHitRef, &position, &normal);
+
+	return shade_surface(rayDirectionRef, sceneRef, primitiveHitRef, &position, &normal, foundColor, depth);
+}
+
+/**
+ * Computes the surface normal of a primitive at a point on its surface
+ * @param primitiveRef - The primitive
+ * @param positionRef - The point on the surface
+ * @param normalRef - The unit normal found
+ */
+void surface_normal(Primitive *primitiveRef, V3 *positionRef, V3 *normalRef) {
+	switch(primitiveRef->type) {
+		case PLANE_T:
+			*normalRef = primitiveRef->data.plane.normal;
+			break;
+		case SPHERE_T:
+			v3_subtract(positionRef, &primitiveRef->data.sphere.position, normalRef);
+			v3_normalize(normalRef, normalRef);
+			break;
+		case MESH_T:
+			mesh_normal(primitiveRef->data.mesh.dataRef, &threadMeshHit, normalRef);
+			break;
+	}
+}
+
+/**
+ * Light a surface point with one light, the shadow ray is only traced when the light is not culled first
+ * @param rayDirectionRef - The direction of the ray which hit the point
+ * @param sceneRef - The scene
+ * @param primitiveHitRef - The primitive hit, skipped by the shadow ray
+ * @param lightRef - The light
+ * @param positionRef - The point hit
+ * @param normalRef - The surface normal at the point
+ * @param colorDiffuseRef - The diffuse color of the primitive
+ * @param colorSpecularRef - The specular color of the primitive
+ * @param contributionRef - Set to the light added to the point
+ * @param tileLightRef - The light classified for the tile of a camera hit, NULL to test the whole scene
+ * @return TRUE when the light reaches the point, otherwise the contribution is not set
+ */
+static int shade_light(V3 *rayDirectionRef, Scene *sceneRef, Primitive *primitiveHitRef, Light *lightRef, V3 *positionRef,
+					   V3 *normalRef, V3 *colorDiffuseRef, V3 *colorSpecularRef, V3 *contributionRef, TileLight *tileLightRef) {
+	Primitive *primitiveRef;
+	double possible_t;
+	double light_t = INFINITY;
+	double lightDistance = INFINITY;
+	V3 lightPosition;
+	V3 lightColor;
+	V3 hitToLightRayDirection;
+	V3 rayReflectionDirection;
+	V3 diffuse;
+	V3 specular;
+	double frad;
+	double fang;
+
+	// Figure out hitToLightRayDirection
+	switch (lightRef->type) {
+		case POINTLIGHT_T:
+			lightPosition = lightRef->data.pointLight.position;
+			lightColor = lightRef->data.pointLight.color;
+			v3_subtract(&lightPosition, positionRef, &hitToLightRayDirection);
+			v3_normalize(&hitToLightRayDirection, &hitToLightRayDirection);
+			v3_distance(&lightPosition, positionRef, &lightDistance);
+			break;
+		case SPOTLIGHT_T:
+			lightPosition = lightRef->data.spotLight.position;
+			lightColor = lightRef->data.spotLight.color;
+			v3_subtract(&lightPosition, positionRef, &hitToLightRayDirection);
+			v3_normalize(&hitToLightRayDirection, &hitToLightRayDirection);
+			v3_distance(&lightPosition, positionRef, &lightDistance);
+			break;
+		default:
+			return FALSE;
+	}
+
+	// Skip lights which can not add anything here before paying for a shadow ray: lights behind
+	// the surface get no diffuse or specular term, lights outside a spotlight cone get no fang,
+	// and lights past their influence radius are dimmer than the light cutoff
+	double facing;
+	v3_dot(normalRef, &hitToLightRayDirection, &facing);
+	calculate_fang(lightRef, &hitToLightRayDirection, &fang);
+	if (facing <= 0 || fang == 0 || lightDistance > lightRef->influenceRadius) {
+		STATS_INC(lightsCulled);
+		return FALSE;
+	}
+
+	// A baked shadow map answers the shadow test with a lookup instead of a shadow ray
+	if (lightRef->shadowMapRef != NULL) {
+		STATS_INC(shadowMapLookups);
+		if (shadow_map_occluded(lightRef->shadowMapRef, positionRef, lightDistance, facing))
+			return FALSE;
+	}
+	// A light seen by or hidden from the whole tile needs no shadow ray
+	else if (tileLightRef != NULL && tileLightRef->visibility != LIGHT_MIXED_T) {
+		STATS_INC(shadowTileSkips);
+		if (tileLightRef->visibility == LIGHT_OCCLUDED_T)
+			return FALSE;
+	}
+	else {
+		// See if this should be in shadow, with the packed spheres first when the scene has them and
+		// only the primitives which can shadow the tile for a classified light
+		PrimitivePack *packRef = tileLightRef != NULL ? &tileLightRef->occluders : sceneRef->packRef;
+		Primitive **primitives = packRef != NULL ? packRef->others : sceneRef->primitives;
+		int primitivesLength = packRef != NULL ? packRef->othersLength : sceneRef->primitivesLength;
+		STATS_INC(shadowRays);
+		for (int first = 0; packRef != NULL && first < packRef->spheresLength && light_t == INFINITY; first += KERNEL_CHUNK) {
+			double distances[KERNEL_CHUNK];
+			int count = packRef->spheresLength - first < KERNEL_CHUNK ? packRef->spheresLength - first : KERNEL_CHUNK;
+			STATS_ADD(sphereTests, count);
+			kernels.sphere_distances(packRef, first, count, positionRef, &hitToLightRayDirection, distances);
+			for (int k = 0; k < count; k++) {
+				if (distances[k] < lightDistance && packRef->spheres[first + k] != primitiveHitRef) {
+					light_t = distances[k];
+					STATS_INC(shadowEarlyOuts);
+					break;
+				}
+			}
+		}
+		for (int j = 0; j < primitivesLength && light_t == INFINITY; j++) {
+			primitiveRef = primitives[j];
+
+			// Skip the current object, but a mesh can shadow itself with its other triangles
+			if (primitiveRef == primitiveHitRef && primitiveRef->type != MESH_T)
+				continue;
+
+			possible_t = intersect_primitive(primitiveRef, positionRef, &hitToLightRayDirection,
+											 primitiveRef == primitiveHitRef ? threadMeshHit.triangle : -1, NULL);
+			// Set the new possible shadow
+			if (possible_t > 0 && possible_t < lightDistance) {
+				light_t = possible_t;
+				STATS_INC(shadowEarlyOuts);
+			}
 		}
+
+		if (light_t != INFINITY)
+			// Our light is in shadow
+			return FALSE;
 	}
 
+	// Calculate rayReflectionDirection
+	v3_reflect(&hitToLightRayDirection, normalRef, &rayReflectionDirection);
+
+	// Get diffuse color contribution
+	calculate_diffuse(normalRef, &hitToLightRayDirection, colorDiffuseRef, &lightColor, &diffuse);
+	// Get specular color contribution
+	calculate_specular(rayDirectionRef, &rayReflectionDirection, colorSpecularRef, &lightColor, normalRef, &hitToLightRayDirection, &specular);
+
+	calculate_frad(lightRef, lightDistance, &frad);
+	v3_add(&diffuse, &specular, contributionRef);
+	v3_scale(contributionRef, frad * fang, contributionRef);
+	return TRUE;
+}
+
+/**
+ * Computes the light reaching a surface point seen along a ray and the reflection and refraction rays
+ * it spawns, without tracing them
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene
+ * @param primitiveHitRef - The primitive hit
+ * @param positionRef - The hit position
+ * @param normalRef - The surface normal at the hit position
+ * @param foundColor - The color of the lights at the point
+ * @param depth - The recursion depth of the ray
+ * @param secondaryRef - Set to the rays to trace and how their colors are blended in by blend_secondary
+ * @return 0 if success, otherwise a failure occurred
+ */
+int shade_direct(V3 *rayDirectionRef, Scene *sceneRef, Primitive *primitiveHitRef, V3 *positionRef, V3 *normalRef, V3 *foundColor,
+				 int depth, SecondaryRays *secondaryRef) {
+	foundColor->array[0] = 0;
+	foundColor->array[1] = 0;
+	foundColor->array[2] = 0;
+	secondaryRef->reflect = FALSE;
+	secondaryRef->refract = FALSE;
+
 	if (primitiveHitRef != NULL) {
 		// ambient light
 		V3 color = {0, 0, 0};
 
-		V3 newRayOrigin;
-		// Calculate our newRayOrigin
-		v3_scale(rayDirectionRef, primitive_t, &newRayOrigin);
-		v3_add(rayOriginRef, &newRayOrigin, &newRayOrigin);
-
+		// The refraction ray moves the origin, so work on a copy of the hit position
+		V3 newRayOrigin = *positionRef;
+		V3 normal = *normalRef;
 
-		V3 hitToLightRayDirection;
 		V3 rayReflectionDirection;
 		double reflectivity;
 		double refractivity;
 		double ior;
-		V3 normal;
 		V3 colorDiffuse;
 		V3 colorSpecular;
-		V3 lightColor;
 		V3 lightContribution;
-		V3 diffuse;
-		V3 specular;
-		double frad;
-		double fang;
-
-		switch(primitiveHitRef->type) {
-			case PLANE_T:
-				reflectivity = primitiveHitRef->data.plane.reflectivity;
-				refractivity = primitiveHitRef->data.plane.refractivity;
-				ior = primitiveHitRef->data.plane.ior;
-				normal = primitiveHitRef->data.plane.normal;
-				colorDiffuse = primitiveHitRef->data.plane.diffuseColor;
-				colorSpecular = primitiveHitRef->data.plane.specularColor;
-
-				break;
-			case SPHERE_T:
-				reflectivity = primitiveHitRef->data.sphere.reflectivity;
-				refractivity = primitiveHitRef->data.sphere.refractivity;
-				ior = primitiveHitRef->data.sphere.ior;
-
-				// Calculate normal
-				v3_subtract(&newRayOrigin, &primitiveHitRef->data.sphere.position, &normal);
-				v3_normalize(&normal, &normal);
-
-				colorDiffuse = primitiveHitRef->data.sphere.diffuseColor;
-				colorSpecular = primitiveHitRef->data.sphere.specularColor;
-				break;
-		}
-
-		// Shadow test
-		for (int i = 0; i < sceneRef->lightsLength; i++) {
-			Light *lightRef;
-			lightRef = sceneRef->lights[i];
-			double light_t = INFINITY;
-			double lightDistance = INFINITY;
-			V3 lightPosition;
-
-			// Figure out hitToLightRayDirection
-			switch (lightRef->type) {
-				case POINTLIGHT_T:
-					lightPosition = lightRef->data.pointLight.position;
-					lightColor = lightRef->data.pointLight.color;
-					v3_subtract(&lightPosition, &newRayOrigin, &hitToLightRayDirection);
-					v3_normalize(&hitToLightRayDirection, &hitToLightRayDirection);
-					v3_distance(&lightPosition, &newRayOrigin, &lightDistance);
-					break;
-				case SPOTLIGHT_T:
-					lightPosition = lightRef->data.spotLight.position;
-					lightColor = lightRef->data.spotLight.color;
-					v3_subtract(&lightPosition, &newRayOrigin, &hitToLightRayDirection);
-					v3_normalize(&hitToLightRayDirection, &hitToLightRayDirection);
-					v3_distance(&lightPosition, &newRayOrigin, &lightDistance);
-					break;
-			}
 
-			// See if this should be in shadow
-			for (int j = 0; j < sceneRef->primitivesLength; j++) {
-				possible_t = INFINITY;
-				primitiveRef = sceneRef->primitives[j];
-
-				// Skip the current object
-				if (primitiveRef == primitiveHitRef)
-					continue;
-
-				switch(primitiveRef->type) {
-					case PLANE_T:
-						possible_t = intersect_plane(&primitiveRef->data.plane, &newRayOrigin, &hitToLightRayDirection);
-						break;
-					case SPHERE_T:
-						possible_t = intersect_sphere(&primitiveRef->data.sphere, &newRayOrigin, &hitToLightRayDirection);
-						break;
-				}
-				// Set the new possible shadow
-				if (possible_t > 0 && possible_t < lightDistance) {
-					light_t = possible_t;
-					break;
+		// The surface is lit by the material of the primitive from the scene's material table
+		Material *materialRef = &sceneRef->materials[primitiveHitRef->material];
+		reflectivity = materialRef->reflectivity;
+		refractivity = materialRef->refractivity;
+		ior = materialRef->ior;
+		colorDiffuse = materialRef->diffuseColor;
+		colorSpecular = materialRef->specularColor;
+
+		// Light the point through the light tree when the scene has one, either with every light it
+		// can not rule out or with a few lights picked by importance
+		LightTree *lightTreeRef = sceneRef->lightTreeRef;
+		TileLight *tileLights = depth == 0 ? threadCameraLights : NULL;
+		int *gatheredLights = lightTreeRef != NULL ? thread_light_buffer(sceneRef->lightsLength) : NULL;
+		if (lightTreeRef != NULL && threadLightSamples > 0) {
+			uint64_t state = light_sample_seed(&newRayOrigin, depth);
+			for (int i = 0; i < threadLightSamples; i++) {
+				double pdf;
+				int light = light_tree_sample(lightTreeRef, sceneRef, &newRayOrigin, &normal, &state, &pdf);
+				if (light >= 0 && shade_light(rayDirectionRef, sceneRef, primitiveHitRef, sceneRef->lights[light], &newRayOrigin,
+											  &normal, &colorDiffuse, &colorSpecular, &lightContribution,
+											  tileLights != NULL ? &tileLights[light] : NULL) == TRUE) {
+					v3_scale(&lightContribution, 1 / (pdf * threadLightSamples), &lightContribution);
+					v3_add(&color, &lightContribution, &color);
 				}
 			}
-
-			if (light_t != INFINITY)
-				// Our light is in shadow
-				continue;
-
-			// Calculate rayReflectionDirection
-			v3_reflect(&hitToLightRayDirection, &normal, &rayReflectionDirection);
-
-			// Get diffuse color contribution
-			calculate_diffuse(&normal, &hitToLightRayDirection, &colorDiffuse, &lightColor, &diffuse);
-			// Get specular color contribution
-			calculate_specular(rayDirectionRef, &rayReflectionDirection, &colorSpecular, &lightColor, &normal, &hitToLightRayDirection, &specular);
-
-			calculate_frad(lightRef, lightDistance, &frad);
-			calculate_fang(lightRef, &hitToLightRayDirection, &fang);
-			v3_add(&diffuse, &specular, &lightContribution);
-			v3_scale(&lightContribution, frad * fang, &lightContribution);
-			v3_add(&color, &lightContribution, &color);
+		}
+		else if (gatheredLights != NULL) {
+			int gatheredLength = light_tree_gather(lightTreeRef, &newRayOrigin, &normal, gatheredLights);
+			STATS_ADD(lightsCulled, sceneRef->lightsLength - gatheredLength);
+
+			// Add the lights up in scene order so the color matches the loop over every light
+			qsort(gatheredLights, gatheredLength, sizeof(int), compare_light_index);
+			for (int i = 0; i < gatheredLength; i++) {
+				if (shade_light(rayDirectionRef, sceneRef, primitiveHitRef, sceneRef->lights[gatheredLights[i]], &newRayOrigin,
+								&normal, &colorDiffuse, &colorSpecular, &lightContribution,
+								tileLights != NULL ? &tileLights[gatheredLights[i]] : NULL) == TRUE)
+					v3_add(&color, &lightContribution, &color);
+			}
+		}
+		else {
+			for (int i = 0; i < sceneRef->lightsLength; i++) {
+				if (shade_light(rayDirectionRef, sceneRef, primitiveHitRef, sceneRef->lights[i], &newRayOrigin,
+								&normal, &colorDiffuse, &colorSpecular, &lightContribution,
+								tileLights != NULL ? &tileLights[i] : NULL) == TRUE)
+					v3_add(&color, &lightContribution, &color);
+			}
 		}
 
 		v3_add(&color, foundColor, foundColor);
 
-		if (depth < MAX_RECURSE_DEPTH) {
-			V3 reflectionColor;
-			V3 refractionColor;
-
+		if (depth < threadMaxDepth) {
             // Do refrlectivity
 			if (reflectivity > 0) {
-                V3 rayReflectionExit;
-
                 // Calculate the reflection
 				v3_reflect(rayDirectionRef, &normal, &rayReflectionDirection);
 
                 // Scale away from the object slightly
-                v3_scale(&rayReflectionDirection, 0.0001, &rayReflectionExit);
-                v3_add(&newRayOrigin, &rayReflectionDirection, &rayReflectionExit);
-
-                // Find the color of the reflection
-				shoot_rec(&rayReflectionExit, &rayReflectionDirection, sceneRef, &reflectionColor, depth + 1, NULL);
+                v3_scale(&rayReflectionDirection, 0.0001, &secondaryRef->reflectionOrigin);
+                v3_add(&newRayOrigin, &rayReflectionDirection, &secondaryRef->reflectionOrigin);
 
-                // Scale the found reflection color by the reflection factor
-				v3_scale(&reflectionColor, reflectivity, &reflectionColor);
-
-                // Add the reflection color to the total color
-				v3_add(&reflectionColor, foundColor, foundColor);
+				secondaryRef->reflect = TRUE;
+				secondaryRef->reflectivity = reflectivity;
+				secondaryRef->reflectionDirection = rayReflectionDirection;
 			}
 
 			if (refractivity > 0) {
-				v3_scale(foundColor, 1 - refractivity, foundColor);
-
 				if (primitiveHitRef->type == SPHERE_T) {
 					double c1, c2;
 					V3 d1;
@@ -305,11 +1617,10 @@ int shoot_rec(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, V3 *foundC
 					v3_add(&newRayOrigin, &rayRefractionExit, &newRayOrigin);
 				}
 
-				shoot_rec(&newRayOrigin, rayDirectionRef, sceneRef, &refractionColor, depth + 1, primitiveHitRef);
-
-				v3_scale(&refractionColor, refractivity, &refractionColor);
-
-				v3_add(&refractionColor, foundColor, foundColor);
+				// The refraction ray keeps the direction of the ray and skips the primitive it leaves
+				secondaryRef->refract = TRUE;
+				secondaryRef->refractivity = refractivity;
+				secondaryRef->refractionOrigin = newRayOrigin;
 			}
 		}
 	}
@@ -317,6 +1628,62 @@ int shoot_rec(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, V3 *foundC
 	return 0;
 }
 
+/**
+ * Blends the colors found by the rays of shade_direct into the color of the point
+ * @param secondaryRef - The rays spawned at the point
+ * @param reflectionColor - The color found by the reflection ray, if one was spawned
+ * @param refractionColor - The color found by the refraction ray, if one was spawned
+ * @param foundColor - The color of the lights at the point, the blended color on return
+ */
+void blend_secondary(SecondaryRays *secondaryRef, V3 *reflectionColor, V3 *refractionColor, V3 *foundColor) {
+	if (secondaryRef->reflect) {
+		// Scale the found reflection color by the reflection factor
+		v3_scale(reflectionColor, secondaryRef->reflectivity, reflectionColor);
+
+		// Add the reflection color to the total color
+		v3_add(reflectionColor, foundColor, foundColor);
+	}
+
+	if (secondaryRef->refract) {
+		v3_scale(foundColor, 1 - secondaryRef->refractivity, foundColor);
+		v3_scale(refractionColor, secondaryRef->refractivity, refractionColor);
+		v3_add(refractionColor, foundColor, foundColor);
+	}
+}
+
+/**
+ * Computes the color of a surface point seen along a ray, the part of shade_hit which does not depend
+ * on how the point was found
+ * @param rayDirectionRef - The direction of the ray
+ * @param sceneRef - A reference to the current scene
+ * @param primitiveHitRef - The primitive hit
+ * @param positionRef - The hit position
+ * @param normalRef - The surface normal at the hit position
+ * @param foundColor - The color found
+ * @param depth - The recursion depth of the ray
+ * @return 0 if success, otherwise a failure occurred
+ */
+int shade_surface(V3 *rayDirectionRef, Scene *sceneRef, Primitive *primitiveHitRef, V3 *positionRef, V3 *normalRef, V3 *foundColor, int depth) {
+	SecondaryRays secondary;
+	V3 reflectionColor;
+	V3 refractionColor;
+
+	shade_direct(rayDirectionRef, sceneRef, primitiveHitRef, positionRef, normalRef, foundColor, depth, &secondary);
+
+	// Find the colors of the reflection and the refraction
+	if (secondary.reflect) {
+		STATS_INC(reflectionRays);
+		shoot_rec(&secondary.reflectionOrigin, &secondary.reflectionDirection, sceneRef, &reflectionColor, depth + 1, NULL);
+	}
+	if (secondary.refract) {
+		STATS_INC(refractionRays);
+		shoot_rec(&secondary.refractionOrigin, rayDirectionRef, sceneRef, &refractionColor, depth + 1, primitiveHitRef);
+	}
+	blend_secondary(&secondary, &reflectionColor, &refractionColor, foundColor);
+
+	return 0;
+}
+
 
 /**
  * Clamp a value between 0 and 1
@@ -331,6 +1698,36 @@ double clamp(double a) {
 	return a;
 }
 
+/**
+ * Bound the reach of every light from its radial attenuation, a light is ignored at distances where
+ * its brightest channel is attenuated below the cutoff
+ * @param sceneRef - The scene whose lights are bounded
+ * @param cutoff - The dimmest light intensity which still counts, 0 keeps every light unbounded
+ */
+void scene_bake_light_bounds(Scene *sceneRef, double cutoff) {
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		Light *lightRef = sceneRef->lights[i];
+		PointLight *pointLightRef = &lightRef->data.pointLight;
+		double a2 = pointLightRef->radialA2;
+		double a1 = pointLightRef->radialA1;
+		double a0 = pointLightRef->radialA0;
+		double brightest = fmax(pointLightRef->color.array[0], fmax(pointLightRef->color.array[1], pointLightRef->color.array[2]));
+
+		lightRef->influenceRadius = INFINITY;
+		if (cutoff <= 0)
+			continue;
+
+		// Solve brightest / (a2*d^2 + a1*d + a0) = cutoff for the distance d, the constants are never negative
+		double falloff = brightest / cutoff;
+		if (falloff <= a0)
+			lightRef->influenceRadius = 0;
+		else if (a2 > 0)
+			lightRef->influenceRadius = (-a1 + sqrt(a1*a1 + 4*a2*(falloff - a0))) / (2*a2);
+		else if (a1 > 0)
+			lightRef->influenceRadius = (falloff - a0) / a1;
+	}
+}
+
 /**
  * Calculate the radial attenuation
  * @param light - The light to calculate for
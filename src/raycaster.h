@@ -5,15 +5,23 @@
 #ifndef CS430_PROJECT_2_BASIC_RAYCASTER_RAYTRACER_H
 #define CS430_PROJECT_2_BASIC_RAYCASTER_RAYTRACER_H
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include "3dmath.h"
 #include "imaging.h"
 
+#define DEFAULT_TILE_SIZE 32
+#define SPARSE_COLOR_THRESHOLD 16
+#define SPARSE_DEPTH_THRESHOLD 0.1
+
 /**
  * Supported Primitive Types
  */
 typedef enum PrimitiveType_t {
 	SPHERE_T,
-	PLANE_T
+	PLANE_T,
+	MESH_T
 } PrimitiveType_t;
 
 /**
@@ -24,6 +32,25 @@ typedef enum LightType_t {
 	SPOTLIGHT_T
 } LightType_t;
 
+/**
+ * Supported per-pixel cost metrics
+ */
+typedef enum CostMetric_t {
+	COST_NONE_T,
+	COST_RAYS_T,
+	COST_TESTS_T,
+	COST_TIME_T
+} CostMetric_t;
+
+/**
+ * Supported orders to hand out tiles and trace the pixels of a tile in
+ */
+typedef enum Traversal_t {
+	TRAVERSAL_SCANLINE_T,
+	TRAVERSAL_MORTON_T,
+	TRAVERSAL_HILBERT_T
+} Traversal_t;
+
 /**
  * Camera Struct
  */
@@ -33,39 +60,51 @@ typedef struct Camera {
 } Camera;
 
 /**
- * Sphere Struct
+ * Material Struct - how a surface is lit, shared by every primitive made of it
  */
-typedef struct Sphere {
+typedef struct Material {
 	V3 diffuseColor;
 	V3 specularColor;
-	V3 position;
-	double radius;
 	double reflectivity;
 	double refractivity;
 	double ior;
+} Material;
+
+/**
+ * Sphere Struct
+ */
+typedef struct Sphere {
+	V3 position;
+	double radius;
 } Sphere;
 
 /**
  * Plane Struct
  */
 typedef struct Plane {
-	V3 diffuseColor;
-	V3 specularColor;
 	V3 position;
 	V3 normal;
-	double reflectivity;
-	double refractivity;
-	double ior;
 } Plane;
 
+typedef struct MeshData MeshData;
+
 /**
- * Primitive Struct
+ * Mesh Struct, the triangles live in the shared buffers of dataRef so every mesh costs one primitive
+ */
+typedef struct Mesh {
+	MeshData *dataRef;
+} Mesh;
+
+/**
+ * Primitive Struct, only the geometry and the index of its material in the scene's material table
  */
 typedef struct Primitive {
 	PrimitiveType_t type;
+	uint32_t material;
 	union {
 		Plane plane;
 		Sphere sphere;
+		Mesh mesh;
 	} data;
 } Primitive;
 
@@ -96,8 +135,11 @@ typedef struct SpotLight {
 	V3 direction;
 } SpotLight;
 
+typedef struct ShadowMap ShadowMap;
+
 /**
- * Light Struct
+ * Light Struct, shadowMapRef is NULL when shadows are traced, influenceRadius is the distance past which the light is dimmer than the light cutoff
+ * and is INFINITY when every distance counts
  */
 typedef struct Light {
 	LightType_t type;
@@ -105,28 +147,205 @@ typedef struct Light {
 		PointLight pointLight;
 		SpotLight spotLight;
 	} data;
+	double influenceRadius;
+	ShadowMap *shadowMapRef;
 } Light;
 
+typedef struct LightTree LightTree;
+typedef struct PrimitivePack PrimitivePack;
+
 /**
- * Scene Struct
+ * Scene Struct, the primitives are allocated in one block and share the materials of the material
+ * table, lightTreeRef is NULL when shading loops over every light and packRef is NULL when rays test
+ * the primitives one by one
  */
 typedef struct Scene {
 	Camera camera;
 	Primitive** primitives;
 	Light** lights;
+	Material *materials;
 	int primitivesLength;
 	int lightsLength;
+	int materialsLength;
+	LightTree *lightTreeRef;
+	PrimitivePack *packRef;
 } Scene;
 
+/**
+ * Secondary Rays Struct - the reflection and refraction rays spawned at a shaded point and the factors
+ * their colors are blended in with, the refraction ray keeps the direction of the ray that was shaded
+ */
+typedef struct SecondaryRays {
+	int reflect;
+	int refract;
+	double reflectivity;
+	double refractivity;
+	V3 reflectionOrigin;
+	V3 reflectionDirection;
+	V3 refractionOrigin;
+} SecondaryRays;
+
+/**
+ * G-buffer modes, a capture records the camera hits while rendering and a relight shades recorded
+ * hits instead of tracing camera rays
+ */
+typedef enum GBufferMode_t {
+	GBUFFER_NONE_T,
+	GBUFFER_CAPTURE_T,
+	GBUFFER_RELIGHT_T
+} GBufferMode_t;
+
+/**
+ * Render Quality Struct - how far a render with a time budget got
+ */
+typedef struct RenderQuality {
+	int level;
+	int levels;
+	const char *levelName;
+	double nextLevelFraction;
+} RenderQuality;
+
+/**
+ * Called by the render threads as tiles finish, one call at a time
+ * @param tilesRendered - The number of tiles finished so far
+ * @param tilesLength - The number of tiles of the render
+ * @param dataRef - The progress data of the render options
+ */
+typedef void (*RenderProgress)(int tilesRendered, int tilesLength, void *dataRef);
+
 // Define needed structure prototypes
 typedef struct JSONArray JSONArray;
+typedef struct RenderStats RenderStats;
+typedef struct TraceRecorder TraceRecorder;
+typedef struct Checkpoint Checkpoint;
+typedef struct TileBins TileBins;
+typedef struct GBuffer GBuffer;
+
+/**
+ * Render Options Struct
+ */
+typedef struct RenderOptions {
+	CostMetric_t costMetric;
+	Costmap *costmapRef;
+	int threads;
+	int processes;
+	int tileSize;
+	int sparseStep;
+	ImageRegion region;
+	RenderStats *statsRef;
+	TraceRecorder *traceRef;
+	Checkpoint *checkpointRef;
+	double deadline;
+	RenderQuality *qualityRef;
+	GBufferMode_t gbufferMode;
+	GBuffer *gbufferRef;
+	int lightSamples;
+	int wavefront;
+	Traversal_t traversal;
+	RenderProgress progress;
+	void *progressDataRef;
+} RenderOptions;
+
+/**
+ * Render Context Struct - the state of a render shared by all of its workers. Workers write into the
+ * framebuffer, which holds the rendered region tile by tile: every tile is stored whole, row by row, after
+ * the rows of tiles above it and the tiles to its left in its own row of tiles, so a tile is one contiguous
+ * run of memory and the framebuffer is exactly as large as the image.
+ */
+typedef struct RenderContext {
+	Scene *sceneRef;
+	Image *imageRef;
+	RGBApixel *framebuffer;
+	RenderOptions *optionsRef;
+	CostMetric_t costMetric;
+	int imageWidth;
+	int imageHeight;
+	int frameWidth;
+	int frameHeight;
+	int originX;
+	int originY;
+	double pixelWidth;
+	double pixelHeight;
+	int tileSize;
+	int tilesX;
+	int tilesY;
+	int tilesLength;
+	int *tileOrder;
+	int *pixelOrder;
+	TileBins *tileBinsRef;
+	atomic_int nextTile;
+	atomic_int *tilesDone;
+	atomic_int tilesRendered;
+	int sampleStep;
+	int sparseStep;
+	int maxDepth;
+	int lightSamples;
+	double deadline;
+	pthread_mutex_t statsLock;
+} RenderContext;
+
+/**
+ * Render Worker Struct
+ */
+typedef struct RenderWorker {
+	RenderContext *contextRef;
+	int index;
+} RenderWorker;
+
+/**
+ * The pixels of the tile starting at a column and row of the rendered region, stored row by row with
+ * the width of the tile
+ * @param contextRef - The render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @return The first pixel of the tile in the framebuffer
+ */
+static inline RGBApixel *render_tile_pixels(RenderContext *contextRef, int tileX, int tileY) {
+	int tileHeight = contextRef->imageHeight - tileY < contextRef->tileSize ? contextRef->imageHeight - tileY : contextRef->tileSize;
+	return &contextRef->framebuffer[(size_t) tileY*contextRef->imageWidth + (size_t) tileX*tileHeight];
+}
+
+/**
+ * A pixel of the rendered region in the framebuffer
+ * @param contextRef - The render
+ * @param x - The column of the pixel
+ * @param y - The row of the pixel
+ * @return The pixel
+ */
+static inline RGBApixel *render_pixel(RenderContext *contextRef, int x, int y) {
+	int tileX = x - x % contextRef->tileSize;
+	int tileY = y - y % contextRef->tileSize;
+	int tileWidth = contextRef->imageWidth - tileX < contextRef->tileSize ? contextRef->imageWidth - tileX : contextRef->tileSize;
+	return &render_tile_pixels(contextRef, tileX, tileY)[(y - tileY)*tileWidth + x - tileX];
+}
 
-int raycast(Scene *sceneRef, Image* imageRef, int imageWidth, int imageHeight);
+void render_options_init(RenderOptions *optionsRef);
+int render_context_init(RenderContext *contextRef, Scene *sceneRef, Image *imageRef, int frameWidth, int frameHeight, RenderOptions *optionsRef);
+int render_tile(RenderContext *contextRef, int tileIndex);
+int render_context_run(RenderContext *contextRef, int threads);
+int render_context_run_budget(RenderContext *contextRef, int threads, RenderQuality *qualityRef);
+void render_context_linearize(RenderContext *contextRef, RGBApixel *pixmapRef);
+void render_context_free(RenderContext *contextRef);
+int raycast(Scene *sceneRef, Image* imageRef, int imageWidth, int imageHeight, RenderOptions *optionsRef);
 int shade(RGBAColor* colorRef, RGBApixel *pixel);
 int shoot(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RGBAColor *foundColor);
+void color_to_rgba(V3 *colorRef, RGBAColor *foundColor);
+int shoot_primary(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, RGBAColor *foundColor, double *distanceRef, Primitive **hitRef);
+Primitive *find_closest_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, Primitive *ignore, double *distanceRef);
+Primitive *find_closest_packed_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, PrimitivePack *packRef,
+								   Primitive *ignore, double *distanceRef);
+Primitive *find_closest_unpacked_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, Primitive *ignore,
+									 Primitive *primitiveHitRef, int closestIndex, double *distanceRef);
+int shade_hit(V3 *rayOriginRef, V3 *rayDirectionRef, Scene *sceneRef, Primitive *primitiveHitRef, double primitive_t, V3 *foundColor, int depth);
+void surface_normal(Primitive *primitiveRef, V3 *positionRef, V3 *normalRef);
+int shade_surface(V3 *rayDirectionRef, Scene *sceneRef, Primitive *primitiveHitRef, V3 *positionRef, V3 *normalRef, V3 *foundColor, int depth);
+int shade_direct(V3 *rayDirectionRef, Scene *sceneRef, Primitive *primitiveHitRef, V3 *positionRef, V3 *normalRef, V3 *foundColor,
+				 int depth, SecondaryRays *secondaryRef);
+void blend_secondary(SecondaryRays *secondaryRef, V3 *reflectionColor, V3 *refractionColor, V3 *foundColor);
 double intersect_sphere(Sphere *sphereRef, V3 *rayOriginRef, V3 *rayDirectionRef);
 double intersect_plane(Plane *planeRef, V3 *rayOriginRef, V3 *rayDirectionRef);
 double clamp(double a);
+void scene_bake_light_bounds(Scene *sceneRef, double cutoff);
 void calculate_frad(Light *light, double distance, double *result);
 void calculate_fang(Light *light, V3 *V0, double *result);
 void calculate_diffuse(V3 *N, V3 *L, V3 *K, V3* I, V3* result);
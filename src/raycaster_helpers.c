@@ -8,6 +8,9 @@
 #include "json.h"
 #include "3dmath.h"
 #include "raycaster.h"
+#include "mesh.h"
+#include "material.h"
+#include "raycaster_helpers.h"
 
 /**
  * Converts a JSONArray to a V3 vector with error checking
@@ -51,6 +54,9 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 	JSONObject *JSONObjectTempRef;
 	JSONValue *JSONValueTempRef;
 	JSONArray *JSONSceneArrayRef;
+	MaterialTable materialTable;
+	Material material;
+	Light *lightRef = NULL;
 
 	// Make sure that we were passed a JSONArray
 	if (JSONValueSceneRef->type != ARRAY_T) {
@@ -59,12 +65,30 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 	}
 	JSONSceneArrayRef = JSONValueSceneRef->data.dataArray;
 
-	int size = JSONSceneArrayRef->length - 1;
-	sceneRef->primitives = malloc(sizeof(Primitive*) * size);
-	sceneRef->lights = malloc(sizeof(Light*) * size);
-
+	// Every entry but the camera is a primitive or a light, the camera count is checked as entries are read
+	int size = JSONSceneArrayRef->length;
 	int primitivesLength = 0;
 	int lightsLength = 0;
+	int camerasLength = 0;
+	sceneRef->primitives = NULL;
+	sceneRef->lights = NULL;
+	sceneRef->primitivesLength = 0;
+	sceneRef->lightsLength = 0;
+	sceneRef->materials = NULL;
+	sceneRef->materialsLength = 0;
+	sceneRef->lightTreeRef = NULL;
+	sceneRef->packRef = NULL;
+
+	// Primitives are small and kept together, their materials are interned into one table
+	if (material_table_init(&materialTable) != 0)
+		return 1;
+	Primitive *primitiveStore = malloc(sizeof(Primitive) * (size > 0 ? size : 1));
+	sceneRef->primitives = malloc(sizeof(Primitive*) * (size > 0 ? size : 1));
+	sceneRef->lights = malloc(sizeof(Light*) * (size > 0 ? size : 1));
+	if (primitiveStore == NULL || sceneRef->primitives == NULL || sceneRef->lights == NULL) {
+		fprintf(stderr, "Error: Could not allocate the scene primitives\n");
+		goto fail;
+	}
 	for (int i = 0; i < JSONSceneArrayRef->length; i++) {
 		// Look at the objects we loaded in JSON
 		if (JSONSceneArrayRef->values[i]->type == OBJECT_T) {
@@ -73,29 +97,33 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 
 			if (JSONObject_get_value("type", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-				return 1;
+				goto fail;
 			}
 			if (JSONValueTempRef->type != STRING_T) {
 				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-				return 1;
+				goto fail;
 			}
 
 
 			if (strcmp(JSONValueTempRef->data.dataString, "camera") == 0) {
 				// We found a camera
+				if (++camerasLength > 1) {
+					fprintf(stderr, "Error: Input scene JSON file must contain exactly one camera\n");
+					goto fail;
+				}
 
 				// Read the height
 				if (JSONObject_get_value("height", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != NUMBER_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->data.dataNumber < 0) {
 					fprintf(stderr, "Error: Negative camera height is not allowed\n");
-					return 1;
+					goto fail;
 				}
 				sceneRef->camera.height = JSONValueTempRef->data.dataNumber;
 
@@ -103,102 +131,102 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 
 				if (JSONObject_get_value("width", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != NUMBER_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->data.dataNumber < 0) {
 					fprintf(stderr, "Error: Negative camera width is not allowed\n");
-					return 1;
+					goto fail;
 				}
 
 				sceneRef->camera.width = JSONValueTempRef->data.dataNumber;
 			}
 			else if (strcmp(JSONValueTempRef->data.dataString, "sphere") == 0) {
 				// We found a sphere
-				sceneRef->primitives[primitivesLength] = malloc(sizeof(Primitive));
+				sceneRef->primitives[primitivesLength] = &primitiveStore[primitivesLength];
 				sceneRef->primitives[primitivesLength]->type = SPHERE_T;
 
 				// Read the diffuse color
 				if (JSONObject_get_value("diffuse_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.sphere.diffuseColor) != 0) {
-					return 1;
+				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &material.diffuseColor) != 0) {
+					goto fail;
 				}
 
 				// Check colors
 				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.sphere.diffuseColor.array[j] < 0) {
+					if (material.diffuseColor.array[j] < 0) {
 						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
+						goto fail;
 					}
-					if (sceneRef->primitives[primitivesLength]->data.sphere.diffuseColor.array[j] > 1) {
+					if (material.diffuseColor.array[j] > 1) {
 						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
+						goto fail;
 					}
 				}
 
 				// Read the specular color
 				if (JSONObject_get_value("specular_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.sphere.specularColor) != 0) {
-					return 1;
+				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &material.specularColor) != 0) {
+					goto fail;
 				}
 
 				// Check colors
 				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.sphere.specularColor.array[j] < 0) {
+					if (material.specularColor.array[j] < 0) {
 						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
+						goto fail;
 					}
-					if (sceneRef->primitives[primitivesLength]->data.sphere.specularColor.array[j] > 1) {
+					if (material.specularColor.array[j] > 1) {
 						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
+						goto fail;
 					}
 				}
 
 				// Read the position
 				if (JSONObject_get_value("position", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
 				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.sphere.position) != 0) {
-					return 1;
+					goto fail;
 				}
 
 				// Read the radius
 				if (JSONObject_get_value("radius", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != NUMBER_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->data.dataNumber < 0) {
 					fprintf(stderr, "Error: Negative sphere radius is not allowed\n");
-					return 1;
+					goto fail;
 				}
 
 				sceneRef->primitives[primitivesLength]->data.sphere.radius = JSONValueTempRef->data.dataNumber;
@@ -207,17 +235,17 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 				if (JSONObject_get_value("reflectivity", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Refractivity must be a number\n");
-						return 1;
+						goto fail;
 					}
 					if (JSONValueTempRef->data.dataNumber < 0) {
 						fprintf(stderr, "Error: Negative reflectivity is not allowed\n");
-						return 1;
+						goto fail;
 					}
 
-					sceneRef->primitives[primitivesLength]->data.sphere.reflectivity = JSONValueTempRef->data.dataNumber;
+					material.reflectivity = JSONValueTempRef->data.dataNumber;
 				}
 				else {
-					sceneRef->primitives[primitivesLength]->data.sphere.reflectivity = 0;
+					material.reflectivity = 0;
 				}
 
 
@@ -225,121 +253,123 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 				if (JSONObject_get_value("refractivity", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Refractivity must be a number\n");
-						return 1;
+						goto fail;
 					}
 					if (JSONValueTempRef->data.dataNumber < 0) {
 						fprintf(stderr, "Error: Negative refractivity is not allowed\n");
-						return 1;
+						goto fail;
 					}
 
-					sceneRef->primitives[primitivesLength]->data.sphere.refractivity = JSONValueTempRef->data.dataNumber;
+					material.refractivity = JSONValueTempRef->data.dataNumber;
 				}
 				else {
-					sceneRef->primitives[primitivesLength]->data.sphere.refractivity = 0;
+					material.refractivity = 0;
 				}
 
 				// Read the ior
 				if (JSONObject_get_value("ior", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Ior must be a number\n");
-						return 1;
+						goto fail;
 					}
 					if (JSONValueTempRef->data.dataNumber < 0) {
 						fprintf(stderr, "Error: Negative ior is not allowed\n");
-						return 1;
+						goto fail;
 					}
 
-					sceneRef->primitives[primitivesLength]->data.sphere.ior = JSONValueTempRef->data.dataNumber;
+					material.ior = JSONValueTempRef->data.dataNumber;
 				}
 				else {
-					sceneRef->primitives[primitivesLength]->data.sphere.ior = 1;
+					material.ior = 1;
 				}
 
+				if (material_intern(&materialTable, &material, &sceneRef->primitives[primitivesLength]->material) != 0)
+					goto fail;
 				primitivesLength++;
 			}
 			else if (strcmp(JSONValueTempRef->data.dataString, "plane") == 0) {
 				// We found a plane
-				sceneRef->primitives[primitivesLength] = malloc(sizeof(Primitive));
+				sceneRef->primitives[primitivesLength] = &primitiveStore[primitivesLength];
 				sceneRef->primitives[primitivesLength]->type = PLANE_T;
 
 				// Read the diffuse color
 				if (JSONObject_get_value("diffuse_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.diffuseColor) != 0) {
-					return 1;
+				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &material.diffuseColor) != 0) {
+					goto fail;
 				}
 
 				// Check colors
 				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.plane.diffuseColor.array[j] < 0) {
+					if (material.diffuseColor.array[j] < 0) {
 						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
+						goto fail;
 					}
-					if (sceneRef->primitives[primitivesLength]->data.plane.diffuseColor.array[j] > 1) {
+					if (material.diffuseColor.array[j] > 1) {
 						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
+						goto fail;
 					}
 				}
 
 				// Read the specular color
 				if (JSONObject_get_value("specular_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
-				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.specularColor) != 0) {
-					return 1;
+				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &material.specularColor) != 0) {
+					goto fail;
 				}
 
 				// Check colors
 				for (int j = 0; j < 3; j++) {
-					if (sceneRef->primitives[primitivesLength]->data.plane.specularColor.array[j] < 0) {
+					if (material.specularColor.array[j] < 0) {
 						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
+						goto fail;
 					}
-					if (sceneRef->primitives[primitivesLength]->data.plane.specularColor.array[j] > 1) {
+					if (material.specularColor.array[j] > 1) {
 						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
-						return 1;
+						goto fail;
 					}
 				}
 
 				// Read the position
 				if (JSONObject_get_value("position", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
 				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.position) != 0) {
-					return 1;
+					goto fail;
 				}
 
 				// Read the normal
 				if (JSONObject_get_value("normal", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
 				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->primitives[primitivesLength]->data.plane.normal) != 0) {
-					return 1;
+					goto fail;
 				}
 
 				// Normalize the direction
@@ -350,101 +380,269 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 				if (JSONObject_get_value("reflectivity", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Refractivity must be a number\n");
-						return 1;
+						goto fail;
 					}
 					if (JSONValueTempRef->data.dataNumber < 0) {
 						fprintf(stderr, "Error: Negative reflectivity is not allowed\n");
-						return 1;
+						goto fail;
 					}
 
-					sceneRef->primitives[primitivesLength]->data.plane.reflectivity = JSONValueTempRef->data.dataNumber;
+					material.reflectivity = JSONValueTempRef->data.dataNumber;
 				}
 				else {
-					sceneRef->primitives[primitivesLength]->data.plane.reflectivity = 0;
+					material.reflectivity = 0;
 				}
 
 				// Read the refractivity
 				if (JSONObject_get_value("refractivity", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Refractivity must be a number\n");
-						return 1;
+						goto fail;
 					}
 					if (JSONValueTempRef->data.dataNumber < 0) {
 						fprintf(stderr, "Error: Negative refractivity is not allowed\n");
-						return 1;
+						goto fail;
 					}
 
-					sceneRef->primitives[primitivesLength]->data.plane.refractivity = JSONValueTempRef->data.dataNumber;
+					material.refractivity = JSONValueTempRef->data.dataNumber;
 				}
 				else {
-					sceneRef->primitives[primitivesLength]->data.plane.refractivity = 0;
+					material.refractivity = 0;
 				}
 
 				// Read the ior
 				if (JSONObject_get_value("ior", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Ior must be a number\n");
-						return 1;
+						goto fail;
 					}
 					if (JSONValueTempRef->data.dataNumber < 0) {
 						fprintf(stderr, "Error: Negative ior is not allowed\n");
-						return 1;
+						goto fail;
 					}
 
-					sceneRef->primitives[primitivesLength]->data.plane.ior = JSONValueTempRef->data.dataNumber;
+					material.ior = JSONValueTempRef->data.dataNumber;
 				}
 				else {
-					sceneRef->primitives[primitivesLength]->data.plane.ior = 1;
+					material.ior = 1;
 				}
 
+				if (material_intern(&materialTable, &material, &sceneRef->primitives[primitivesLength]->material) != 0)
+					goto fail;
+				primitivesLength++;
+			}
+			else if (strcmp(JSONValueTempRef->data.dataString, "mesh") == 0) {
+				// We found a triangle mesh, its triangles are loaded from a model file
+				V3 meshPosition = {{0, 0, 0}};
+				double meshScale = 1;
+				sceneRef->primitives[primitivesLength] = &primitiveStore[primitivesLength];
+				sceneRef->primitives[primitivesLength]->type = MESH_T;
+				sceneRef->primitives[primitivesLength]->data.mesh.dataRef = NULL;
+
+				// Read the diffuse color
+				if (JSONObject_get_value("diffuse_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
+					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+					goto fail;
+				}
+				if (JSONValueTempRef->type != ARRAY_T) {
+					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+					goto fail;
+				}
+
+				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &material.diffuseColor) != 0) {
+					goto fail;
+				}
+
+				// Check colors
+				for (int j = 0; j < 3; j++) {
+					if (material.diffuseColor.array[j] < 0) {
+						fprintf(stderr, "Error: Color cannot be negative\n");
+						goto fail;
+					}
+					if (material.diffuseColor.array[j] > 1) {
+						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+						goto fail;
+					}
+				}
+
+				// Read the specular color
+				if (JSONObject_get_value("specular_color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
+					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+					goto fail;
+				}
+				if (JSONValueTempRef->type != ARRAY_T) {
+					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+					goto fail;
+				}
+
+				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &material.specularColor) != 0) {
+					goto fail;
+				}
+
+				// Check colors
+				for (int j = 0; j < 3; j++) {
+					if (material.specularColor.array[j] < 0) {
+						fprintf(stderr, "Error: Color cannot be negative\n");
+						goto fail;
+					}
+					if (material.specularColor.array[j] > 1) {
+						fprintf(stderr, "Error: Primitive colors cannot be greater than 1.0\n");
+						goto fail;
+					}
+				}
+
+				// Read the position, the model origin is moved here
+				if (JSONObject_get_value("position", JSONObjectTempRef, &JSONValueTempRef) == 0) {
+					if (JSONValueTempRef->type != ARRAY_T) {
+						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+						goto fail;
+					}
+
+					if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &meshPosition) != 0) {
+						goto fail;
+					}
+				}
+
+				// Read the scale
+				if (JSONObject_get_value("scale", JSONObjectTempRef, &JSONValueTempRef) == 0) {
+					if (JSONValueTempRef->type != NUMBER_T) {
+						fprintf(stderr, "Error: Scale must be a number\n");
+						goto fail;
+					}
+					if (JSONValueTempRef->data.dataNumber <= 0) {
+						fprintf(stderr, "Error: Mesh scale must be positive\n");
+						goto fail;
+					}
+
+					meshScale = JSONValueTempRef->data.dataNumber;
+				}
+
+				// Read the reflectivity
+				if (JSONObject_get_value("reflectivity", JSONObjectTempRef, &JSONValueTempRef) == 0) {
+					if (JSONValueTempRef->type != NUMBER_T) {
+						fprintf(stderr, "Error: Reflectivity must be a number\n");
+						goto fail;
+					}
+					if (JSONValueTempRef->data.dataNumber < 0) {
+						fprintf(stderr, "Error: Negative reflectivity is not allowed\n");
+						goto fail;
+					}
+
+					material.reflectivity = JSONValueTempRef->data.dataNumber;
+				}
+				else {
+					material.reflectivity = 0;
+				}
+
+				// Read the refractivity
+				if (JSONObject_get_value("refractivity", JSONObjectTempRef, &JSONValueTempRef) == 0) {
+					if (JSONValueTempRef->type != NUMBER_T) {
+						fprintf(stderr, "Error: Refractivity must be a number\n");
+						goto fail;
+					}
+					if (JSONValueTempRef->data.dataNumber < 0) {
+						fprintf(stderr, "Error: Negative refractivity is not allowed\n");
+						goto fail;
+					}
+
+					material.refractivity = JSONValueTempRef->data.dataNumber;
+				}
+				else {
+					material.refractivity = 0;
+				}
+
+				// Read the ior
+				if (JSONObject_get_value("ior", JSONObjectTempRef, &JSONValueTempRef) == 0) {
+					if (JSONValueTempRef->type != NUMBER_T) {
+						fprintf(stderr, "Error: Ior must be a number\n");
+						goto fail;
+					}
+					if (JSONValueTempRef->data.dataNumber < 0) {
+						fprintf(stderr, "Error: Negative ior is not allowed\n");
+						goto fail;
+					}
+
+					material.ior = JSONValueTempRef->data.dataNumber;
+				}
+				else {
+					material.ior = 1;
+				}
+
+				// Read the model file, relative to the working directory
+				if (JSONObject_get_value("file", JSONObjectTempRef, &JSONValueTempRef) != 0) {
+					fprintf(stderr, "Error: Mesh is missing its model file\n");
+					goto fail;
+				}
+				if (JSONValueTempRef->type != STRING_T) {
+					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
+					goto fail;
+				}
+
+				if (material_intern(&materialTable, &material, &sceneRef->primitives[primitivesLength]->material) != 0)
+					goto fail;
+
+				// The mesh is loaded last, so a loaded mesh always belongs to a counted primitive
+				MeshData *meshRef = malloc(sizeof(MeshData));
+				if (meshRef == NULL || load_mesh(JSONValueTempRef->data.dataString, &meshPosition, meshScale, meshRef) != 0) {
+					free(meshRef);
+					goto fail;
+				}
+				sceneRef->primitives[primitivesLength]->data.mesh.dataRef = meshRef;
 				primitivesLength++;
 			}
 			else if (strcmp(JSONValueTempRef->data.dataString, "light") == 0) {
-				// We found a point light
-				sceneRef->lights[lightsLength] = malloc(sizeof(Light));
+				// We found a point light, it is only counted once it has been read completely
+				lightRef = malloc(sizeof(Light));
+				if (lightRef == NULL) {
+					fprintf(stderr, "Error: Could not allocate the scene lights\n");
+					goto fail;
+				}
+				sceneRef->lights[lightsLength] = lightRef;
 				sceneRef->lights[lightsLength]->type = POINTLIGHT_T;
+				sceneRef->lights[lightsLength]->influenceRadius = INFINITY;
+				sceneRef->lights[lightsLength]->shadowMapRef = NULL;
 
 				// Read the color
 				if (JSONObject_get_value("color", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
 				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->lights[lightsLength]->data.pointLight.color) != 0) {
-					return 1;
+					goto fail;
 				}
 
 				// Check colors
 				for (int j = 0; j < 3; j++) {
 					if (sceneRef->lights[lightsLength]->data.pointLight.color.array[j] < 0) {
 						fprintf(stderr, "Error: Color cannot be negative\n");
-						return 1;
+						goto fail;
 					}
 				}
 
 				// Read the position
 				if (JSONObject_get_value("position", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 				if (JSONValueTempRef->type != ARRAY_T) {
 					fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-					return 1;
+					goto fail;
 				}
 
 				if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->lights[lightsLength]->data.pointLight.position) != 0) {
-					return 1;
+					goto fail;
 				}
 
 				// Read the radialA2
 				if (JSONObject_get_value("radial-a2", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
+						goto fail;
 					}
 
 					sceneRef->lights[lightsLength]->data.pointLight.radialA2 = JSONValueTempRef->data.dataNumber;
@@ -457,7 +655,7 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 				if (JSONObject_get_value("radial-a1", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
+						goto fail;
 					}
 
 					sceneRef->lights[lightsLength]->data.pointLight.radialA1 = JSONValueTempRef->data.dataNumber;
@@ -470,7 +668,7 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 				if (JSONObject_get_value("radial-a0", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
+						goto fail;
 					}
 
 					sceneRef->lights[lightsLength]->data.pointLight.radialA0 = JSONValueTempRef->data.dataNumber;
@@ -484,21 +682,21 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 						sceneRef->lights[lightsLength]->data.pointLight.radialA1 == 0 &&
 						sceneRef->lights[lightsLength]->data.pointLight.radialA2 == 0) {
 					fprintf(stderr, "Error: Input scene light constants must have one constant not equal to 0\n");
-					return 1;
+					goto fail;
 				}
 
 				if (sceneRef->lights[lightsLength]->data.pointLight.radialA0 < 0 ||
 					sceneRef->lights[lightsLength]->data.pointLight.radialA1 < 0 ||
 					sceneRef->lights[lightsLength]->data.pointLight.radialA2 < 0) {
 					fprintf(stderr, "Error: Input scene light constants must not be negative\n");
-					return 1;
+					goto fail;
 				}
 
 				// Read the angularA0 if it exists
 				if (JSONObject_get_value("theta", JSONObjectTempRef, &JSONValueTempRef) == 0) {
 					if (JSONValueTempRef->type != NUMBER_T) {
 						fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-						return 1;
+						goto fail;
 					}
 
 					if (JSONValueTempRef->data.dataNumber != 0) {
@@ -510,32 +708,32 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 
 						if (JSONObject_get_value("angular-a0", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
+							goto fail;
 						}
 						if (JSONValueTempRef->type != NUMBER_T) {
 							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
+							goto fail;
 						}
 
 						sceneRef->lights[lightsLength]->data.spotLight.angularA0 = JSONValueTempRef->data.dataNumber;
 
 						if (sceneRef->lights[lightsLength]->data.spotLight.angularA0 < 0) {
 							fprintf(stderr, "Error: Input scene light constants must not be negative\n");
-							return 1;
+							goto fail;
 						}
 
 						// Read the direction
 						if (JSONObject_get_value("direction", JSONObjectTempRef, &JSONValueTempRef) != 0) {
 							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
+							goto fail;
 						}
 						if (JSONValueTempRef->type != ARRAY_T) {
 							fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-							return 1;
+							goto fail;
 						}
 
 						if (JSONArray_to_V3(JSONValueTempRef->data.dataArray, &sceneRef->lights[lightsLength]->data.spotLight.direction) != 0) {
-							return 1;
+							goto fail;
 						}
 
 						// Normalize the direction
@@ -544,20 +742,61 @@ int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef) {
 				}
 
 				lightsLength++;
+				lightRef = NULL;
 			}
 			else {
 				fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-				return 1;
+				goto fail;
 			}
 		}
 		else {
 			fprintf(stderr, "Error: Input scene JSON file contains invalid entries\n");
-			return 1;
+			goto fail;
 		}
 
 		sceneRef->primitivesLength = primitivesLength;
 		sceneRef->lightsLength = lightsLength;
 	}
+	if (camerasLength != 1) {
+		fprintf(stderr, "Error: Input scene JSON file must contain exactly one camera\n");
+		goto fail;
+	}
+	material_table_to_scene(&materialTable, sceneRef);
+	// Without primitives the store is not reachable through the scene
+	if (sceneRef->primitivesLength == 0)
+		free(primitiveStore);
 
 	return 0;
+
+fail:
+	// Release everything created so far, the scene is left empty
+	sceneRef->primitivesLength = primitivesLength;
+	sceneRef->lightsLength = lightsLength;
+	scene_free_meshes(sceneRef);
+	material_table_free(&materialTable);
+	free(primitiveStore);
+	free(lightRef);
+	// Every primitive lived in the store
+	sceneRef->primitivesLength = 0;
+	scene_free_primitives(sceneRef);
+	return 1;
+}
+
+/**
+ * Release the primitives and lights of a scene created by create_scene_from_JSON, its meshes, pack and
+ * materials are released by their own functions first
+ * @param sceneRef - The scene whose primitives and lights are freed
+ */
+void scene_free_primitives(Scene *sceneRef) {
+	// Every primitive lives in the block starting with the first one
+	if (sceneRef->primitivesLength > 0)
+		free(sceneRef->primitives[0]);
+	for (int i = 0; i < sceneRef->lightsLength; i++)
+		free(sceneRef->lights[i]);
+	free(sceneRef->primitives);
+	free(sceneRef->lights);
+	sceneRef->primitives = NULL;
+	sceneRef->lights = NULL;
+	sceneRef->primitivesLength = 0;
+	sceneRef->lightsLength = 0;
 }
\ No newline at end of file
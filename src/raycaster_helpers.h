@@ -10,5 +10,6 @@ typedef struct JSONArray JSONArray;
 
 int JSONArray_to_V3(JSONArray *JSONArrayRef, V3 *vectorRef);
 int create_scene_from_JSON(JSONValue *JSONValueSceneRef, Scene* sceneRef);
+void scene_free_primitives(Scene *sceneRef);
 
 #endif //CS430_PROJECT_2_BASIC_RAYCASTER_RAYCASTER_HELPERS_H
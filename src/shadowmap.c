@@ -0,0 +1,335 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "shadowmap.h"
+#include "constants.h"
+#include "mesh.h"
+
+// Texels are baked in square blocks which share a list of the primitives they may hit
+#define SHADOW_MAP_BLOCK 16
+#define SHADOW_MAP_BLOCK_ROWS(mapRef) (((mapRef)->resolution + SHADOW_MAP_BLOCK - 1) / SHADOW_MAP_BLOCK)
+
+/**
+ * The shared state of a bake, every row of blocks of every face of every map is one job
+ */
+typedef struct ShadowBake {
+	Scene *sceneRef;
+	ShadowMap **maps;
+	int mapsLength;
+	int rowsLength;
+	atomic_int nextRow;
+} ShadowBake;
+
+/**
+ * Find the direction through the center of a texel of a map
+ */
+static void shadow_map_texel_direction(ShadowMap *mapRef, int face, int x, int y, V3 *directionRef) {
+	double u = (x + 0.5) / mapRef->resolution * 2 - 1;
+	double v = (y + 0.5) / mapRef->resolution * 2 - 1;
+
+	if (mapRef->faces == 1) {
+		V3 offset;
+		v3_scale(&mapRef->right, u * mapRef->tanHalfAngle, directionRef);
+		v3_scale(&mapRef->up, v * mapRef->tanHalfAngle, &offset);
+		v3_add(directionRef, &offset, directionRef);
+		v3_add(directionRef, &mapRef->forward, directionRef);
+	}
+	else {
+		// Faces are +X, -X, +Y, -Y, +Z, -Z, u and v follow the next two axes
+		int axis = face / 2;
+		directionRef->array[axis] = face % 2 == 0 ? 1 : -1;
+		directionRef->array[(axis + 1) % 3] = u;
+		directionRef->array[(axis + 2) % 3] = v;
+	}
+	v3_normalize(directionRef, directionRef);
+}
+
+/**
+ * Find the texel of a map a direction from its light falls in
+ * @return The index of the texel, -1 when the direction is outside a perspective map
+ */
+static int shadow_map_texel(ShadowMap *mapRef, V3 *directionRef) {
+	double u, v;
+	int face = 0;
+
+	if (mapRef->faces == 1) {
+		double x, y, z;
+		v3_dot(directionRef, &mapRef->right, &x);
+		v3_dot(directionRef, &mapRef->up, &y);
+		v3_dot(directionRef, &mapRef->forward, &z);
+		if (z <= 0)
+			return -1;
+		u = x / (z * mapRef->tanHalfAngle);
+		v = y / (z * mapRef->tanHalfAngle);
+		if (u < -1 || u > 1 || v < -1 || v > 1)
+			return -1;
+	}
+	else {
+		int axis = 0;
+		for (int k = 1; k < 3; k++) {
+			if (fabs(directionRef->array[k]) > fabs(directionRef->array[axis]))
+				axis = k;
+		}
+		double major = fabs(directionRef->array[axis]);
+		face = axis * 2 + (directionRef->array[axis] < 0 ? 1 : 0);
+		u = directionRef->array[(axis + 1) % 3] / major;
+		v = directionRef->array[(axis + 2) % 3] / major;
+	}
+
+	int x = (int) ((u + 1) / 2 * mapRef->resolution);
+	int y = (int) ((v + 1) / 2 * mapRef->resolution);
+	if (x >= mapRef->resolution)
+		x = mapRef->resolution - 1;
+	if (y >= mapRef->resolution)
+		y = mapRef->resolution - 1;
+	return (face * mapRef->resolution + y) * mapRef->resolution + x;
+}
+
+/**
+ * Find the primitives which may be hit by a texel in a block of a face, a sphere is kept when the cone
+ * around the block directions overlaps the cone the sphere covers seen from the light
+ * @return The number of primitives found
+ */
+static int shadow_map_block_primitives(Scene *sceneRef, ShadowMap *mapRef, int face, int blockX, int blockY, int *primitivesRef) {
+	int endX = blockX + SHADOW_MAP_BLOCK < mapRef->resolution ? blockX + SHADOW_MAP_BLOCK : mapRef->resolution;
+	int endY = blockY + SHADOW_MAP_BLOCK < mapRef->resolution ? blockY + SHADOW_MAP_BLOCK : mapRef->resolution;
+	int length = 0;
+	V3 center;
+	V3 corner;
+	double blockCos = 1;
+
+	// Block corners are texel centers, widen the cone by a texel for the texels edges
+	shadow_map_texel_direction(mapRef, face, blockX, blockY, &center);
+	shadow_map_texel_direction(mapRef, face, endX - 1, endY - 1, &corner);
+	v3_add(&center, &corner, &center);
+	v3_normalize(&center, &center);
+	for (int k = 0; k < 4; k++) {
+		double cosine;
+		shadow_map_texel_direction(mapRef, face, k % 2 == 0 ? blockX - 1 : endX, k < 2 ? blockY - 1 : endY, &corner);
+		v3_dot(&center, &corner, &cosine);
+		blockCos = fmin(blockCos, cosine);
+	}
+	double blockAngle = acos(fmax(fmin(blockCos, 1), -1));
+
+	for (int i = 0; i < sceneRef->primitivesLength; i++) {
+		Primitive *primitiveRef = sceneRef->primitives[i];
+		V3 sphereCenter;
+		double sphereRadius = INFINITY;
+		if (primitiveRef->type == SPHERE_T) {
+			sphereCenter = primitiveRef->data.sphere.position;
+			sphereRadius = primitiveRef->data.sphere.radius;
+		}
+		else if (primitiveRef->type == MESH_T) {
+			// Meshes are culled by the sphere around their bounds
+			MeshNode *rootRef = &primitiveRef->data.mesh.dataRef->nodes[0];
+			sphereRadius = 0;
+			for (int k = 0; k < 3; k++) {
+				sphereCenter.array[k] = (rootRef->boundsMin[k] + rootRef->boundsMax[k]) / 2.0;
+				sphereRadius += pow((rootRef->boundsMax[k] - rootRef->boundsMin[k]) / 2.0, 2);
+			}
+			sphereRadius = sqrt(sphereRadius);
+		}
+		if (sphereRadius != INFINITY) {
+			V3 toSphere;
+			double distance;
+			double cosine;
+			v3_subtract(&sphereCenter, &mapRef->position, &toSphere);
+			v3_magnitude(&toSphere, &distance);
+			if (distance > sphereRadius) {
+				v3_scale(&toSphere, 1 / distance, &toSphere);
+				v3_dot(&center, &toSphere, &cosine);
+				double sphereAngle = asin(sphereRadius / distance);
+				if (acos(fmax(fmin(cosine, 1), -1)) > blockAngle + sphereAngle)
+					continue;
+			}
+		}
+		primitivesRef[length++] = i;
+	}
+	return length;
+}
+
+/**
+ * Render one row of blocks of a face of a map, the distance to the closest primitive along every
+ * texel direction
+ */
+static void shadow_map_bake_blocks(Scene *sceneRef, ShadowMap *mapRef, int face, int blockY, int *primitivesRef) {
+	V3 direction;
+	int endY = blockY + SHADOW_MAP_BLOCK < mapRef->resolution ? blockY + SHADOW_MAP_BLOCK : mapRef->resolution;
+
+	for (int blockX = 0; blockX < mapRef->resolution; blockX += SHADOW_MAP_BLOCK) {
+		int endX = blockX + SHADOW_MAP_BLOCK < mapRef->resolution ? blockX + SHADOW_MAP_BLOCK : mapRef->resolution;
+		int primitivesLength = shadow_map_block_primitives(sceneRef, mapRef, face, blockX, blockY, primitivesRef);
+
+		for (int y = blockY; y < endY; y++) {
+			for (int x = blockX; x < endX; x++) {
+				double closest = INFINITY;
+				shadow_map_texel_direction(mapRef, face, x, y, &direction);
+				for (int i = 0; i < primitivesLength; i++) {
+					Primitive *primitiveRef = sceneRef->primitives[primitivesRef[i]];
+					double t = INFINITY;
+					switch (primitiveRef->type) {
+						case PLANE_T:
+							t = intersect_plane(&primitiveRef->data.plane, &mapRef->position, &direction);
+							break;
+						case SPHERE_T:
+							t = intersect_sphere(&primitiveRef->data.sphere, &mapRef->position, &direction);
+							break;
+						case MESH_T:
+							t = intersect_mesh(primitiveRef->data.mesh.dataRef, &mapRef->position, &direction, -1, NULL);
+							break;
+					}
+					if (t > 0 && t < closest)
+						closest = t;
+				}
+				mapRef->distances[(face * mapRef->resolution + y) * mapRef->resolution + x] = (float) closest;
+			}
+		}
+	}
+}
+
+/**
+ * Bake rows of blocks until none are left
+ */
+static void *shadow_map_bake_worker(void *argRef) {
+	ShadowBake *bakeRef = argRef;
+	int *primitives = malloc(sizeof(int) * (bakeRef->sceneRef->primitivesLength > 0 ? bakeRef->sceneRef->primitivesLength : 1));
+	int row;
+
+	if (primitives == NULL)
+		return NULL;
+
+	while ((row = atomic_fetch_add(&bakeRef->nextRow, 1)) < bakeRef->rowsLength) {
+		int map = 0;
+		while (row >= bakeRef->maps[map]->faces * SHADOW_MAP_BLOCK_ROWS(bakeRef->maps[map])) {
+			row -= bakeRef->maps[map]->faces * SHADOW_MAP_BLOCK_ROWS(bakeRef->maps[map]);
+			map++;
+		}
+		ShadowMap *mapRef = bakeRef->maps[map];
+		int blockRows = SHADOW_MAP_BLOCK_ROWS(mapRef);
+		shadow_map_bake_blocks(bakeRef->sceneRef, mapRef, row / blockRows, row % blockRows * SHADOW_MAP_BLOCK, primitives);
+	}
+
+	free(primitives);
+	return NULL;
+}
+
+/**
+ * Render a shadow map for every light of a scene, after which shadow tests against the light are a
+ * lookup instead of a shadow ray. The scene geometry must not change afterwards.
+ * @param sceneRef - The scene whose lights are mapped
+ * @param resolution - The width and height of every map face in texels
+ * @param bias - The fraction of the light distance an occluder must be in front of a point to shadow it
+ * @param threads - The number of threads rendering the maps
+ * @return 0 if success, otherwise a failure occurred
+ */
+int scene_bake_shadow_maps(Scene *sceneRef, int resolution, double bias, int threads) {
+	ShadowBake bake;
+
+	bake.sceneRef = sceneRef;
+	bake.maps = malloc(sizeof(ShadowMap*) * (sceneRef->lightsLength > 0 ? sceneRef->lightsLength : 1));
+	bake.mapsLength = 0;
+	bake.rowsLength = 0;
+	atomic_init(&bake.nextRow, 0);
+	if (bake.maps == NULL) {
+		fprintf(stderr, "Error: Could not allocate the shadow maps\n");
+		return 1;
+	}
+
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		Light *lightRef = sceneRef->lights[i];
+		ShadowMap *mapRef = malloc(sizeof(ShadowMap));
+		if (mapRef == NULL) {
+			fprintf(stderr, "Error: Could not allocate the shadow maps\n");
+			free(bake.maps);
+			return 1;
+		}
+
+		mapRef->resolution = resolution;
+		mapRef->bias = bias;
+		mapRef->position = lightRef->data.pointLight.position;
+		mapRef->faces = 6;
+		if (lightRef->type == SPOTLIGHT_T && lightRef->data.spotLight.theta < SHADOW_MAP_MAX_SPOT_ANGLE) {
+			// Points outside the cone get no light, so one face just covering the cone is enough
+			V3 helper = {{0, 1, 0}};
+			mapRef->faces = 1;
+			mapRef->forward = lightRef->data.spotLight.direction;
+			mapRef->tanHalfAngle = tan(lightRef->data.spotLight.theta);
+			if (fabs(mapRef->forward.data.Y) > 0.9)
+				helper = (V3) {{1, 0, 0}};
+			v3_cross(&mapRef->forward, &helper, &mapRef->right);
+			v3_normalize(&mapRef->right, &mapRef->right);
+			v3_cross(&mapRef->right, &mapRef->forward, &mapRef->up);
+		}
+		mapRef->distances = malloc(sizeof(float) * mapRef->faces * resolution * resolution);
+		if (mapRef->distances == NULL) {
+			fprintf(stderr, "Error: Could not allocate a %dx%d shadow map\n", resolution, resolution);
+			free(mapRef);
+			free(bake.maps);
+			return 1;
+		}
+
+		lightRef->shadowMapRef = mapRef;
+		bake.maps[bake.mapsLength++] = mapRef;
+		bake.rowsLength += mapRef->faces * SHADOW_MAP_BLOCK_ROWS(mapRef);
+	}
+
+	// The calling thread is always worker 0
+	pthread_t *threadIds = malloc(sizeof(pthread_t) * (threads > 1 ? threads : 1));
+	int started = 0;
+	for (int i = 1; i < threads && threadIds != NULL; i++) {
+		if (pthread_create(&threadIds[i], NULL, shadow_map_bake_worker, &bake) != 0)
+			break;
+		started++;
+	}
+	shadow_map_bake_worker(&bake);
+	for (int i = 1; i <= started; i++)
+		pthread_join(threadIds[i], NULL);
+
+	free(threadIds);
+	free(bake.maps);
+	return 0;
+}
+
+/**
+ * Look up whether a point is shadowed from the light of a map
+ * @param mapRef - The shadow map of the light
+ * @param positionRef - The point to test
+ * @param lightDistance - The distance from the point to the light
+ * @param facing - The cosine of the angle between the surface normal and the direction to the light
+ * @return TRUE when a primitive is closer to the light than the point, otherwise FALSE
+ */
+int shadow_map_occluded(ShadowMap *mapRef, V3 *positionRef, double lightDistance, double facing) {
+	V3 direction;
+
+	v3_subtract(positionRef, &mapRef->position, &direction);
+	v3_normalize(&direction, &direction);
+	int texel = shadow_map_texel(mapRef, &direction);
+	if (texel < 0)
+		return FALSE;
+
+	// A texel covers a patch of surface, which spans more distance from the light the more the surface
+	// is tilted away from it, so the bias grows with the slope to keep lit surfaces from shadowing themselves
+	double texelAngle = 2.0 / mapRef->resolution * (mapRef->faces == 1 ? mapRef->tanHalfAngle : 1);
+	double slope = sqrt(fmax(1 - facing * facing, 0)) / fmax(facing, 0.05);
+	return mapRef->distances[texel] < lightDistance * (1 - mapRef->bias - texelAngle * slope);
+}
+
+/**
+ * Release the shadow maps of every light of a scene
+ * @param sceneRef - The scene whose maps are freed
+ */
+void scene_free_shadow_maps(Scene *sceneRef) {
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		Light *lightRef = sceneRef->lights[i];
+		if (lightRef->shadowMapRef != NULL) {
+			free(lightRef->shadowMapRef->distances);
+			free(lightRef->shadowMapRef);
+			lightRef->shadowMapRef = NULL;
+		}
+	}
+}
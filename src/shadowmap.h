@@ -0,0 +1,36 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_SHADOWMAP_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_SHADOWMAP_H
+
+#include "3dmath.h"
+#include "raycaster.h"
+
+#define DEFAULT_SHADOW_BIAS 0.01
+
+// Wider spotlights are mapped with a cube map, a single perspective map gets too stretched
+#define SHADOW_MAP_MAX_SPOT_ANGLE (M_PI * 75 / 180)
+
+/**
+ * Shadow Map - the distance from a light to the closest primitive in every texel direction, a cube
+ * map of 6 faces around a point light or 1 perspective face along the cone of a spotlight
+ */
+typedef struct ShadowMap {
+	int faces;
+	int resolution;
+	double bias;
+	V3 position;
+	V3 forward;
+	V3 right;
+	V3 up;
+	double tanHalfAngle;
+	float *distances;
+} ShadowMap;
+
+int scene_bake_shadow_maps(Scene *sceneRef, int resolution, double bias, int threads);
+int shadow_map_occluded(ShadowMap *mapRef, V3 *positionRef, double lightDistance, double facing);
+void scene_free_shadow_maps(Scene *sceneRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_SHADOWMAP_H
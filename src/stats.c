@@ -0,0 +1,214 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+static const char *stageNames[STAGE_COUNT] = {"parse", "scene", "render", "write"};
+
+/**
+ * The counters of the calling thread
+ */
+__thread RenderStats threadStats;
+
+/**
+ * Read the given clock in seconds
+ * @param clockId - The clock to read
+ * @return The current time of the clock in seconds
+ */
+static double read_clock(clockid_t clockId) {
+	struct timespec ts;
+	clock_gettime(clockId, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Zero the counters of the calling thread
+ */
+void stats_reset_thread() {
+	memset(&threadStats, 0, sizeof(RenderStats));
+}
+
+/**
+ * Add a set of counters into a total
+ * @param totalRef - The total to add to
+ * @param statsRef - The counters to add
+ */
+void stats_merge(RenderStats *totalRef, RenderStats *statsRef) {
+	totalRef->cameraRays += statsRef->cameraRays;
+	totalRef->reflectionRays += statsRef->reflectionRays;
+	totalRef->refractionRays += statsRef->refractionRays;
+	totalRef->shadowRays += statsRef->shadowRays;
+	totalRef->sphereTests += statsRef->sphereTests;
+	totalRef->planeTests += statsRef->planeTests;
+	totalRef->triangleTests += statsRef->triangleTests;
+	totalRef->shadowEarlyOuts += statsRef->shadowEarlyOuts;
+	totalRef->lightsCulled += statsRef->lightsCulled;
+	totalRef->shadowMapLookups += statsRef->shadowMapLookups;
+	totalRef->shadowTileSkips += statsRef->shadowTileSkips;
+	for (int i = 0; i <= MAX_RECURSE_DEPTH; i++)
+		totalRef->depthHistogram[i] += statsRef->depthHistogram[i];
+}
+
+/**
+ * Add the counters of the calling thread into a total, the caller is responsible for synchronizing
+ * access to the total
+ * @param totalRef - The total to add to
+ */
+void stats_collect_thread(RenderStats *totalRef) {
+	stats_merge(totalRef, &threadStats);
+}
+
+/**
+ * @return The number of rays of every kind cast
+ */
+uint64_t stats_total_rays(RenderStats *statsRef) {
+	return statsRef->cameraRays + statsRef->reflectionRays + statsRef->refractionRays + statsRef->shadowRays;
+}
+
+/**
+ * @return The number of ray/primitive intersection tests of every kind
+ */
+uint64_t stats_total_tests(RenderStats *statsRef) {
+	return statsRef->sphereTests + statsRef->planeTests + statsRef->triangleTests;
+}
+
+/**
+ * Clear a report
+ * @param reportRef - The report to clear
+ */
+void report_init(RenderReport *reportRef) {
+	memset(reportRef, 0, sizeof(RenderReport));
+	reportRef->threads = 1;
+	reportRef->kernelsName = "generic";
+}
+
+/**
+ * Start timing a stage
+ * @param reportRef - The report to record into
+ * @param stage - The stage which is starting
+ */
+void report_stage_begin(RenderReport *reportRef, Stage_t stage) {
+	reportRef->stageStartWall[stage] = read_clock(CLOCK_MONOTONIC);
+	reportRef->stageStartCpu[stage] = read_clock(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/**
+ * Stop timing a stage, CPU time is for the whole process so it includes every render thread
+ * @param reportRef - The report to record into
+ * @param stage - The stage which has finished
+ */
+void report_stage_end(RenderReport *reportRef, Stage_t stage) {
+	reportRef->wallSeconds[stage] += read_clock(CLOCK_MONOTONIC) - reportRef->stageStartWall[stage];
+	reportRef->cpuSeconds[stage] += read_clock(CLOCK_PROCESS_CPUTIME_ID) - reportRef->stageStartCpu[stage];
+}
+
+/**
+ * Rays per second of wall time spent in the render stage
+ */
+static double rays_per_second(RenderReport *reportRef, uint64_t rays) {
+	if (reportRef->wallSeconds[STAGE_RENDER_T] <= 0)
+		return 0;
+	return rays / reportRef->wallSeconds[STAGE_RENDER_T];
+}
+
+/**
+ * Pretty print a report to the console
+ * @param reportRef - The report to print
+ */
+void print_render_report(RenderReport *reportRef) {
+	RenderStats *c = &reportRef->counters;
+	uint64_t rays = stats_total_rays(c);
+
+	printf("[STATS] Image: %dx%d, %d thread(s), %s kernels\n", reportRef->imageWidth, reportRef->imageHeight,
+		   reportRef->threads, reportRef->kernelsName);
+	printf("[STATS] %-8s %12s %12s\n", "stage", "wall (s)", "cpu (s)");
+	for (int i = 0; i < STAGE_COUNT; i++)
+		printf("[STATS] %-8s %12.4f %12.4f\n", stageNames[i], reportRef->wallSeconds[i], reportRef->cpuSeconds[i]);
+
+	printf("[STATS] Rays: %llu total, %llu camera, %llu reflection, %llu refraction, %llu shadow\n",
+		   (unsigned long long) rays, (unsigned long long) c->cameraRays, (unsigned long long) c->reflectionRays,
+		   (unsigned long long) c->refractionRays, (unsigned long long) c->shadowRays);
+	printf("[STATS] Intersection tests: %llu sphere, %llu plane, %llu triangle\n",
+		   (unsigned long long) c->sphereTests, (unsigned long long) c->planeTests, (unsigned long long) c->triangleTests);
+	printf("[STATS] Shadow early-outs: %llu of %llu shadow rays\n",
+		   (unsigned long long) c->shadowEarlyOuts, (unsigned long long) c->shadowRays);
+	printf("[STATS] Lights culled before a shadow ray: %llu\n", (unsigned long long) c->lightsCulled);
+	printf("[STATS] Shadow map lookups: %llu\n", (unsigned long long) c->shadowMapLookups);
+	printf("[STATS] Shadow tests answered by tile light classification: %llu\n", (unsigned long long) c->shadowTileSkips);
+
+	printf("[STATS] Recursion depth histogram:\n");
+	for (int i = 0; i <= MAX_RECURSE_DEPTH; i++) {
+		if (c->depthHistogram[i] != 0)
+			printf("[STATS] \t%3d: %llu\n", i, (unsigned long long) c->depthHistogram[i]);
+	}
+
+	printf("[STATS] Throughput: %.0f rays/s, %.0f camera rays/s\n",
+		   rays_per_second(reportRef, rays), rays_per_second(reportRef, c->cameraRays));
+	if (reportRef->qualityLevels > 0)
+		printf("[STATS] Quality: level %d of %d (%s), %.1f%% of the next level\n", reportRef->qualityLevel,
+			   reportRef->qualityLevels, reportRef->qualityName, reportRef->qualityNextFraction * 100);
+}
+
+/**
+ * Write a report to a file in JSON format
+ * @param reportRef - The report to write
+ * @param fname - The output filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int save_render_report_json(RenderReport *reportRef, char *fname) {
+	RenderStats *c = &reportRef->counters;
+	uint64_t rays = stats_total_rays(c);
+	FILE *fp = fopen(fname, "w");
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "  \"width\": %d,\n", reportRef->imageWidth);
+	fprintf(fp, "  \"height\": %d,\n", reportRef->imageHeight);
+	fprintf(fp, "  \"threads\": %d,\n", reportRef->threads);
+	fprintf(fp, "  \"kernels\": \"%s\",\n", reportRef->kernelsName);
+	fprintf(fp, "  \"stages\": {\n");
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		fprintf(fp, "    \"%s\": {\"wall_seconds\": %f, \"cpu_seconds\": %f}%s\n", stageNames[i],
+				reportRef->wallSeconds[i], reportRef->cpuSeconds[i], i + 1 < STAGE_COUNT ? "," : "");
+	}
+	fprintf(fp, "  },\n");
+	fprintf(fp, "  \"rays\": {\"total\": %llu, \"camera\": %llu, \"reflection\": %llu, \"refraction\": %llu, \"shadow\": %llu},\n",
+			(unsigned long long) rays, (unsigned long long) c->cameraRays, (unsigned long long) c->reflectionRays,
+			(unsigned long long) c->refractionRays, (unsigned long long) c->shadowRays);
+	fprintf(fp, "  \"intersection_tests\": {\"sphere\": %llu, \"plane\": %llu, \"triangle\": %llu},\n",
+			(unsigned long long) c->sphereTests, (unsigned long long) c->planeTests, (unsigned long long) c->triangleTests);
+	fprintf(fp, "  \"shadow_early_outs\": %llu,\n", (unsigned long long) c->shadowEarlyOuts);
+	fprintf(fp, "  \"lights_culled\": %llu,\n", (unsigned long long) c->lightsCulled);
+	fprintf(fp, "  \"shadow_map_lookups\": %llu,\n", (unsigned long long) c->shadowMapLookups);
+	fprintf(fp, "  \"shadow_tile_skips\": %llu,\n", (unsigned long long) c->shadowTileSkips);
+
+	// Trim the histogram after the deepest level reached
+	int deepest = 0;
+	for (int i = 0; i <= MAX_RECURSE_DEPTH; i++) {
+		if (c->depthHistogram[i] != 0)
+			deepest = i;
+	}
+	fprintf(fp, "  \"depth_histogram\": [");
+	for (int i = 0; i <= deepest; i++)
+		fprintf(fp, "%llu%s", (unsigned long long) c->depthHistogram[i], i < deepest ? ", " : "");
+	fprintf(fp, "],\n");
+
+	if (reportRef->qualityLevels > 0) {
+		fprintf(fp, "  \"quality\": {\"level\": %d, \"levels\": %d, \"name\": \"%s\", \"next_level_fraction\": %f},\n",
+				reportRef->qualityLevel, reportRef->qualityLevels, reportRef->qualityName, reportRef->qualityNextFraction);
+	}
+	fprintf(fp, "  \"rays_per_second\": %f,\n", rays_per_second(reportRef, rays));
+	fprintf(fp, "  \"camera_rays_per_second\": %f\n", rays_per_second(reportRef, c->cameraRays));
+	fprintf(fp, "}\n");
+
+	fclose(fp);
+	return 0;
+}
@@ -0,0 +1,83 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_STATS_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_STATS_H
+
+#include <stdint.h>
+#include "constants.h"
+
+/**
+ * The stages of a render that are timed
+ */
+typedef enum Stage_t {
+	STAGE_PARSE_T,
+	STAGE_SCENE_T,
+	STAGE_RENDER_T,
+	STAGE_WRITE_T,
+	STAGE_COUNT
+} Stage_t;
+
+/**
+ * Render counters, each thread owns one of these and they are merged at the end of a render
+ */
+typedef struct RenderStats {
+	uint64_t cameraRays;
+	uint64_t reflectionRays;
+	uint64_t refractionRays;
+	uint64_t shadowRays;
+	uint64_t sphereTests;
+	uint64_t planeTests;
+	uint64_t triangleTests;
+	uint64_t shadowEarlyOuts;
+	uint64_t lightsCulled;
+	uint64_t shadowMapLookups;
+	uint64_t shadowTileSkips;
+	uint64_t depthHistogram[MAX_RECURSE_DEPTH + 1];
+} RenderStats;
+
+/**
+ * Everything reported by --stats, the merged counters plus per stage wall and CPU times. The quality
+ * is only reported by renders with a time budget, which set qualityLevels.
+ */
+typedef struct RenderReport {
+	RenderStats counters;
+	double wallSeconds[STAGE_COUNT];
+	double cpuSeconds[STAGE_COUNT];
+	double stageStartWall[STAGE_COUNT];
+	double stageStartCpu[STAGE_COUNT];
+	int imageWidth;
+	int imageHeight;
+	int threads;
+	const char *kernelsName;
+	int qualityLevel;
+	int qualityLevels;
+	const char *qualityName;
+	double qualityNextFraction;
+} RenderReport;
+
+extern __thread RenderStats threadStats;
+
+#if RENDER_STATS
+#define STATS_INC(field) (threadStats.field++)
+#define STATS_DEPTH(depth) (threadStats.depthHistogram[depth]++)
+#define STATS_ADD(field, n) (threadStats.field += (n))
+#else
+#define STATS_INC(field) ((void) 0)
+#define STATS_DEPTH(depth) ((void) 0)
+#define STATS_ADD(field, n) ((void) 0)
+#endif
+
+void stats_reset_thread();
+void stats_merge(RenderStats *totalRef, RenderStats *statsRef);
+void stats_collect_thread(RenderStats *totalRef);
+uint64_t stats_total_rays(RenderStats *statsRef);
+uint64_t stats_total_tests(RenderStats *statsRef);
+void report_init(RenderReport *reportRef);
+void report_stage_begin(RenderReport *reportRef, Stage_t stage);
+void report_stage_end(RenderReport *reportRef, Stage_t stage);
+void print_render_report(RenderReport *reportRef);
+int save_render_report_json(RenderReport *reportRef, char *fname);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_STATS_H
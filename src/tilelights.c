@@ -0,0 +1,373 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include "tilelights.h"
+#include "constants.h"
+
+// Relative slack of every test, far above the rounding of a shadow ray so a light is only classified
+// when every shadow ray of the tile is certain to agree
+#define TILE_LIGHTS_SLACK 1e-6
+
+/**
+ * The distance from a point to a line segment
+ */
+static double segment_distance(V3 *pointRef, V3 *startRef, V3 *endRef) {
+	V3 segment;
+	V3 offset;
+	V3 closest;
+	double lengthSquared;
+	double along;
+	double distance;
+
+	v3_subtract(endRef, startRef, &segment);
+	v3_subtract(pointRef, startRef, &offset);
+	v3_dot(&segment, &segment, &lengthSquared);
+	v3_dot(&offset, &segment, &along);
+	v3_scale(&segment, lengthSquared > 0 ? fmin(fmax(along / lengthSquared, 0), 1) : 0, &closest);
+	v3_add(startRef, &closest, &closest);
+	v3_distance(pointRef, &closest, &distance);
+	return distance;
+}
+
+/**
+ * The distance from a point to an axis aligned box, 0 inside of it
+ */
+static double box_distance(V3 *pointRef, V3 *boundsMinRef, V3 *boundsMaxRef) {
+	double sum = 0;
+
+	for (int a = 0; a < 3; a++) {
+		double excess = fmax(fmax(boundsMinRef->array[a] - pointRef->array[a], pointRef->array[a] - boundsMaxRef->array[a]), 0);
+		sum += excess * excess;
+	}
+	return sqrt(sum);
+}
+
+/**
+ * Determine if a sphere blocks the light from every point of a box. Every line from the light through
+ * a corner of the box must pass well inside the sphere, the cone of those lines is convex so it then
+ * holds the whole box, and the box must lie past the center of the sphere without touching it, so the
+ * segment from any point of the box to the light crosses the sphere.
+ */
+static int sphere_shadows_box(V3 *lightRef, Sphere *sphereRef, V3 *boundsMinRef, V3 *boundsMaxRef, double slack) {
+	double radius = sphereRef->radius - slack;
+	double centerDistance;
+	V3 toCenter;
+
+	v3_subtract(&sphereRef->position, lightRef, &toCenter);
+	v3_magnitude(&toCenter, &centerDistance);
+	if (radius <= 0 || centerDistance <= sphereRef->radius + slack ||
+		box_distance(&sphereRef->position, boundsMinRef, boundsMaxRef) <= sphereRef->radius + slack ||
+		box_distance(lightRef, boundsMinRef, boundsMaxRef) <= centerDistance + slack)
+		return FALSE;
+
+	for (int corner = 0; corner < 8; corner++) {
+		V3 toCorner = {{(corner & 1 ? boundsMaxRef : boundsMinRef)->data.X - lightRef->data.X,
+						(corner & 2 ? boundsMaxRef : boundsMinRef)->data.Y - lightRef->data.Y,
+						(corner & 4 ? boundsMaxRef : boundsMinRef)->data.Z - lightRef->data.Z}};
+		double cornerDistance;
+		double along;
+		v3_magnitude(&toCorner, &cornerDistance);
+		v3_dot(&toCorner, &toCenter, &along);
+		along /= cornerDistance;
+		if (along <= 0 || centerDistance * centerDistance - along * along >= radius * radius)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * How a plane blocks a light from the camera hits of a tile. A shadow ray crosses the plane when its
+ * point and the light lie on opposite sides, the points on the plane itself never test it.
+ */
+static LightVisibility_t plane_visibility(Primitive *planePrimitiveRef, V3 *lightRef, V3 *positions, Primitive **hits, int count) {
+	Plane *planeRef = &planePrimitiveRef->data.plane;
+	double planeOffset;
+	double lightSide;
+	double lightOffset;
+	int blocked = 0, clear = 0, own = 0;
+	V3 toLight;
+
+	v3_dot(&planeRef->normal, &planeRef->position, &planeOffset);
+	v3_dot(&planeRef->normal, lightRef, &lightOffset);
+	v3_subtract(lightRef, &planeRef->position, &toLight);
+	v3_dot(&planeRef->normal, &toLight, &lightSide);
+	if (fabs(lightSide) <= TILE_LIGHTS_SLACK * (fabs(lightOffset) + fabs(planeOffset)))
+		return LIGHT_MIXED_T;
+
+	for (int k = 0; k < count; k++) {
+		double side;
+		double offset;
+		V3 fromPlane;
+		if (hits[k] == NULL)
+			continue;
+		if (hits[k] == planePrimitiveRef) {
+			own++;
+			continue;
+		}
+		v3_subtract(&positions[k], &planeRef->position, &fromPlane);
+		v3_dot(&planeRef->normal, &fromPlane, &side);
+		v3_dot(&planeRef->normal, &positions[k], &offset);
+		double slack = TILE_LIGHTS_SLACK * (fabs(offset) + fabs(planeOffset));
+		if ((lightSide > 0 ? side : -side) > slack)
+			clear++;
+		else if ((lightSide > 0 ? side : -side) < -slack)
+			blocked++;
+		else
+			return LIGHT_MIXED_T;
+	}
+
+	if (blocked == 0)
+		return LIGHT_VISIBLE_T;
+	return clear == 0 && own == 0 ? LIGHT_OCCLUDED_T : LIGHT_MIXED_T;
+}
+
+/**
+ * Make room for more occluders, the buffers grow to at least twice their size
+ * @return 0 if success, otherwise the buffers could not be grown
+ */
+static int reserve_occluders(TileLights *tileLightsRef, size_t spheres, size_t others) {
+	if (spheres > tileLightsRef->spheresCapacity) {
+		size_t capacity = spheres > 2 * tileLightsRef->spheresCapacity ? spheres : 2 * tileLightsRef->spheresCapacity;
+		double **coordinates[4] = {&tileLightsRef->x, &tileLightsRef->y, &tileLightsRef->z, &tileLightsRef->radiusSquared};
+		for (int c = 0; c < 4; c++) {
+			double *grown = realloc(*coordinates[c], sizeof(double) * capacity);
+			if (grown == NULL)
+				return 1;
+			*coordinates[c] = grown;
+		}
+		Primitive **grownSpheres = realloc(tileLightsRef->spheres, sizeof(Primitive *) * capacity);
+		if (grownSpheres == NULL)
+			return 1;
+		tileLightsRef->spheres = grownSpheres;
+		int *grownIndices = realloc(tileLightsRef->sphereIndices, sizeof(int) * capacity);
+		if (grownIndices == NULL)
+			return 1;
+		tileLightsRef->sphereIndices = grownIndices;
+		tileLightsRef->spheresCapacity = capacity;
+	}
+	if (others > tileLightsRef->othersCapacity) {
+		size_t capacity = others > 2 * tileLightsRef->othersCapacity ? others : 2 * tileLightsRef->othersCapacity;
+		Primitive **grownOthers = realloc(tileLightsRef->others, sizeof(Primitive *) * capacity);
+		if (grownOthers == NULL)
+			return 1;
+		tileLightsRef->others = grownOthers;
+		int *grownIndices = realloc(tileLightsRef->otherIndices, sizeof(int) * capacity);
+		if (grownIndices == NULL)
+			return 1;
+		tileLightsRef->otherIndices = grownIndices;
+		tileLightsRef->othersCapacity = capacity;
+	}
+	return 0;
+}
+
+/**
+ * Make room for the camera hits of a tile
+ * @param tileLightsRef - The buffers to grow
+ * @param pixels - The number of pixels of the tile
+ * @return 0 if success, otherwise the buffers could not be grown
+ */
+int tile_lights_reserve(TileLights *tileLightsRef, int pixels) {
+	if (pixels <= tileLightsRef->pixelsCapacity)
+		return 0;
+	V3 *directions = realloc(tileLightsRef->directions, sizeof(V3) * pixels);
+	if (directions != NULL)
+		tileLightsRef->directions = directions;
+	V3 *positions = realloc(tileLightsRef->positions, sizeof(V3) * pixels);
+	if (positions != NULL)
+		tileLightsRef->positions = positions;
+	Primitive **hits = realloc(tileLightsRef->hits, sizeof(Primitive *) * pixels);
+	if (hits != NULL)
+		tileLightsRef->hits = hits;
+	double *distances = realloc(tileLightsRef->distances, sizeof(double) * pixels);
+	if (distances != NULL)
+		tileLightsRef->distances = distances;
+	MeshHit *meshHits = realloc(tileLightsRef->meshHits, sizeof(MeshHit) * pixels);
+	if (meshHits != NULL)
+		tileLightsRef->meshHits = meshHits;
+	if (directions == NULL || positions == NULL || hits == NULL || distances == NULL || meshHits == NULL)
+		return 1;
+	tileLightsRef->pixelsCapacity = pixels;
+	return 0;
+}
+
+/**
+ * Classify every light of the scene for the camera hits of a tile. The shadow ray from any hit to a
+ * light lies within the capsule around the segment from the light to the center of the hits' bounds,
+ * as wide as the bounds, so only the packed primitives reaching into that capsule may block the light.
+ * A light nothing may block is visible from the whole tile, a sphere or plane which blocks it from
+ * every hit occludes it, and every other light is mixed and traced against its occluders alone.
+ * @param tileLightsRef - The camera hit positions and primitives of the tile, NULL for a miss, set to the
+ * classification and grown as needed
+ * @param sceneRef - The scene, with packed primitives
+ * @param count - The number of pixels of the tile
+ * @return 0 if the lights were classified, otherwise the tile is shaded without a classification
+ */
+int tile_lights_classify(TileLights *tileLightsRef, Scene *sceneRef, int count) {
+	PrimitivePack *packRef = sceneRef->packRef;
+	V3 *positions = tileLightsRef->positions;
+	Primitive **hits = tileLightsRef->hits;
+	V3 boundsMin = {{INFINITY, INFINITY, INFINITY}};
+	V3 boundsMax = {{-INFINITY, -INFINITY, -INFINITY}};
+	V3 boundsCenter;
+	V3 extent;
+	double boundsRadius;
+	int hitCount = 0;
+	size_t spheresLength = 0, othersLength = 0;
+
+	if (packRef == NULL || sceneRef->lightsLength == 0)
+		return 1;
+	for (int k = 0; k < count; k++) {
+		if (hits[k] == NULL)
+			continue;
+		for (int a = 0; a < 3; a++) {
+			boundsMin.array[a] = fmin(boundsMin.array[a], positions[k].array[a]);
+			boundsMax.array[a] = fmax(boundsMax.array[a], positions[k].array[a]);
+		}
+		hitCount++;
+	}
+	if (hitCount == 0)
+		return 1;
+	if (sceneRef->lightsLength > tileLightsRef->lightsCapacity) {
+		TileLight *lights = realloc(tileLightsRef->lights, sizeof(TileLight) * sceneRef->lightsLength);
+		if (lights == NULL)
+			return 1;
+		tileLightsRef->lights = lights;
+		tileLightsRef->lightsCapacity = sceneRef->lightsLength;
+	}
+	v3_add(&boundsMin, &boundsMax, &boundsCenter);
+	v3_scale(&boundsCenter, 0.5, &boundsCenter);
+	v3_subtract(&boundsMax, &boundsMin, &extent);
+	v3_magnitude(&extent, &boundsRadius);
+	boundsRadius /= 2;
+
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		Light *lightRef = sceneRef->lights[i];
+		TileLight *tileLightRef = &tileLightsRef->lights[i];
+		V3 *lightPositionRef = lightRef->type == SPOTLIGHT_T ? &lightRef->data.spotLight.position : &lightRef->data.pointLight.position;
+		int occluded = FALSE;
+		double lightDistance;
+
+		tileLightRef->visibility = LIGHT_MIXED_T;
+		tileLightRef->firstSphere = spheresLength;
+		tileLightRef->firstOther = othersLength;
+		tileLightRef->occluders.spheresLength = 0;
+		tileLightRef->occluders.othersLength = 0;
+		// A shadow map answers the shadow tests of its light without rays
+		if (lightRef->shadowMapRef != NULL)
+			continue;
+		v3_distance(lightPositionRef, &boundsCenter, &lightDistance);
+
+		for (int s = 0; s < packRef->spheresLength && !occluded; s++) {
+			Sphere *sphereRef = &packRef->spheres[s]->data.sphere;
+			double slack = TILE_LIGHTS_SLACK * (sphereRef->radius + boundsRadius + lightDistance);
+			if (segment_distance(&sphereRef->position, lightPositionRef, &boundsCenter) > boundsRadius + sphereRef->radius + slack)
+				continue;
+			// The pixels which hit a sphere never test it, so it only occludes a tile it is not seen in
+			if (sphere_shadows_box(lightPositionRef, sphereRef, &boundsMin, &boundsMax, slack)) {
+				int seen = FALSE;
+				for (int k = 0; k < count && !seen; k++)
+					seen = hits[k] == packRef->spheres[s];
+				if (!seen) {
+					occluded = TRUE;
+					break;
+				}
+			}
+			if (reserve_occluders(tileLightsRef, spheresLength + 1, othersLength) != 0)
+				return 1;
+			tileLightsRef->x[spheresLength] = packRef->x[s];
+			tileLightsRef->y[spheresLength] = packRef->y[s];
+			tileLightsRef->z[spheresLength] = packRef->z[s];
+			tileLightsRef->radiusSquared[spheresLength] = packRef->radiusSquared[s];
+			tileLightsRef->spheres[spheresLength] = packRef->spheres[s];
+			tileLightsRef->sphereIndices[spheresLength] = packRef->sphereIndices[s];
+			spheresLength++;
+			tileLightRef->occluders.spheresLength++;
+		}
+
+		for (int o = 0; o < packRef->othersLength && !occluded; o++) {
+			Primitive *primitiveRef = packRef->others[o];
+			if (primitiveRef->type == PLANE_T) {
+				LightVisibility_t visibility = plane_visibility(primitiveRef, lightPositionRef, positions, hits, count);
+				if (visibility == LIGHT_VISIBLE_T)
+					continue;
+				if (visibility == LIGHT_OCCLUDED_T) {
+					occluded = TRUE;
+					break;
+				}
+			}
+			// A mesh is tested with the sphere around the bounds of its hierarchy
+			if (primitiveRef->type == MESH_T && primitiveRef->data.mesh.dataRef->nodesLength > 0) {
+				MeshNode *rootRef = &primitiveRef->data.mesh.dataRef->nodes[0];
+				V3 center = {{(rootRef->boundsMin[0] + (double) rootRef->boundsMax[0]) / 2,
+							  (rootRef->boundsMin[1] + (double) rootRef->boundsMax[1]) / 2,
+							  (rootRef->boundsMin[2] + (double) rootRef->boundsMax[2]) / 2}};
+				V3 meshExtent = {{rootRef->boundsMax[0] - (double) rootRef->boundsMin[0],
+								  rootRef->boundsMax[1] - (double) rootRef->boundsMin[1],
+								  rootRef->boundsMax[2] - (double) rootRef->boundsMin[2]}};
+				double radius;
+				v3_magnitude(&meshExtent, &radius);
+				radius = radius / 2 + MESH_MIN_DISTANCE;
+				double slack = TILE_LIGHTS_SLACK * (radius + boundsRadius + lightDistance);
+				if (segment_distance(&center, lightPositionRef, &boundsCenter) > boundsRadius + radius + slack)
+					continue;
+			}
+			if (reserve_occluders(tileLightsRef, spheresLength, othersLength + 1) != 0)
+				return 1;
+			tileLightsRef->others[othersLength] = primitiveRef;
+			tileLightsRef->otherIndices[othersLength] = packRef->otherIndices[o];
+			othersLength++;
+			tileLightRef->occluders.othersLength++;
+		}
+
+		if (occluded) {
+			tileLightRef->visibility = LIGHT_OCCLUDED_T;
+			tileLightRef->occluders.spheresLength = 0;
+			tileLightRef->occluders.othersLength = 0;
+			spheresLength = tileLightRef->firstSphere;
+			othersLength = tileLightRef->firstOther;
+		}
+		else if (tileLightRef->occluders.spheresLength == 0 && tileLightRef->occluders.othersLength == 0) {
+			tileLightRef->visibility = LIGHT_VISIBLE_T;
+		}
+	}
+
+	// The buffers may have moved while they grew, so the occluders only point into them now
+	for (int i = 0; i < sceneRef->lightsLength; i++) {
+		PrimitivePack *occludersRef = &tileLightsRef->lights[i].occluders;
+		size_t firstSphere = tileLightsRef->lights[i].firstSphere;
+		size_t firstOther = tileLightsRef->lights[i].firstOther;
+		occludersRef->x = tileLightsRef->x + firstSphere;
+		occludersRef->y = tileLightsRef->y + firstSphere;
+		occludersRef->z = tileLightsRef->z + firstSphere;
+		occludersRef->radiusSquared = tileLightsRef->radiusSquared + firstSphere;
+		occludersRef->spheres = tileLightsRef->spheres + firstSphere;
+		occludersRef->sphereIndices = tileLightsRef->sphereIndices + firstSphere;
+		occludersRef->others = tileLightsRef->others + firstOther;
+		occludersRef->otherIndices = tileLightsRef->otherIndices + firstOther;
+	}
+	return 0;
+}
+
+/**
+ * Release the buffers of a tile light classification
+ * @param tileLightsRef - The classification whose buffers are freed
+ */
+void tile_lights_free(TileLights *tileLightsRef) {
+	free(tileLightsRef->directions);
+	free(tileLightsRef->positions);
+	free(tileLightsRef->hits);
+	free(tileLightsRef->distances);
+	free(tileLightsRef->meshHits);
+	free(tileLightsRef->lights);
+	free(tileLightsRef->x);
+	free(tileLightsRef->y);
+	free(tileLightsRef->z);
+	free(tileLightsRef->radiusSquared);
+	free(tileLightsRef->spheres);
+	free(tileLightsRef->sphereIndices);
+	free(tileLightsRef->others);
+	free(tileLightsRef->otherIndices);
+	*tileLightsRef = (TileLights) {0};
+}
@@ -0,0 +1,64 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_TILELIGHTS_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_TILELIGHTS_H
+
+#include <stddef.h>
+#include "raycaster.h"
+#include "kernels.h"
+#include "mesh.h"
+
+/**
+ * How a light reaches the camera hits of a tile
+ */
+typedef enum LightVisibility_t {
+	LIGHT_MIXED_T,
+	LIGHT_VISIBLE_T,
+	LIGHT_OCCLUDED_T
+} LightVisibility_t;
+
+/**
+ * Tile Light - the visibility of a light from every camera hit of a tile. The shadow rays of a mixed
+ * light are still traced but only test its occluders, the packed primitives which may block it
+ * somewhere in the tile.
+ */
+typedef struct TileLight {
+	LightVisibility_t visibility;
+	PrimitivePack occluders;
+	size_t firstSphere;
+	size_t firstOther;
+} TileLight;
+
+/**
+ * Tile Lights - the camera hits of a tile, traced before any of them is shaded, and the lights of the
+ * scene classified for them with the buffers holding the occluders of every light. A render thread
+ * keeps one and reuses it from tile to tile.
+ */
+typedef struct TileLights {
+	V3 *directions;
+	V3 *positions;
+	Primitive **hits;
+	double *distances;
+	MeshHit *meshHits;
+	int pixelsCapacity;
+	TileLight *lights;
+	int lightsCapacity;
+	double *x;
+	double *y;
+	double *z;
+	double *radiusSquared;
+	Primitive **spheres;
+	int *sphereIndices;
+	size_t spheresCapacity;
+	Primitive **others;
+	int *otherIndices;
+	size_t othersCapacity;
+} TileLights;
+
+int tile_lights_reserve(TileLights *tileLightsRef, int pixels);
+int tile_lights_classify(TileLights *tileLightsRef, Scene *sceneRef, int count);
+void tile_lights_free(TileLights *tileLightsRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_TILELIGHTS_H
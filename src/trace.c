@@ -0,0 +1,176 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+#include "constants.h"
+
+/**
+ * Read the monotonic clock in microseconds
+ */
+static double monotonic_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+/**
+ * Prepare a recorder, all timestamps are relative to this call
+ * @param recorderRef - The recorder to initialize
+ */
+void trace_init(TraceRecorder *recorderRef) {
+	pthread_mutex_init(&recorderRef->lock, NULL);
+	recorderRef->buffers = NULL;
+	recorderRef->nextTid = 1;
+	recorderRef->originUs = monotonic_us();
+}
+
+/**
+ * Create a buffer for the calling thread. This is the only call which takes a lock, it should be
+ * made once when a thread starts and the buffer reused for all of the thread's spans.
+ * @param recorderRef - The recorder to register with, may be NULL when tracing is disabled
+ * @param threadName - The name shown for this thread in the trace viewer
+ * @param index - A number appended to the thread name, or -1 for none
+ * @return The buffer, or NULL when tracing is disabled
+ */
+TraceBuffer *trace_thread_buffer(TraceRecorder *recorderRef, const char *threadName, int index) {
+	if (recorderRef == NULL)
+		return NULL;
+
+	TraceBuffer *bufferRef = malloc(sizeof(TraceBuffer));
+	bufferRef->size = INITIAL_BUFFER_SIZE;
+	bufferRef->length = 0;
+	bufferRef->events = malloc(sizeof(TraceEvent) * bufferRef->size);
+	bufferRef->threadName = malloc(strlen(threadName) + 16);
+	if (index >= 0)
+		sprintf(bufferRef->threadName, "%s %d", threadName, index);
+	else
+		strcpy(bufferRef->threadName, threadName);
+
+	pthread_mutex_lock(&recorderRef->lock);
+	bufferRef->tid = recorderRef->nextTid++;
+	bufferRef->next = recorderRef->buffers;
+	recorderRef->buffers = bufferRef;
+	pthread_mutex_unlock(&recorderRef->lock);
+
+	return bufferRef;
+}
+
+/**
+ * @param recorderRef - The recorder to read the time origin from, may be NULL when tracing is disabled
+ * @return The time since the recorder was initialized in microseconds, or 0 when tracing is disabled
+ */
+double trace_now(TraceRecorder *recorderRef) {
+	if (recorderRef == NULL)
+		return 0;
+	return monotonic_us() - recorderRef->originUs;
+}
+
+/**
+ * Append a span to a buffer
+ */
+static TraceEvent *append_event(TraceBuffer *bufferRef, const char *name, double startUs, double endUs) {
+	if (bufferRef->length == bufferRef->size) {
+		bufferRef->size *= 2;
+		bufferRef->events = realloc(bufferRef->events, sizeof(TraceEvent) * bufferRef->size);
+	}
+
+	TraceEvent *eventRef = &bufferRef->events[bufferRef->length++];
+	eventRef->name = name;
+	eventRef->startUs = startUs;
+	eventRef->durationUs = endUs - startUs;
+	eventRef->hasArgs = FALSE;
+	return eventRef;
+}
+
+/**
+ * Record a span, the name must outlive the recorder
+ * @param bufferRef - The calling thread's buffer, may be NULL when tracing is disabled
+ * @param name - The name of the span
+ * @param startUs - The start of the span from trace_now
+ * @param endUs - The end of the span from trace_now
+ */
+void trace_span(TraceBuffer *bufferRef, const char *name, double startUs, double endUs) {
+	if (bufferRef == NULL)
+		return;
+	append_event(bufferRef, name, startUs, endUs);
+}
+
+/**
+ * Record a span with a pair of coordinates attached, used for tiles
+ * @param bufferRef - The calling thread's buffer, may be NULL when tracing is disabled
+ * @param name - The name of the span
+ * @param startUs - The start of the span from trace_now
+ * @param endUs - The end of the span from trace_now
+ * @param x - The x coordinate to attach
+ * @param y - The y coordinate to attach
+ */
+void trace_span_xy(TraceBuffer *bufferRef, const char *name, double startUs, double endUs, int x, int y) {
+	if (bufferRef == NULL)
+		return;
+	TraceEvent *eventRef = append_event(bufferRef, name, startUs, endUs);
+	eventRef->argX = x;
+	eventRef->argY = y;
+	eventRef->hasArgs = TRUE;
+}
+
+/**
+ * Write every recorded span in the Chrome trace-event JSON format, readable by chrome://tracing and Perfetto
+ * @param recorderRef - The recorder to write
+ * @param fname - The output filename
+ * @return 0 if success, otherwise a failure occurred
+ */
+int save_trace_json(TraceRecorder *recorderRef, char *fname) {
+	FILE *fp = fopen(fname, "w");
+	int first = TRUE;
+
+	if (!fp) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", fname);
+		return 1;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	pthread_mutex_lock(&recorderRef->lock);
+	for (TraceBuffer *bufferRef = recorderRef->buffers; bufferRef != NULL; bufferRef = bufferRef->next) {
+		fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+				first ? "" : ",\n", bufferRef->tid, bufferRef->threadName);
+		fprintf(fp, ",\n{\"name\": \"thread_sort_index\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"sort_index\": %d}}",
+				bufferRef->tid, bufferRef->tid);
+		first = FALSE;
+
+		for (int i = 0; i < bufferRef->length; i++) {
+			TraceEvent *eventRef = &bufferRef->events[i];
+			fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+					eventRef->name, bufferRef->tid, eventRef->startUs, eventRef->durationUs);
+			if (eventRef->hasArgs)
+				fprintf(fp, ", \"args\": {\"x\": %d, \"y\": %d}", eventRef->argX, eventRef->argY);
+			fprintf(fp, "}");
+		}
+	}
+	pthread_mutex_unlock(&recorderRef->lock);
+	fprintf(fp, "\n]}\n");
+
+	fclose(fp);
+	return 0;
+}
+
+/**
+ * Release every buffer owned by a recorder
+ * @param recorderRef - The recorder to free
+ */
+void trace_free(TraceRecorder *recorderRef) {
+	TraceBuffer *bufferRef = recorderRef->buffers;
+	while (bufferRef != NULL) {
+		TraceBuffer *nextRef = bufferRef->next;
+		free(bufferRef->events);
+		free(bufferRef->threadName);
+		free(bufferRef);
+		bufferRef = nextRef;
+	}
+	recorderRef->buffers = NULL;
+	pthread_mutex_destroy(&recorderRef->lock);
+}
@@ -0,0 +1,54 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_TRACE_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_TRACE_H
+
+#include <pthread.h>
+
+/**
+ * A single timestamped span
+ */
+typedef struct TraceEvent {
+	const char *name;
+	double startUs;
+	double durationUs;
+	int argX;
+	int argY;
+	int hasArgs;
+} TraceEvent;
+
+typedef struct TraceBuffer TraceBuffer;
+
+/**
+ * Events recorded by one thread, only the owning thread appends to it so no locking is needed
+ */
+typedef struct TraceBuffer {
+	TraceEvent *events;
+	int length;
+	int size;
+	int tid;
+	char *threadName;
+	TraceBuffer *next;
+} TraceBuffer;
+
+/**
+ * Trace Recorder - owns the per-thread buffers of a single run
+ */
+typedef struct TraceRecorder {
+	pthread_mutex_t lock;
+	TraceBuffer *buffers;
+	int nextTid;
+	double originUs;
+} TraceRecorder;
+
+void trace_init(TraceRecorder *recorderRef);
+TraceBuffer *trace_thread_buffer(TraceRecorder *recorderRef, const char *threadName, int index);
+double trace_now(TraceRecorder *recorderRef);
+void trace_span(TraceBuffer *bufferRef, const char *name, double startUs, double endUs);
+void trace_span_xy(TraceBuffer *bufferRef, const char *name, double startUs, double endUs, int x, int y);
+int save_trace_json(TraceRecorder *recorderRef, char *fname);
+void trace_free(TraceRecorder *recorderRef);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_TRACE_H
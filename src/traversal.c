@@ -0,0 +1,100 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "traversal.h"
+
+/**
+ * The names of the traversal orders, in the order of Traversal_t
+ */
+static const char *traversalNames[] = {"scanline", "morton", "hilbert"};
+
+/**
+ * Find a traversal order by name
+ * @param name - The name given on the command line
+ * @param traversalRef - Set to the traversal order
+ * @return 0 if success, otherwise the name is unknown
+ */
+int traversal_parse(const char *name, Traversal_t *traversalRef) {
+	for (int i = 0; i < (int) (sizeof(traversalNames) / sizeof(traversalNames[0])); i++) {
+		if (strcmp(name, traversalNames[i]) == 0) {
+			*traversalRef = (Traversal_t) i;
+			return 0;
+		}
+	}
+	fprintf(stderr, "Error: Unknown traversal '%s', expected scanline, morton or hilbert\n", name);
+	return 1;
+}
+
+/**
+ * The cell at a distance along the Z order curve, the bits of the distance alternate between x and y
+ */
+static void morton_cell(int d, int *xRef, int *yRef) {
+	int x = 0, y = 0;
+
+	for (int bit = 0; d >> (2*bit) != 0; bit++) {
+		x |= ((d >> (2*bit)) & 1) << bit;
+		y |= ((d >> (2*bit + 1)) & 1) << bit;
+	}
+	*xRef = x;
+	*yRef = y;
+}
+
+/**
+ * The cell at a distance along the Hilbert curve filling a side x side grid, side is a power of two
+ */
+static void hilbert_cell(int side, int d, int *xRef, int *yRef) {
+	int x = 0, y = 0;
+
+	for (int s = 1; s < side; s *= 2) {
+		int rx = 1 & (d / 2);
+		int ry = 1 & (d ^ rx);
+		// Every quadrant is a copy of the whole curve, the first and last ones are turned
+		if (ry == 0) {
+			if (rx == 1) {
+				x = s - 1 - x;
+				y = s - 1 - y;
+			}
+			int t = x;
+			x = y;
+			y = t;
+		}
+		x += s * rx;
+		y += s * ry;
+		d /= 4;
+	}
+	*xRef = x;
+	*yRef = y;
+}
+
+/**
+ * The order to visit the cells of a grid in. Curves are laid over the smallest power of two square
+ * covering the grid and cells outside of the grid are skipped, so every cell is visited once.
+ * @param traversal - The traversal order
+ * @param width - The number of columns of the grid
+ * @param height - The number of rows of the grid
+ * @return The row major index of every cell in the order they are visited, NULL if it could not be allocated
+ */
+int *traversal_order(Traversal_t traversal, int width, int height) {
+	int *order = malloc(sizeof(int) * (size_t) (width > 0 && height > 0 ? width * height : 1));
+	int side = 1;
+	int n = 0;
+
+	if (order == NULL)
+		return NULL;
+	while (side < width || side < height)
+		side *= 2;
+	for (long d = 0; n < width * height; d++) {
+		int x = (int) (d % width), y = (int) (d / width);
+		if (traversal == TRAVERSAL_MORTON_T)
+			morton_cell((int) d, &x, &y);
+		else if (traversal == TRAVERSAL_HILBERT_T)
+			hilbert_cell(side, (int) d, &x, &y);
+		if (x < width && y < height)
+			order[n++] = y*width + x;
+	}
+	return order;
+}
@@ -0,0 +1,13 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_TRAVERSAL_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_TRAVERSAL_H
+
+#include "raycaster.h"
+
+int traversal_parse(const char *name, Traversal_t *traversalRef);
+int *traversal_order(Traversal_t traversal, int width, int height);
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_TRAVERSAL_H
@@ -0,0 +1,319 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "wavefront.h"
+#include "constants.h"
+#include "stats.h"
+#include "kernels.h"
+
+// The rays of the tile being rendered by the calling thread, the order to trace a generation in and the
+// bin of each ray of the generation, all grown as needed
+static __thread WavefrontRay *threadRays = NULL;
+static __thread int threadRaysCapacity = 0;
+static __thread int *threadOrder = NULL;
+static __thread uint16_t *threadBins = NULL;
+static __thread int threadOrderCapacity = 0;
+static __thread RayBatch threadBatch;
+
+/**
+ * Make room for a number of rays in the buffers of the calling thread
+ * @param rays - The number of rays in the tile
+ * @param generation - The number of rays in the generation
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int wavefront_reserve(int rays, int generation) {
+	if (rays > threadRaysCapacity) {
+		int capacity = threadRaysCapacity > 0 ? threadRaysCapacity : 1024;
+		while (capacity < rays)
+			capacity *= 2;
+		WavefrontRay *grown = realloc(threadRays, sizeof(WavefrontRay) * capacity);
+		if (grown == NULL)
+			return 1;
+		threadRays = grown;
+		threadRaysCapacity = capacity;
+	}
+	if (generation > threadOrderCapacity) {
+		int capacity = threadOrderCapacity > 0 ? threadOrderCapacity : 1024;
+		while (capacity < generation)
+			capacity *= 2;
+		int *order = realloc(threadOrder, sizeof(int) * capacity);
+		if (order != NULL)
+			threadOrder = order;
+		uint16_t *bins = realloc(threadBins, sizeof(uint16_t) * capacity);
+		if (bins != NULL)
+			threadBins = bins;
+		if (order == NULL || bins == NULL)
+			return 1;
+		threadOrderCapacity = capacity;
+	}
+	return 0;
+}
+
+/**
+ * Release the buffers of the calling thread, render threads come and go with every render
+ */
+void wavefront_thread_free() {
+	free(threadRays);
+	free(threadOrder);
+	free(threadBins);
+	threadRays = NULL;
+	threadOrder = NULL;
+	threadBins = NULL;
+	threadRaysCapacity = 0;
+	threadOrderCapacity = 0;
+}
+
+/**
+ * Bin a generation of rays by the octant of their direction then the cell of their origin in a coarse
+ * grid over the origins of the generation, so that rays going the same way from nearby origins are
+ * traced one after the other. The bins are filled with a counting sort, which keeps the rays of a bin
+ * in the order they were spawned in.
+ * @param rays - The rays of the tile
+ * @param first - The first ray of the generation
+ * @param end - One past the last ray of the generation
+ * @param order - Set to the rays of the generation in the order to trace them
+ * @param bins - Room for the bin of every ray of the generation
+ */
+static void bin_generation(WavefrontRay *rays, int first, int end, int *order, uint16_t *bins) {
+	const int cells = 1 << WAVEFRONT_CELL_BITS;
+	int counts[8 << (3 * WAVEFRONT_CELL_BITS)] = {0};
+	V3 boundsMin = rays[first].origin;
+	V3 boundsMax = rays[first].origin;
+	double scale[3];
+
+	for (int i = first + 1; i < end; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			if (rays[i].origin.array[axis] < boundsMin.array[axis])
+				boundsMin.array[axis] = rays[i].origin.array[axis];
+			if (rays[i].origin.array[axis] > boundsMax.array[axis])
+				boundsMax.array[axis] = rays[i].origin.array[axis];
+		}
+	}
+	for (int axis = 0; axis < 3; axis++) {
+		double extent = boundsMax.array[axis] - boundsMin.array[axis];
+		scale[axis] = extent > 0 ? cells / extent : 0;
+	}
+
+	for (int i = first; i < end; i++) {
+		int bin = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			int coordinate = (int) ((rays[i].origin.array[axis] - boundsMin.array[axis]) * scale[axis]);
+			if (coordinate >= cells)
+				coordinate = cells - 1;
+			bin = (bin << WAVEFRONT_CELL_BITS) | coordinate;
+		}
+		for (int axis = 0; axis < 3; axis++)
+			bin |= (rays[i].direction.array[axis] < 0) << (3 * WAVEFRONT_CELL_BITS + axis);
+		bins[i - first] = (uint16_t) bin;
+		counts[bin]++;
+	}
+
+	for (int bin = 0, offset = 0; bin < 8 << (3 * WAVEFRONT_CELL_BITS); bin++) {
+		int count = counts[bin];
+		counts[bin] = offset;
+		offset += count;
+	}
+	for (int i = first; i < end; i++)
+		order[counts[bins[i - first]]++] = i;
+}
+
+/**
+ * Find what every ray of a generation hits. With packed primitives the spheres are tested a batch of
+ * rays at a time, each sphere against the whole batch, and the other primitives ray by ray.
+ * @param sceneRef - The scene
+ * @param rays - The rays of the tile
+ * @param order - The rays of the generation in the order to trace them
+ * @param count - The number of rays in the generation
+ */
+static void intersect_generation(Scene *sceneRef, WavefrontRay *rays, int *order, int count) {
+	PrimitivePack *packRef = sceneRef->packRef;
+	RayBatch *batchRef = &threadBatch;
+
+	if (packRef == NULL) {
+		for (int k = 0; k < count; k++) {
+			WavefrontRay *rayRef = &rays[order[k]];
+			STATS_DEPTH(rayRef->depth);
+			rayRef->hitRef = find_closest_hit(&rayRef->origin, &rayRef->direction, sceneRef, rayRef->ignore, &rayRef->distance);
+			rayRef->hitSphere = -1;
+			if (rayRef->hitRef != NULL && rayRef->hitRef->type == MESH_T)
+				rayRef->meshHit = threadMeshHit;
+		}
+		return;
+	}
+
+	for (int first = 0; first < count; first += KERNEL_CHUNK) {
+		int chunk = count - first < KERNEL_CHUNK ? count - first : KERNEL_CHUNK;
+
+		for (int k = 0; k < chunk; k++) {
+			WavefrontRay *rayRef = &rays[order[first + k]];
+			STATS_DEPTH(rayRef->depth);
+			batchRef->originX[k] = rayRef->origin.data.X;
+			batchRef->originY[k] = rayRef->origin.data.Y;
+			batchRef->originZ[k] = rayRef->origin.data.Z;
+			batchRef->directionX[k] = rayRef->direction.data.X;
+			batchRef->directionY[k] = rayRef->direction.data.Y;
+			batchRef->directionZ[k] = rayRef->direction.data.Z;
+			batchRef->distances[k] = INFINITY;
+			batchRef->ignore[k] = rayRef->ignoreSphere;
+			batchRef->hits[k] = -1;
+		}
+		STATS_ADD(sphereTests, (uint64_t) packRef->spheresLength * chunk);
+		kernels.closest_spheres(packRef, batchRef, chunk);
+
+		for (int k = 0; k < chunk; k++) {
+			WavefrontRay *rayRef = &rays[order[first + k]];
+			int sphere = batchRef->hits[k];
+			Primitive *sphereRef = sphere >= 0 ? packRef->spheres[sphere] : NULL;
+			int closestIndex = sphere >= 0 ? packRef->sphereIndices[sphere] : sceneRef->primitivesLength;
+
+			rayRef->distance = batchRef->distances[k];
+			rayRef->hitRef = find_closest_unpacked_hit(&rayRef->origin, &rayRef->direction, sceneRef, rayRef->ignore,
+													   sphereRef, closestIndex, &rayRef->distance);
+			rayRef->hitSphere = rayRef->hitRef == sphereRef ? sphere : -1;
+			if (rayRef->hitRef != NULL && rayRef->hitRef->type == MESH_T)
+				rayRef->meshHit = threadMeshHit;
+		}
+	}
+}
+
+/**
+ * Add a reflection or refraction ray to the next generation
+ */
+static int queue_ray(WavefrontRay *rays, int *nextRef, V3 *originRef, V3 *directionRef, Primitive *ignore,
+					 int ignoreSphere, int depth) {
+	WavefrontRay *rayRef = &rays[*nextRef];
+
+	rayRef->origin = *originRef;
+	rayRef->direction = *directionRef;
+	rayRef->ignore = ignore;
+	rayRef->ignoreSphere = ignoreSphere;
+	rayRef->depth = depth;
+	return (*nextRef)++;
+}
+
+/**
+ * Raycasts a tile one generation of rays at a time instead of following every ray to its full depth:
+ * the camera rays are all traced and shaded, spawning the reflection and refraction rays of the next
+ * generation, which is sorted and traced in bulk in turn. Once no rays are left the colors are blended
+ * from the deepest rays back to the camera rays, in the same order as the recursion so the image is
+ * identical to a normal render.
+ * @param contextRef - The shared state of the render
+ * @param tileX - The first column of the tile
+ * @param tileY - The first row of the tile
+ * @param tileEndX - One past the last column of the tile
+ * @param tileEndY - One past the last row of the tile
+ * @return 0 if success, otherwise the rays did not fit in memory and nothing was written
+ */
+int render_tile_wavefront(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY) {
+	Scene *sceneRef = contextRef->sceneRef;
+	int tileWidth = tileEndX - tileX;
+	int first = 0;
+	int end = tileWidth * (tileEndY - tileY);
+	V3 point = {{0, 0, 1}};
+	WavefrontRay *rays;
+	int *order;
+	RGBAColor colorFound;
+
+	if (wavefront_reserve(end, end) != 0)
+		return 1;
+
+	// The camera rays of a tile are coherent already and are traced in scanline order
+	rays = threadRays;
+	for (int i=tileY; i<tileEndY; i++) {
+		point.data.Y = -(0 - sceneRef->camera.height/2.0 + contextRef->pixelHeight * (contextRef->originY + i + 0.5));
+		for (int j=tileX; j<tileEndX; j++) {
+			WavefrontRay *rayRef = &rays[(i - tileY)*tileWidth + j - tileX];
+			point.data.X = 0 - sceneRef->camera.width/2.0 + contextRef->pixelWidth * (contextRef->originX + j + 0.5);
+			v3_normalize(&point, &rayRef->direction);
+			rayRef->origin.array[0] = 0;
+			rayRef->origin.array[1] = 0;
+			rayRef->origin.array[2] = 0;
+			rayRef->ignore = NULL;
+			rayRef->ignoreSphere = -1;
+			rayRef->depth = 0;
+			threadOrder[rayRef - rays] = (int) (rayRef - rays);
+			STATS_INC(cameraRays);
+		}
+	}
+
+	while (first < end) {
+		int next = end;
+
+		// Every ray can spawn a reflection and a refraction ray
+		if (wavefront_reserve(end + 2 * (end - first), end - first) != 0)
+			return 1;
+		rays = threadRays;
+		order = threadOrder;
+		if (first > 0)
+			bin_generation(rays, first, end, order, threadBins);
+
+		// Find what every ray of the generation hits
+		intersect_generation(sceneRef, rays, order, end - first);
+
+		// Then light every hit and queue the rays it spawns
+		for (int k = 0; k < end - first; k++) {
+			WavefrontRay *rayRef = &rays[order[k]];
+			SecondaryRays secondary;
+			V3 position;
+			V3 normal;
+
+			rayRef->reflection = -1;
+			rayRef->refraction = -1;
+			if (rayRef->hitRef == NULL) {
+				rayRef->color.array[0] = 0;
+				rayRef->color.array[1] = 0;
+				rayRef->color.array[2] = 0;
+				continue;
+			}
+
+			threadMeshHit = rayRef->meshHit;
+			v3_scale(&rayRef->direction, rayRef->distance, &position);
+			v3_add(&rayRef->origin, &position, &position);
+			surface_normal(rayRef->hitRef, &position, &normal);
+			shade_direct(&rayRef->direction, sceneRef, rayRef->hitRef, &position, &normal, &rayRef->color, rayRef->depth,
+						 &secondary);
+
+			if (secondary.reflect) {
+				STATS_INC(reflectionRays);
+				rayRef->reflectivity = secondary.reflectivity;
+				rayRef->reflection = queue_ray(rays, &next, &secondary.reflectionOrigin, &secondary.reflectionDirection,
+											   NULL, -1, rayRef->depth + 1);
+			}
+			if (secondary.refract) {
+				STATS_INC(refractionRays);
+				rayRef->refractivity = secondary.refractivity;
+				rayRef->refraction = queue_ray(rays, &next, &secondary.refractionOrigin, &rayRef->direction,
+											   rayRef->hitRef, rayRef->hitSphere, rayRef->depth + 1);
+			}
+		}
+
+		first = end;
+		end = next;
+	}
+
+	// Spawned rays come after their parent, so walking back finishes every color before it is blended in
+	for (int i = end - 1; i >= 0; i--) {
+		WavefrontRay *rayRef = &rays[i];
+		SecondaryRays secondary;
+
+		if (rayRef->reflection < 0 && rayRef->refraction < 0)
+			continue;
+		secondary.reflect = rayRef->reflection >= 0;
+		secondary.refract = rayRef->refraction >= 0;
+		secondary.reflectivity = rayRef->reflectivity;
+		secondary.refractivity = rayRef->refractivity;
+		blend_secondary(&secondary, secondary.reflect ? &rays[rayRef->reflection].color : NULL,
+						secondary.refract ? &rays[rayRef->refraction].color : NULL, &rayRef->color);
+	}
+
+	// The camera rays come first in the order of the pixels of the tile in the framebuffer
+	RGBApixel *tilePixels = render_tile_pixels(contextRef, tileX, tileY);
+	for (int k=0; k<tileWidth*(tileEndY - tileY); k++) {
+		color_to_rgba(&rays[k].color, &colorFound);
+		shade(&colorFound, &tilePixels[k]);
+	}
+	return 0;
+}
@@ -0,0 +1,42 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#ifndef CS430_PROJECT_2_BASIC_RAYCASTER_WAVEFRONT_H
+#define CS430_PROJECT_2_BASIC_RAYCASTER_WAVEFRONT_H
+
+#include <stdint.h>
+#include "3dmath.h"
+#include "raycaster.h"
+#include "mesh.h"
+
+// Bits per axis of the grid over the ray origins of a generation that rays are sorted by
+#define WAVEFRONT_CELL_BITS 2
+
+/**
+ * Wavefront Ray - a ray of a tile waiting in its generation, then the point it hit, its color and the
+ * rays it spawned. Spheres are also numbered by their place in the scene's primitive pack, -1 for none.
+ * A ray is always stored after the ray that spawned it, so the colors of a tile are blended from the
+ * last ray back to the first.
+ */
+typedef struct WavefrontRay {
+	V3 origin;
+	V3 direction;
+	Primitive *ignore;
+	Primitive *hitRef;
+	int ignoreSphere;
+	int hitSphere;
+	double distance;
+	MeshHit meshHit;
+	V3 color;
+	double reflectivity;
+	double refractivity;
+	int reflection;
+	int refraction;
+	int depth;
+} WavefrontRay;
+
+int render_tile_wavefront(RenderContext *contextRef, int tileX, int tileY, int tileEndX, int tileEndY);
+void wavefront_thread_free();
+
+#endif //CS430_PROJECT_2_BASIC_RAYCASTER_WAVEFRONT_H
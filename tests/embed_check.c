@@ -0,0 +1,163 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../src/libraytrace.h"
+
+// Renders of the same scene running at the same time, each with its own render threads
+#define EMBED_RENDERS 2
+#define EMBED_RENDER_THREADS 2
+
+// Scenes the library must refuse without crashing or leaking, a leak shows in a build with -fsanitize=address
+static const char *badScenes[] = {
+	// No camera
+	"[{\"type\": \"sphere\", \"radius\": 1, \"position\": [0, 0, 5], \"diffuse_color\": [1, 0, 0], \"specular_color\": [1, 1, 1]},"
+	" {\"type\": \"sphere\", \"radius\": 1, \"position\": [2, 0, 5], \"diffuse_color\": [0, 1, 0], \"specular_color\": [1, 1, 1]},"
+	" {\"type\": \"sphere\", \"radius\": 1, \"position\": [4, 0, 5], \"diffuse_color\": [0, 0, 1], \"specular_color\": [1, 1, 1]}]",
+	// Two cameras
+	"[{\"type\": \"camera\", \"width\": 1, \"height\": 1},"
+	" {\"type\": \"camera\", \"width\": 1, \"height\": 1}]",
+	// A light without a color
+	"[{\"type\": \"camera\", \"width\": 1, \"height\": 1},"
+	" {\"type\": \"sphere\", \"radius\": 1, \"position\": [0, 0, 5], \"diffuse_color\": [1, 0, 0], \"specular_color\": [1, 1, 1]},"
+	" {\"type\": \"light\", \"position\": [0, 5, 0], \"radial-a0\": 1}]",
+	// Truncated JSON
+	"[{\"type\": \"camera\", \"width\": 1, \"height\": 1},"
+	" {\"type\": \"sphere\", \"radius\": 1, \"position\": [0, 0",
+	// A truncated string
+	"[{\"type\": \"cam",
+};
+
+/**
+ * One render of the check, with the progress it was told about
+ */
+typedef struct EmbedRender {
+	RaytraceScene *sceneRef;
+	int width;
+	int height;
+	uint8_t *pixels;
+	int lastRendered;
+	int lastLength;
+	int backwards;
+	int result;
+} EmbedRender;
+
+/**
+ * Record a progress call, counts must never go backwards
+ */
+static void embed_progress(int tilesRendered, int tilesLength, void *dataRef) {
+	EmbedRender *renderRef = dataRef;
+
+	if (tilesRendered < renderRef->lastRendered)
+		renderRef->backwards = 1;
+	renderRef->lastRendered = tilesRendered;
+	renderRef->lastLength = tilesLength;
+}
+
+/**
+ * Run one render through the library
+ */
+static void *embed_render(void *argRef) {
+	EmbedRender *renderRef = argRef;
+
+	renderRef->result = raytrace_render(renderRef->sceneRef, renderRef->width, renderRef->height, EMBED_RENDER_THREADS,
+										renderRef->pixels, embed_progress, renderRef);
+	return NULL;
+}
+
+/**
+ * Read a whole file into memory
+ * @return The contents, or NULL if the file could not be read
+ */
+static char *read_file(const char *fname, size_t *lengthRef) {
+	FILE *fp = fopen(fname, "rb");
+	char *buffer;
+
+	if (fp == NULL)
+		return NULL;
+	fseek(fp, 0, SEEK_END);
+	*lengthRef = (size_t) ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buffer = malloc(*lengthRef > 0 ? *lengthRef : 1);
+	if (buffer != NULL && fread(buffer, 1, *lengthRef, fp) != *lengthRef) {
+		free(buffer);
+		buffer = NULL;
+	}
+	fclose(fp);
+	return buffer;
+}
+
+/**
+ * Embeds the renderer the way a service would: loads a scene from memory, renders it several times at
+ * once into buffers, and checks the renders agree and reported their progress. The first image is
+ * written out as a PPM P6 so it can be compared against a reference with imgcmp.
+ */
+int main(int argc, char *argv[]) {
+	EmbedRender renders[EMBED_RENDERS];
+	pthread_t threadIds[EMBED_RENDERS];
+	RaytraceScene *sceneRef;
+	size_t length;
+	int failures = 0;
+
+	if (argc != 5) {
+		fprintf(stderr, "Usage: embed-check <scene.json> <width> <height> <output.ppm>\n");
+		return 2;
+	}
+	int width = atoi(argv[2]);
+	int height = atoi(argv[3]);
+
+	for (size_t i = 0; i < sizeof(badScenes) / sizeof(badScenes[0]); i++) {
+		if (raytrace_scene_load(badScenes[i], strlen(badScenes[i]), &sceneRef) == 0) {
+			fprintf(stderr, "Error: Bad scene %zu was loaded\n", i);
+			raytrace_scene_free(sceneRef);
+			failures++;
+		}
+	}
+
+	char *buffer = read_file(argv[1], &length);
+	if (buffer == NULL) {
+		fprintf(stderr, "Error: File '%s' could not be read\n", argv[1]);
+		return 1;
+	}
+	int result = raytrace_scene_load(buffer, length, &sceneRef);
+	// The scene must not depend on the buffer it was loaded from
+	free(buffer);
+	if (result != 0)
+		return 1;
+
+	for (int i = 0; i < EMBED_RENDERS; i++) {
+		renders[i] = (EmbedRender) {sceneRef, width, height, malloc((size_t) width * height * 4), 0, 0, 0, 1};
+		pthread_create(&threadIds[i], NULL, embed_render, &renders[i]);
+	}
+	for (int i = 0; i < EMBED_RENDERS; i++) {
+		pthread_join(threadIds[i], NULL);
+		if (renders[i].result != 0 || renders[i].backwards || renders[i].lastLength == 0 ||
+			renders[i].lastRendered != renders[i].lastLength) {
+			fprintf(stderr, "Error: Render %d failed or did not report every tile\n", i);
+			failures++;
+		}
+		else if (memcmp(renders[i].pixels, renders[0].pixels, (size_t) width * height * 4) != 0) {
+			fprintf(stderr, "Error: Render %d differs from render 0\n", i);
+			failures++;
+		}
+	}
+
+	FILE *fp = fopen(argv[4], "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", argv[4]);
+		return 1;
+	}
+	fprintf(fp, "P6\n%d %d\n255\n", width, height);
+	for (size_t k = 0; k < (size_t) width * height; k++)
+		fwrite(&renders[0].pixels[k * 4], 1, 3, fp);
+	fclose(fp);
+
+	for (int i = 0; i < EMBED_RENDERS; i++)
+		free(renders[i].pixels);
+	raytrace_scene_free(sceneRef);
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "../src/imaging.h"
+#include "../src/ppm.h"
+
+#define DEFAULT_TOLERANCE 2
+#define DEFAULT_MAX_BAD_FRACTION 0.001
+#define DEFAULT_MIN_SSIM 0.99
+#define SSIM_WINDOW 8
+#define SSIM_STRIDE 4
+
+/**
+ * Luma of a pixel using the Rec. 601 weights
+ */
+static double luma(RGBApixel *pixel) {
+	return 0.299 * pixel->r + 0.587 * pixel->g + 0.114 * pixel->b;
+}
+
+/**
+ * Mean structural similarity (SSIM) of the luma of two images of the same size, computed over
+ * SSIM_WINDOW sized windows every SSIM_STRIDE pixels
+ * @return The mean SSIM, 1 for identical images
+ */
+static double mean_ssim(Image *a, Image *b) {
+	const double C1 = pow(0.01 * 255, 2);
+	const double C2 = pow(0.03 * 255, 2);
+	double total = 0;
+	int windows = 0;
+	int windowWidth = a->width < SSIM_WINDOW ? (int) a->width : SSIM_WINDOW;
+	int windowHeight = a->height < SSIM_WINDOW ? (int) a->height : SSIM_WINDOW;
+
+	for (int y = 0; y + windowHeight <= (int) a->height; y += SSIM_STRIDE) {
+		for (int x = 0; x + windowWidth <= (int) a->width; x += SSIM_STRIDE) {
+			double sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+			int n = windowWidth * windowHeight;
+
+			for (int i = y; i < y + windowHeight; i++) {
+				for (int j = x; j < x + windowWidth; j++) {
+					double la = luma(&a->pixmapRef[i*a->width + j]);
+					double lb = luma(&b->pixmapRef[i*b->width + j]);
+					sumA += la;
+					sumB += lb;
+					sumAA += la * la;
+					sumBB += lb * lb;
+					sumAB += la * lb;
+				}
+			}
+
+			double meanA = sumA / n;
+			double meanB = sumB / n;
+			double varA = sumAA / n - meanA * meanA;
+			double varB = sumBB / n - meanB * meanB;
+			double covariance = sumAB / n - meanA * meanB;
+
+			total += ((2 * meanA * meanB + C1) * (2 * covariance + C2)) /
+					 ((meanA * meanA + meanB * meanB + C1) * (varA + varB + C2));
+			windows++;
+		}
+	}
+
+	return windows > 0 ? total / windows : 1;
+}
+
+/**
+ * Show a simple help message about the usage of this program
+ */
+static void show_help() {
+	printf("Usage: imgcmp [options] <image> <reference>\n");
+	printf("\t --tolerance <n>: Per channel difference allowed before a pixel counts as different (default %d)\n", DEFAULT_TOLERANCE);
+	printf("\t --max-bad-fraction <f>: Fraction of pixels allowed to exceed the tolerance (default %g)\n", DEFAULT_MAX_BAD_FRACTION);
+	printf("\t --min-ssim <s>: Lowest acceptable mean SSIM of the luma (default %g)\n", DEFAULT_MIN_SSIM);
+	printf("\n");
+	printf("\t Exits with 0 if the images match within the tolerances, 1 if they do not, 2 on error\n");
+}
+
+int main(int argc, char *argv[]) {
+	int tolerance = DEFAULT_TOLERANCE;
+	double maxBadFraction = DEFAULT_MAX_BAD_FRACTION;
+	double minSsim = DEFAULT_MIN_SSIM;
+	char *positional[2];
+	int positionalLength = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "--", 2) != 0 && positionalLength < 2)
+			positional[positionalLength++] = argv[i];
+		else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+			tolerance = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--max-bad-fraction") == 0 && i + 1 < argc)
+			maxBadFraction = atof(argv[++i]);
+		else if (strcmp(argv[i], "--min-ssim") == 0 && i + 1 < argc)
+			minSsim = atof(argv[++i]);
+		else {
+			fprintf(stderr, "Error: Unknown or incomplete argument '%s'\n", argv[i]);
+			show_help();
+			return 2;
+		}
+	}
+
+	if (positionalLength != 2) {
+		show_help();
+		return 2;
+	}
+
+	Image image;
+	Image reference;
+	if (load_ppm_p6_image(&image, positional[0]) != 0 || load_ppm_p6_image(&reference, positional[1]) != 0)
+		return 2;
+
+	if (image.width != reference.width || image.height != reference.height) {
+		printf("FAIL size %ux%u, expected %ux%u\n", image.width, image.height, reference.width, reference.height);
+		return 1;
+	}
+
+	uint32_t length = image.width * image.height;
+	uint32_t badPixels = 0;
+	int maxDifference = 0;
+	double squaredError = 0;
+
+	for (uint32_t i = 0; i < length; i++) {
+		int difference[3] = {
+			abs(image.pixmapRef[i].r - reference.pixmapRef[i].r),
+			abs(image.pixmapRef[i].g - reference.pixmapRef[i].g),
+			abs(image.pixmapRef[i].b - reference.pixmapRef[i].b)
+		};
+		int pixelDifference = 0;
+		for (int c = 0; c < 3; c++) {
+			squaredError += difference[c] * difference[c];
+			if (difference[c] > pixelDifference)
+				pixelDifference = difference[c];
+		}
+		if (pixelDifference > maxDifference)
+			maxDifference = pixelDifference;
+		if (pixelDifference > tolerance)
+			badPixels++;
+	}
+
+	double badFraction = (double) badPixels / length;
+	double mse = squaredError / (length * 3.0);
+	double psnr = mse > 0 ? 10 * log10(255.0 * 255.0 / mse) : INFINITY;
+	double ssim = mean_ssim(&image, &reference);
+	int pass = badFraction <= maxBadFraction && ssim >= minSsim;
+
+	printf("%s max_diff=%d bad_pixels=%u (%.5f%%) psnr=%.2f ssim=%.5f\n", pass ? "PASS" : "FAIL",
+		   maxDifference, badPixels, badFraction * 100, psnr, ssim);
+
+	free(image.pixmapRef);
+	free(reference.pixmapRef);
+	return pass ? 0 : 1;
+}
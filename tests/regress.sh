@@ -0,0 +1,119 @@
+#!/bin/sh
+#
+# Golden image and throughput regression suite. Every render in the corpus is compared against its
+# reference image with imgcmp, and its rays/s is compared against a locally recorded baseline.
+#
+# Usage: tests/regress.sh [options]
+#   --raytrace <path>     The raytrace binary (default ./raytrace)
+#   --imgcmp <path>       The imgcmp binary (default ./imgcmp)
+#   --corpus <file>       The corpus to run (default tests/corpus.txt)
+#   --baseline <file>     Throughput baseline (default tests/throughput_baseline.txt)
+#   --margin <f>          Fail when rays/s drops more than this fraction below the baseline (default 0.2)
+#   --tolerance <n>       Per channel tolerance passed to imgcmp (default 2)
+#   --min-ssim <s>        Lowest acceptable SSIM passed to imgcmp (default 0.99)
+#   --update-baseline     Record the measured throughput as the new baseline
+#   --update-golden       Replace the reference images with the new renders
+#
+# The throughput check only runs when a baseline exists, since rays/s is specific to the machine.
+
+RAYTRACE=./raytrace
+IMGCMP=./imgcmp
+CORPUS=tests/corpus.txt
+BASELINE=tests/throughput_baseline.txt
+MARGIN=${REGRESS_MARGIN:-0.2}
+TOLERANCE=2
+MIN_SSIM=0.99
+UPDATE_BASELINE=0
+UPDATE_GOLDEN=0
+
+while [ $# -gt 0 ]; do
+	case "$1" in
+		--raytrace) RAYTRACE=$2; shift ;;
+		--imgcmp) IMGCMP=$2; shift ;;
+		--corpus) CORPUS=$2; shift ;;
+		--baseline) BASELINE=$2; shift ;;
+		--margin) MARGIN=$2; shift ;;
+		--tolerance) TOLERANCE=$2; shift ;;
+		--min-ssim) MIN_SSIM=$2; shift ;;
+		--update-baseline) UPDATE_BASELINE=1 ;;
+		--update-golden) UPDATE_GOLDEN=1 ;;
+		*) echo "Error: Unknown argument '$1'" >&2; exit 2 ;;
+	esac
+	shift
+done
+
+OUT=$(mktemp -d "${TMPDIR:-/tmp}/raytrace-regress.XXXXXX") || exit 2
+trap 'rm -rf "$OUT"' EXIT
+
+if [ "$UPDATE_BASELINE" -eq 1 ]; then
+	: > "$OUT/baseline.txt"
+fi
+
+failures=0
+cases=0
+
+printf "%-28s %-6s %10s %14s %14s  %s\n" "case" "image" "wall (s)" "rays/s" "baseline" "details"
+
+while read -r name width height scene reference options; do
+	case "$name" in
+		''|'#'*) continue ;;
+	esac
+	cases=$((cases + 1))
+	output="$OUT/$name.ppm"
+	stats="$OUT/$name.json"
+	# @OUT@ in the options names the scratch directory, so one case can read a file an earlier case wrote
+	options=$(echo "$options" | sed "s|@OUT@|$OUT|g")
+
+	# Options from the corpus come last so that they can override the defaults
+	if ! $RAYTRACE --threads 1 --stats-json "$stats" $options "$width" "$height" "$scene" "$output" > "$OUT/$name.log" 2>&1; then
+		echo "$name: FAIL raytrace exited with an error"
+		cat "$OUT/$name.log"
+		failures=$((failures + 1))
+		continue
+	fi
+
+	if [ "$UPDATE_GOLDEN" -eq 1 ]; then
+		cp "$output" "$reference"
+	fi
+
+	comparison=$($IMGCMP --tolerance "$TOLERANCE" --min-ssim "$MIN_SSIM" "$output" "$reference")
+	imageStatus=$?
+
+	wall=$(sed -n 's/.*"render": {"wall_seconds": \([0-9.]*\).*/\1/p' "$stats")
+	rays=$(sed -n 's/.*"rays_per_second": \([0-9.]*\).*/\1/p' "$stats")
+	expected=""
+	if [ -f "$BASELINE" ]; then
+		expected=$(awk -v name="$name" '$1 == name { print $2 }' "$BASELINE")
+	fi
+
+	throughputStatus=0
+	if [ -n "$expected" ]; then
+		throughputStatus=$(awk -v rays="$rays" -v expected="$expected" -v margin="$MARGIN" \
+			'BEGIN { print (rays < expected * (1 - margin)) ? 1 : 0 }')
+	fi
+
+	imageResult=PASS
+	if [ "$imageStatus" -ne 0 ]; then
+		imageResult=FAIL
+	fi
+	printf "%-28s %-6s %10.4f %14.0f %14s  %s\n" "$name" "$imageResult" "$wall" "$rays" "${expected:--}" "$comparison"
+
+	if [ "$imageStatus" -ne 0 ]; then
+		failures=$((failures + 1))
+	elif [ "$throughputStatus" -ne 0 ]; then
+		echo "$name: FAIL throughput dropped more than $MARGIN below the baseline"
+		failures=$((failures + 1))
+	fi
+
+	if [ "$UPDATE_BASELINE" -eq 1 ]; then
+		echo "$name $rays" >> "$OUT/baseline.txt"
+	fi
+done < "$CORPUS"
+
+if [ "$UPDATE_BASELINE" -eq 1 ]; then
+	cp "$OUT/baseline.txt" "$BASELINE"
+	echo "Recorded throughput baseline in '$BASELINE'"
+fi
+
+echo "$((cases - failures)) of $cases cases passed"
+[ "$failures" -eq 0 ]
@@ -0,0 +1,456 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "../src/3dmath.h"
+#include "../src/constants.h"
+
+#define DEFAULT_SPHERES 100
+#define DEFAULT_PLANES 5
+#define DEFAULT_LIGHTS 4
+#define DEFAULT_CLUSTERS 8
+#define DEFAULT_EXTENT 10.0
+#define DEFAULT_SEED 430
+
+/**
+ * Supported spatial distributions of the generated spheres
+ */
+typedef enum Distribution_t {
+	UNIFORM_T,
+	CLUSTERED_T,
+	GRID_T
+} Distribution_t;
+
+/**
+ * All of the generator parameters
+ */
+typedef struct GeneratorOptions {
+	int spheres;
+	int planes;
+	int lights;
+	int clusters;
+	int materials;
+	Distribution_t distribution;
+	double extent;
+	double spotlightFraction;
+	double reflectiveFraction;
+	double refractiveFraction;
+	double lightIntensity;
+	double radialA2;
+	double radialA1;
+	double radialA0;
+	uint64_t seed;
+} GeneratorOptions;
+
+static uint64_t rngState;
+
+/**
+ * xorshift64* - a small, reproducible random number generator
+ * @return A random number in the range [0, 1)
+ */
+static double random_unit() {
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (double) ((rngState * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * A normally distributed random number using the Box-Muller transform
+ * @return A random number with a mean of 0 and a standard deviation of 1
+ */
+static double random_normal() {
+	double u1 = random_unit();
+	double u2 = random_unit();
+	if (u1 < 1e-12)
+		u1 = 1e-12;
+	return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+/**
+ * Map a point in the unit cube to the visible volume in front of the camera. The camera sits at the
+ * origin looking down +Z with a 1x1 view plane at Z = 1, so the visible half width at depth z is z/2.
+ * @param unitRef - A point in [0, 1]^3
+ * @param extent - The depth of the scene volume
+ * @param result - The world space position
+ */
+static void unit_to_world(V3 *unitRef, double extent, V3 *result) {
+	double z = extent + unitRef->data.Z * 2 * extent;
+	result->data.X = (unitRef->data.X - 0.5) * 0.9 * z;
+	result->data.Y = (unitRef->data.Y - 0.5) * 0.9 * z;
+	result->data.Z = z;
+}
+
+static double clamp_unit(double a) {
+	if (a < 0)
+		return 0;
+	if (a > 1)
+		return 1;
+	return a;
+}
+
+static void print_v3(FILE *fp, const char *key, V3 *a) {
+	fprintf(fp, "    \"%s\": [%.4f, %.4f, %.4f]", key, a->data.X, a->data.Y, a->data.Z);
+}
+
+/**
+ * The material properties of a generated primitive
+ */
+typedef struct GeneratedMaterial {
+	V3 diffuse;
+	double reflectivity;
+	double refractivity;
+	double ior;
+} GeneratedMaterial;
+
+/**
+ * Draw a random material, with a reflectivity/refractivity mix controlled by the generator options
+ */
+static void draw_material(GeneratorOptions *optionsRef, GeneratedMaterial *materialRef) {
+	double roll = random_unit();
+
+	materialRef->reflectivity = 0;
+	materialRef->refractivity = 0;
+	materialRef->ior = 1;
+	if (roll < optionsRef->reflectiveFraction) {
+		materialRef->reflectivity = 0.2 + 0.7 * random_unit();
+	}
+	else if (roll < optionsRef->reflectiveFraction + optionsRef->refractiveFraction) {
+		materialRef->refractivity = 0.3 + 0.6 * random_unit();
+		materialRef->ior = 1 + 0.6 * random_unit();
+	}
+
+	// Draw the components one at a time, initializer evaluation order is unspecified
+	for (int j = 0; j < 3; j++)
+		materialRef->diffuse.array[j] = random_unit();
+}
+
+/**
+ * Write the material properties of a primitive, a new random material or one of the palette
+ * @param fp - The file to write to
+ * @param optionsRef - The generator options
+ * @param palette - The optionsRef->materials materials to pick from, or NULL to draw a new one
+ */
+static void print_material(FILE *fp, GeneratorOptions *optionsRef, GeneratedMaterial *palette) {
+	GeneratedMaterial material;
+	V3 specular = {{1, 1, 1}};
+
+	if (palette != NULL)
+		material = palette[(int) (random_unit() * optionsRef->materials)];
+	else
+		draw_material(optionsRef, &material);
+
+	print_v3(fp, "diffuse_color", &material.diffuse);
+	fprintf(fp, ",\n");
+	print_v3(fp, "specular_color", &specular);
+	fprintf(fp, ",\n");
+	fprintf(fp, "    \"reflectivity\": %.4f,\n", material.reflectivity);
+	fprintf(fp, "    \"refractivity\": %.4f,\n", material.refractivity);
+	fprintf(fp, "    \"ior\": %.4f", material.ior);
+}
+
+/**
+ * Generate the sphere centers in unit cube coordinates for the selected distribution
+ * @param optionsRef - The generator options
+ * @param centers - An array of optionsRef->spheres vectors to populate
+ * @return The base radius of the generated spheres in unit cube coordinates
+ */
+static double generate_sphere_centers(GeneratorOptions *optionsRef, V3 *centers) {
+	int count = optionsRef->spheres;
+
+	if (optionsRef->distribution == GRID_T) {
+		int side = (int) ceil(cbrt(count));
+		if (side < 1)
+			side = 1;
+		double spacing = 1.0 / side;
+		for (int i = 0; i < count; i++) {
+			centers[i].data.X = spacing * (i % side + 0.5);
+			centers[i].data.Y = spacing * ((i / side) % side + 0.5);
+			centers[i].data.Z = spacing * (i / (side * side) + 0.5);
+		}
+		return spacing * 0.4;
+	}
+
+	if (optionsRef->distribution == CLUSTERED_T) {
+		int clusters = optionsRef->clusters > 0 ? optionsRef->clusters : 1;
+		V3 *clusterCenters = malloc(sizeof(V3) * clusters);
+		for (int i = 0; i < clusters; i++) {
+			for (int j = 0; j < 3; j++)
+				clusterCenters[i].array[j] = 0.15 + 0.7 * random_unit();
+		}
+		for (int i = 0; i < count; i++) {
+			V3 *clusterRef = &clusterCenters[(int) (random_unit() * clusters)];
+			for (int j = 0; j < 3; j++)
+				centers[i].array[j] = clamp_unit(clusterRef->array[j] + random_normal() * 0.05);
+		}
+		free(clusterCenters);
+		return 0.25 / cbrt(count > 0 ? count : 1);
+	}
+
+	for (int i = 0; i < count; i++) {
+		for (int j = 0; j < 3; j++)
+			centers[i].array[j] = random_unit();
+	}
+	return 0.25 / cbrt(count > 0 ? count : 1);
+}
+
+/**
+ * Write a complete scene in the format read by create_scene_from_JSON
+ * @param fp - The file to write to
+ * @param optionsRef - The generator options
+ */
+static void generate_scene(FILE *fp, GeneratorOptions *optionsRef) {
+	double extent = optionsRef->extent;
+	V3 *centers = malloc(sizeof(V3) * (optionsRef->spheres > 0 ? optionsRef->spheres : 1));
+	double baseRadius = generate_sphere_centers(optionsRef, centers);
+	GeneratedMaterial *palette = NULL;
+
+	// A palette is drawn after the placement so the positions match a scene without one
+	if (optionsRef->materials > 0) {
+		palette = malloc(sizeof(GeneratedMaterial) * optionsRef->materials);
+		for (int i = 0; i < optionsRef->materials; i++)
+			draw_material(optionsRef, &palette[i]);
+	}
+
+	fprintf(fp, "[\n");
+	fprintf(fp, "  {\n    \"type\": \"camera\",\n    \"width\": 1.0,\n    \"height\": 1.0\n  }");
+
+	for (int i = 0; i < optionsRef->spheres; i++) {
+		V3 position;
+		unit_to_world(&centers[i], extent, &position);
+		// Spheres are scaled with depth so that they cover a similar part of the screen everywhere
+		double radius = baseRadius * fmin(0.9 * position.data.Z, 2 * extent) * (optionsRef->distribution == GRID_T ? 1 : 0.5 + 0.5 * random_unit());
+
+		fprintf(fp, ",\n  {\n    \"type\": \"sphere\",\n");
+		print_v3(fp, "position", &position);
+		fprintf(fp, ",\n    \"radius\": %.4f,\n", radius);
+		print_material(fp, optionsRef, palette);
+		fprintf(fp, "\n  }");
+	}
+
+	// The first planes close the volume (floor, back, left, right, ceiling), any further planes are
+	// nested shells outside of the volume which only add intersection work
+	for (int i = 0; i < optionsRef->planes; i++) {
+		V3 position = {{0, 0, 0}};
+		V3 normal = {{0, 0, 0}};
+		double shell = 1 + i / 5;
+		double halfWidth = 0.5 * 3 * extent * shell;
+
+		switch (i % 5) {
+			case 0:
+				position.data.Y = -halfWidth;
+				normal.data.Y = 1;
+				break;
+			case 1:
+				position.data.Z = 3 * extent * shell + extent;
+				normal.data.Z = -1;
+				break;
+			case 2:
+				position.data.X = -halfWidth;
+				normal.data.X = 1;
+				break;
+			case 3:
+				position.data.X = halfWidth;
+				normal.data.X = -1;
+				break;
+			case 4:
+				position.data.Y = halfWidth;
+				normal.data.Y = -1;
+				break;
+		}
+
+		fprintf(fp, ",\n  {\n    \"type\": \"plane\",\n");
+		print_v3(fp, "position", &position);
+		fprintf(fp, ",\n");
+		print_v3(fp, "normal", &normal);
+		fprintf(fp, ",\n");
+		print_material(fp, optionsRef, palette);
+		fprintf(fp, "\n  }");
+	}
+
+	for (int i = 0; i < optionsRef->lights; i++) {
+		V3 unit;
+		V3 position;
+		V3 color;
+		for (int j = 0; j < 3; j++)
+			unit.array[j] = random_unit();
+		unit_to_world(&unit, extent, &position);
+		for (int j = 0; j < 3; j++)
+			color.array[j] = optionsRef->lightIntensity * (0.5 + 0.5 * random_unit());
+
+		fprintf(fp, ",\n  {\n    \"type\": \"light\",\n");
+		print_v3(fp, "position", &position);
+		fprintf(fp, ",\n");
+		print_v3(fp, "color", &color);
+		fprintf(fp, ",\n    \"radial-a2\": %.4f,\n    \"radial-a1\": %.4f,\n    \"radial-a0\": %.4f",
+				optionsRef->radialA2, optionsRef->radialA1, optionsRef->radialA0);
+
+		if (random_unit() < optionsRef->spotlightFraction) {
+			// Aim the spotlight at a random point in the volume
+			V3 target;
+			V3 direction;
+			for (int j = 0; j < 3; j++)
+				unit.array[j] = random_unit();
+			unit_to_world(&unit, extent, &target);
+			v3_subtract(&target, &position, &direction);
+			v3_normalize(&direction, &direction);
+
+			fprintf(fp, ",\n    \"theta\": %.4f,\n    \"angular-a0\": %.4f,\n", 15 + 30 * random_unit(), 2 + 8 * random_unit());
+			print_v3(fp, "direction", &direction);
+		}
+		fprintf(fp, "\n  }");
+	}
+
+	fprintf(fp, "\n]\n");
+	free(centers);
+	free(palette);
+}
+
+/**
+ * Show a simple help message about the usage of this program
+ */
+static void show_help() {
+	printf("Usage: scenegen [options]\n");
+	printf("\t --spheres <n>: Number of spheres (default %d)\n", DEFAULT_SPHERES);
+	printf("\t --planes <n>: Number of planes (default %d)\n", DEFAULT_PLANES);
+	printf("\t --lights <n>: Number of lights (default %d)\n", DEFAULT_LIGHTS);
+	printf("\t --spotlights <f>: Fraction of the lights which are spotlights (default 0)\n");
+	printf("\t --distribution <uniform|clustered|grid>: Placement of the spheres (default uniform)\n");
+	printf("\t --clusters <n>: Number of clusters for the clustered distribution (default %d)\n", DEFAULT_CLUSTERS);
+	printf("\t --reflective <f>: Fraction of primitives which are reflective (default 0)\n");
+	printf("\t --refractive <f>: Fraction of primitives which are refractive (default 0)\n");
+	printf("\t --materials <n>: Pick the material of every primitive from a palette of n, 0 draws a new one for each (default 0)\n");
+	printf("\t --extent <d>: Size of the scene volume (default %.1f)\n", DEFAULT_EXTENT);
+	printf("\t --light-intensity <d>: Peak light color component (default scales with extent and light count)\n");
+	printf("\t --radial <a2,a1,a0>: Radial attenuation constants of the lights (default 1,0,0)\n");
+	printf("\t --seed <n>: Seed for the generator (default %d)\n", DEFAULT_SEED);
+	printf("\t --output <file>: Write the scene to <file> instead of stdout\n");
+	printf("\n");
+	printf("\t Example: scenegen --spheres 10000 --lights 64 --distribution clustered --output huge.json\n");
+}
+
+int main(int argc, char *argv[]) {
+	GeneratorOptions options;
+	char *outputFname = NULL;
+
+	options.spheres = DEFAULT_SPHERES;
+	options.planes = DEFAULT_PLANES;
+	options.lights = DEFAULT_LIGHTS;
+	options.clusters = DEFAULT_CLUSTERS;
+	options.materials = 0;
+	options.distribution = UNIFORM_T;
+	options.extent = DEFAULT_EXTENT;
+	options.spotlightFraction = 0;
+	options.reflectiveFraction = 0;
+	options.refractiveFraction = 0;
+	options.lightIntensity = -1;
+	options.radialA2 = 1;
+	options.radialA1 = 0;
+	options.radialA0 = 0;
+	options.seed = DEFAULT_SEED;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--help") == 0) {
+			show_help();
+			return 0;
+		}
+		if (i + 1 >= argc) {
+			fprintf(stderr, "Error: Unknown or incomplete argument '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+		if (strcmp(argv[i], "--spheres") == 0)
+			options.spheres = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--planes") == 0)
+			options.planes = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--lights") == 0)
+			options.lights = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--spotlights") == 0)
+			options.spotlightFraction = atof(argv[++i]);
+		else if (strcmp(argv[i], "--clusters") == 0)
+			options.clusters = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--materials") == 0)
+			options.materials = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--reflective") == 0)
+			options.reflectiveFraction = atof(argv[++i]);
+		else if (strcmp(argv[i], "--refractive") == 0)
+			options.refractiveFraction = atof(argv[++i]);
+		else if (strcmp(argv[i], "--extent") == 0)
+			options.extent = atof(argv[++i]);
+		else if (strcmp(argv[i], "--light-intensity") == 0)
+			options.lightIntensity = atof(argv[++i]);
+		else if (strcmp(argv[i], "--seed") == 0)
+			options.seed = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "--output") == 0)
+			outputFname = argv[++i];
+		else if (strcmp(argv[i], "--radial") == 0) {
+			if (sscanf(argv[++i], "%lf,%lf,%lf", &options.radialA2, &options.radialA1, &options.radialA0) != 3) {
+				fprintf(stderr, "Error: Argument radial must be in the form a2,a1,a0\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--distribution") == 0) {
+			i++;
+			if (strcmp(argv[i], "uniform") == 0)
+				options.distribution = UNIFORM_T;
+			else if (strcmp(argv[i], "clustered") == 0)
+				options.distribution = CLUSTERED_T;
+			else if (strcmp(argv[i], "grid") == 0)
+				options.distribution = GRID_T;
+			else {
+				fprintf(stderr, "Error: Unknown distribution '%s'\n", argv[i]);
+				return 1;
+			}
+		}
+		else {
+			fprintf(stderr, "Error: Unknown argument '%s'\n", argv[i]);
+			show_help();
+			return 1;
+		}
+	}
+
+	if (options.spheres < 0 || options.planes < 0 || options.lights < 0 || options.materials < 0 || options.extent <= 0) {
+		fprintf(stderr, "Error: Object counts must not be negative and the extent must be positive\n");
+		return 1;
+	}
+	if (options.reflectiveFraction < 0 || options.refractiveFraction < 0 ||
+		options.reflectiveFraction + options.refractiveFraction > 1 ||
+		options.spotlightFraction < 0 || options.spotlightFraction > 1) {
+		fprintf(stderr, "Error: Fractions must be between 0 and 1, reflective + refractive must not exceed 1\n");
+		return 1;
+	}
+	if (options.radialA2 < 0 || options.radialA1 < 0 || options.radialA0 < 0 ||
+		(options.radialA2 == 0 && options.radialA1 == 0 && options.radialA0 == 0)) {
+		fprintf(stderr, "Error: Radial constants must not be negative and must not all be 0\n");
+		return 1;
+	}
+	if (options.lightIntensity < 0) {
+		// Keep the total light in the scene roughly constant as the light count grows
+		double typicalDistance = 2 * options.extent;
+		double attenuation = options.radialA2 * pow(typicalDistance, 2) + options.radialA1 * typicalDistance + options.radialA0;
+		options.lightIntensity = 2 * attenuation / (options.lights > 0 ? options.lights : 1);
+	}
+
+	rngState = options.seed ? options.seed : DEFAULT_SEED;
+
+	FILE *fp = stdout;
+	if (outputFname != NULL) {
+		fp = fopen(outputFname, "w");
+		if (!fp) {
+			fprintf(stderr, "Error: File '%s' could not be opened for writing\n", outputFname);
+			return 1;
+		}
+	}
+
+	generate_scene(fp, &options);
+
+	if (outputFname != NULL)
+		fclose(fp);
+
+	return 0;
+}
@@ -0,0 +1,191 @@
+//
+// Created by Brandon Garling on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../src/imaging.h"
+#include "../src/ppm.h"
+
+/**
+ * One partial render, the file is left open at its next unread row
+ */
+typedef struct Part {
+	char *fname;
+	FILE *fp;
+	ImageRegion region;
+} Part;
+
+/**
+ * Show a simple help message about the usage of this program
+ */
+static void show_help() {
+	printf("Usage: stitch [options] <part.ppm>...\n");
+	printf("\t part.ppm: A region written by 'raytrace --region' or 'raytrace --band'\n");
+	printf("\t --output <file>: The stitched PPM P6 image, - writes to standard output (default -)\n");
+	printf("\n");
+	printf("\t The parts must cover the frame exactly once. They are streamed one row at a time so only a\n");
+	printf("\t single row of the frame is held in memory.\n");
+}
+
+/**
+ * Order parts left to right so a row is filled in order
+ */
+static int compare_parts(const void *a, const void *b) {
+	const Part *partA = a;
+	const Part *partB = b;
+	return partA->region.x - partB->region.x;
+}
+
+/**
+ * Check that the parts all belong to the same frame and cover every pixel exactly once
+ * @return 0 if success, otherwise a failure occurred
+ */
+static int check_coverage(Part *parts, int partsLength) {
+	int frameWidth = parts[0].region.frameWidth;
+	int frameHeight = parts[0].region.frameHeight;
+	long long area = 0;
+
+	for (int i = 0; i < partsLength; i++) {
+		ImageRegion *a = &parts[i].region;
+		if (a->frameWidth != frameWidth || a->frameHeight != frameHeight) {
+			fprintf(stderr, "Error: Part '%s' belongs to a %dx%d frame, expected %dx%d\n", parts[i].fname,
+					a->frameWidth, a->frameHeight, frameWidth, frameHeight);
+			return 1;
+		}
+		if (a->x < 0 || a->y < 0 || a->x + a->width > frameWidth || a->y + a->height > frameHeight) {
+			fprintf(stderr, "Error: Part '%s' lies outside of the %dx%d frame\n", parts[i].fname, frameWidth, frameHeight);
+			return 1;
+		}
+		for (int j = 0; j < i; j++) {
+			ImageRegion *b = &parts[j].region;
+			if (a->x < b->x + b->width && b->x < a->x + a->width && a->y < b->y + b->height && b->y < a->y + a->height) {
+				fprintf(stderr, "Error: Parts '%s' and '%s' overlap\n", parts[j].fname, parts[i].fname);
+				return 1;
+			}
+		}
+		area += (long long) a->width * a->height;
+	}
+
+	// Without overlaps the parts cover the frame exactly when their areas add up to it
+	if (area != (long long) frameWidth * frameHeight) {
+		fprintf(stderr, "Error: The parts cover %lld of the %lld pixels in the frame\n", area,
+				(long long) frameWidth * frameHeight);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Close every part which has been opened
+ */
+static void close_parts(Part *parts, int partsLength) {
+	for (int i = 0; i < partsLength; i++) {
+		if (parts[i].fp != NULL)
+			fclose(parts[i].fp);
+	}
+	free(parts);
+}
+
+int main(int argc, char *argv[]) {
+	char *outputFname = "-";
+	Part *parts = malloc(sizeof(Part) * argc);
+	int partsLength = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--help") == 0) {
+			show_help();
+			free(parts);
+			return 0;
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			outputFname = argv[++i];
+		}
+		else if (strncmp(argv[i], "--", 2) != 0) {
+			parts[partsLength].fname = argv[i];
+			parts[partsLength].fp = NULL;
+			partsLength++;
+		}
+		else {
+			fprintf(stderr, "Error: Unknown or incomplete argument '%s'\n", argv[i]);
+			show_help();
+			free(parts);
+			return 1;
+		}
+	}
+
+	if (partsLength == 0) {
+		fprintf(stderr, "Error: No parts provided\n");
+		show_help();
+		free(parts);
+		return 1;
+	}
+
+	// Read every header up front so the coverage can be checked before any output is written
+	for (int i = 0; i < partsLength; i++) {
+		int width, height;
+		parts[i].fp = fopen(parts[i].fname, "rb");
+		if (!parts[i].fp) {
+			fprintf(stderr, "Error: File '%s' could not be opened for reading\n", parts[i].fname);
+			close_parts(parts, partsLength);
+			return 1;
+		}
+		if (read_ppm_p6_header(parts[i].fp, parts[i].fname, &width, &height, &parts[i].region) != 0) {
+			close_parts(parts, partsLength);
+			return 1;
+		}
+		if (parts[i].region.width == 0) {
+			fprintf(stderr, "Error: File '%s' has no region comment, it was not rendered with --region or --band\n",
+					parts[i].fname);
+			close_parts(parts, partsLength);
+			return 1;
+		}
+	}
+
+	if (check_coverage(parts, partsLength) != 0) {
+		close_parts(parts, partsLength);
+		return 1;
+	}
+	qsort(parts, (size_t) partsLength, sizeof(Part), compare_parts);
+
+	int frameWidth = parts[0].region.frameWidth;
+	int frameHeight = parts[0].region.frameHeight;
+	FILE *out = strcmp(outputFname, "-") == 0 ? stdout : fopen(outputFname, "wb");
+	if (!out) {
+		fprintf(stderr, "Error: File '%s' could not be opened for writing\n", outputFname);
+		close_parts(parts, partsLength);
+		return 1;
+	}
+
+	uint8_t *row = malloc((size_t) frameWidth * 3);
+	int status = 0;
+	fprintf(out, "P6\n%i %i\n255\n", frameWidth, frameHeight);
+	for (int y = 0; y < frameHeight && status == 0; y++) {
+		// Each row is covered by a left to right run of parts, each gives up its next row in turn
+		for (int i = 0; i < partsLength; i++) {
+			ImageRegion *regionRef = &parts[i].region;
+			if (y < regionRef->y || y >= regionRef->y + regionRef->height)
+				continue;
+			if (fread(row + (size_t) regionRef->x * 3, 1, (size_t) regionRef->width * 3, parts[i].fp) !=
+				(size_t) regionRef->width * 3) {
+				fprintf(stderr, "Error: File '%s' ended before all of the pixels were read\n", parts[i].fname);
+				status = 1;
+				break;
+			}
+		}
+		if (status == 0 && fwrite(row, 1, (size_t) frameWidth * 3, out) != (size_t) frameWidth * 3) {
+			fprintf(stderr, "Error: Could not write to '%s'\n", outputFname);
+			status = 1;
+		}
+	}
+
+	free(row);
+	if (out != stdout)
+		fclose(out);
+	else
+		fflush(out);
+	close_parts(parts, partsLength);
+	return status;
+}